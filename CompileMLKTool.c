@@ -45,6 +45,7 @@ typedef unsigned short	UINT16;
 typedef unsigned int	UINT32;
 
 #endif	// HAVE_STDINT
+#include "file-map.h"
 
 
 typedef struct _file_item
@@ -63,7 +64,6 @@ typedef struct _file_list
 } FILE_LIST;
 
 
-static UINT8 ReadFileData(const char* fileName, UINT32* retSize, UINT8** retData);
 static size_t GetFileSize(const char* fileName);
 static UINT8 WriteFileData(const char* fileName, UINT32 dataLen, const void* data);
 static const char* GetFileTitle(const char* filePath);
@@ -136,28 +136,6 @@ int main(int argc, char* argv[])
 	return 0;
 }
 
-static UINT8 ReadFileData(const char* fileName, UINT32* retSize, UINT8** retData)
-{
-	FILE* hFile;
-	UINT32 readBytes;
-	
-	hFile = fopen(fileName, "rb");
-	if (hFile == NULL)
-		return 0xFF;
-	
-	fseek(hFile, 0, SEEK_END);
-	*retSize = ftell(hFile);
-	if (*retSize > 0x10000000)
-		*retSize = 0x10000000;	// limit to 256 MB
-	
-	*retData = (UINT8*)realloc(*retData, *retSize);
-	fseek(hFile, 0, SEEK_SET);
-	readBytes = fread(*retData, 0x01, *retSize, hFile);
-	
-	fclose(hFile);
-	return (readBytes == *retSize) ? 0 : 1;
-}
-
 static size_t GetFileSize(const char* fileName)
 {
 	FILE* hFile;
@@ -214,8 +192,8 @@ static const char* GetFileExtension(const char* filePath)
 
 static int ExtractArchive(const char* arcFileName, const char* outPattern)
 {
-	size_t arcSize;
 	UINT8* arcData;
+	FILE_MAP arcMap;
 	UINT8 retVal;
 	const char* fileExt;
 	char* outName;
@@ -232,17 +210,12 @@ static int ExtractArchive(const char* arcFileName, const char* outPattern)
 	strcpy(outName, outPattern);
 	outExt = outName + (fileExt - outPattern);
 	
-	arcSize = 0;
-	arcData = NULL;
-	retVal = ReadFileData(arcFileName, &arcSize, &arcData);
-	if (retVal)
+	if (MapInputFile(arcFileName, &arcMap))
 	{
-		if (retVal == 0xFF)
-			printf("Error opening %s!\n", arcFileName);
-		else
-			printf("Unable to fully read %s!\n", arcFileName);
+		printf("Error opening %s!\n", arcFileName);
 		return 1;
 	}
+	arcData = arcMap.data;
 	
 	// extract everything
 	strcpy(outExt, ".txt");
@@ -276,7 +249,7 @@ static int ExtractArchive(const char* arcFileName, const char* outPattern)
 	}
 	
 	fclose(hListFile);
-	free(arcData);
+	UnmapFile(&arcMap, 0);
 	
 	printf("Done.\n");
 	return 0;
@@ -417,7 +390,7 @@ static int CreateArchive(const char* arcFileName, const char* fileListName)
 		UINT32 tocPos;
 		UINT32 dataSize;
 		UINT8* data;
-		UINT8 retVal;
+		FILE_MAP srcMap;
 		
 		dataSize = 0x02 + fileList.count * 0x09;
 		data = (UINT8*)malloc(dataSize);
@@ -440,8 +413,7 @@ static int CreateArchive(const char* arcFileName, const char* fileListName)
 		{
 			FILE_ITEM* fi = &fileList.items[curFile];
 			printf("Writing data %u/%u (%s) ...\n", 1 + curFile, fileList.count, fi->fileName);
-			retVal = ReadFileData(fi->fileName, &dataSize, &data);
-			if (retVal)
+			if (MapInputFile(fi->fileName, &srcMap))
 			{
 				printf("Unable to read %s!\n", fi->fileName);
 				result = 2;
@@ -449,7 +421,8 @@ static int CreateArchive(const char* arcFileName, const char* fileListName)
 			}
 			
 			fseek(hFile, fi->filePos, SEEK_SET);
-			fwrite(data, 1, dataSize, hFile);
+			fwrite(srcMap.data, 1, srcMap.len, hFile);
+			UnmapFile(&srcMap, 0);
 		}
 		free(data);
 	}
@@ -82,6 +82,7 @@ typedef unsigned short	UINT16;
 typedef unsigned int	UINT32;
 
 #endif	// HAVE_STDINT
+#include "file-map.h"
 
 
 typedef struct _file_item
@@ -112,7 +113,6 @@ typedef struct _file_list
 } FILE_LIST;
 
 
-static UINT8 ReadFileData(const char* fileName, UINT32* retSize, UINT8** retData);
 static UINT8 GetWaveInfo(const char* fileName, FILE_ITEM* fi);
 static UINT8 WriteFileData(const char* fileName, UINT32 dataLen, const void* data);
 static UINT8 WriteWaveFile(const char* fileName, const FILE_ITEM* info, const void* data);
@@ -216,28 +216,6 @@ int main(int argc, char* argv[])
 	return 0;
 }
 
-static UINT8 ReadFileData(const char* fileName, UINT32* retSize, UINT8** retData)
-{
-	FILE* hFile;
-	UINT32 readBytes;
-	
-	hFile = fopen(fileName, "rb");
-	if (hFile == NULL)
-		return 0xFF;
-	
-	fseek(hFile, 0, SEEK_END);
-	*retSize = ftell(hFile);
-	if (*retSize > 0x10000000)
-		*retSize = 0x10000000;	// limit to 256 MB
-	
-	*retData = (UINT8*)realloc(*retData, *retSize);
-	fseek(hFile, 0, SEEK_SET);
-	readBytes = fread(*retData, 0x01, *retSize, hFile);
-	
-	fclose(hFile);
-	return (readBytes == *retSize) ? 0 : 1;
-}
-
 static UINT8 GetWaveInfo(const char* fileName, FILE_ITEM* fi)
 {
 	FILE* hFile;
@@ -418,6 +396,7 @@ static int ExtractArchive(const char* arcFileName, const char* outPattern)
 	UINT16 tocEntrySize;
 	UINT32 arcSize;
 	UINT8* arcData;
+	FILE_MAP arcMap;
 	UINT8 retVal;
 	const char* fileExt;
 	char* outName;
@@ -434,17 +413,13 @@ static int ExtractArchive(const char* arcFileName, const char* outPattern)
 	strcpy(outName, outPattern);
 	outExt = outName + (fileExt - outPattern);
 	
-	arcSize = 0;
-	arcData = NULL;
-	retVal = ReadFileData(arcFileName, &arcSize, &arcData);
-	if (retVal)
+	if (MapInputFile(arcFileName, &arcMap))
 	{
-		if (retVal == 0xFF)
-			printf("Error opening %s!\n", arcFileName);
-		else
-			printf("Unable to fully read %s!\n", arcFileName);
+		printf("Error opening %s!\n", arcFileName);
 		return 1;
 	}
+	arcSize = arcMap.len;
+	arcData = arcMap.data;
 	
 	arcFormat = ARC_FMT_NONE;
 	if (! memcmp(&arcData[0x00], "WLKF0200", 0x08))
@@ -579,7 +554,7 @@ static int ExtractArchive(const char* arcFileName, const char* outPattern)
 	}
 	
 	fclose(hListFile);
-	free(arcData);
+	UnmapFile(&arcMap, 0);
 	
 	printf("Done.\n");
 	return 0;
@@ -758,10 +733,10 @@ static int CreateArchive(const char* arcFileName, const char* fileListName)
 		UINT32 tocPos;
 		UINT32 dataSize;
 		UINT8* data;
+		FILE_MAP srcMap;
 		FILEPATH_INFO* fpiList;
 		UINT32 fnListSize;
 		UINT8* fnListData;
-		UINT8 retVal;
 		
 		data = (UINT8*)malloc(tocSize);
 		fnListData = NULL;
@@ -890,13 +865,13 @@ static int CreateArchive(const char* arcFileName, const char* fileListName)
 		{
 			FILE_ITEM* fi = &fileList.items[curFile];
 			printf("Writing data %u/%u (%s) ...\n", 1 + curFile, fileList.count, fi->fileName);
-			retVal = ReadFileData(fi->fileName, &dataSize, &data);
-			if (retVal)
+			if (MapInputFile(fi->fileName, &srcMap))
 			{
 				printf("Unable to read %s!\n", fi->fileName);
 				result = 2;
 				continue;
 			}
+			dataSize = (UINT32)srcMap.len;
 			if (dataSize <= fi->wavDataOfs)
 				dataSize = 0;
 			else
@@ -905,7 +880,8 @@ static int CreateArchive(const char* arcFileName, const char* fileListName)
 				dataSize = fi->size;
 			
 			fseek(hFile, fi->filePos, SEEK_SET);
-			fwrite(&data[fi->wavDataOfs], 1, dataSize, hFile);
+			fwrite(&srcMap.data[fi->wavDataOfs], 1, dataSize, hFile);
+			UnmapFile(&srcMap, 0);
 		}
 		
 		// copy file name data
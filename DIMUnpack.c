@@ -5,12 +5,15 @@
 
 #if defined(WIN32) || defined(__WINDOWS__)
 #include <direct.h>	// for _mkdir()
+#include <conio.h>	// for _getch()
 #else
 #include <sys/stat.h>
-#define _mkdir(dir)	mkdir(x, 0777)
+#define _mkdir(dir)	mkdir(dir, 0777)
+#define _getch		getchar
 #endif
 
 #include "stdtype.h"
+#include "file-map.h"
 
 #if defined(_MSC_VER)
 #define INLINE	static __inline
@@ -56,6 +59,7 @@ typedef struct _fat_file_entry
 
 UINT32 DimSize;
 UINT8* DimData;
+FILE_MAP DimMap;
 FAT_BOOTSECT BootSect;
 UINT32 ClusterBase;
 UINT16 ClusterSize;
@@ -71,7 +75,6 @@ static void ExtractFile(const char* FileName, UINT16 Cluster, UINT32 FileSize);
 
 int main(int argc, char* argv[])
 {
-	FILE* hFile;
 	char BootSig[0x11];
 	UINT8 BootFmt;
 	UINT8 BaseSects;
@@ -85,18 +88,10 @@ int main(int argc, char* argv[])
 		return 0;
 	}
 	
-	hFile = fopen(argv[1], "rb");
-	if (hFile == NULL)
+	if (MapInputFile(argv[1], &DimMap))
 		return 1;
-	
-	fseek(hFile, 0x00, SEEK_END);
-	DimSize = ftell(hFile);
-	
-	fseek(hFile, 0x00, SEEK_SET);
-	DimData = (UINT8*)malloc(DimSize);
-	fread(DimData, 0x01, DimSize, hFile);
-	
-	fclose(hFile);
+	DimSize = (UINT32)DimMap.len;
+	DimData = DimMap.data;
 	
 	strncpy(BootSig, (char*)&DimData[0x102], 0x10);
 	BootSig[0x10] = '\0';
@@ -146,7 +141,7 @@ int main(int argc, char* argv[])
 	else
 	{
 		printf("Unknown disk format!\n");
-		free(DimData);
+		UnmapFile(&DimMap, 0);
 		return 2;
 	}
 	printf("Bytes per Sector:\t%hu\n", BootSect.BytPerSect);		BootSect.BytPerSect=1024;
@@ -178,7 +173,7 @@ int main(int argc, char* argv[])
 	
 	free(OutPath);
 	free(FATTbl);
-	free(DimData);
+	UnmapFile(&DimMap, 0);
 	_getch();
 	
 	return 0;
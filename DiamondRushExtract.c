@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "file-map.h"
 
 typedef unsigned char	UINT8;
 typedef unsigned int	UINT32;
@@ -15,21 +16,20 @@ typedef struct _file_toc
 #define FCC_MTRK	0x6468544D
 #define FCC_PNG		0x474E5089
 
-#define BUFFER_SIZE	0x100
 UINT8 FileCount;
 FILE_TOC* Files;
 UINT32 HdrOffset;
 
 int main(int argc, char* argv[])
 {
-	FILE* hFileIn;
+	FILE_MAP inMap;
 	FILE* hFileOut;
 	UINT8 CurFile;
 	UINT8 FileNumChrs;
 	char* FileBase;
 	char* OutName;
 	const char* FileExt;
-	char Buffer[BUFFER_SIZE];
+	UINT32 FileOfs;
 	UINT32 RemBytes;
 	UINT32 WrtBytes;
 	
@@ -39,8 +39,7 @@ int main(int argc, char* argv[])
 		return 0;
 	}
 	
-	hFileIn = fopen(argv[1], "rb");
-	if (hFileIn == NULL)
+	if (MapInputFile(argv[1], &inMap))
 	{
 		printf("Error opening file!\n");
 		return 1;
@@ -54,26 +53,44 @@ int main(int argc, char* argv[])
 	
 	OutName = (char*)malloc(strlen(FileBase) + 0x10);
 	
-	FileCount = (UINT8)fgetc(hFileIn);
+	if (inMap.len < 0x01)
+	{
+		printf("File too small!\n");
+		UnmapFile(&inMap, 0);
+		return 1;
+	}
+	FileCount = inMap.data[0x00];
 	printf("%hu files found.\n", FileCount);
 	if (FileCount <= 10)
 		FileNumChrs = 1;
 	else
 		FileNumChrs = 2;
 	
+	HdrOffset = 0x01 + sizeof(FILE_TOC) * FileCount;
+	if (HdrOffset > inMap.len)
+	{
+		printf("File too small!\n");
+		UnmapFile(&inMap, 0);
+		return 1;
+	}
 	Files = (FILE_TOC*)malloc(sizeof(FILE_TOC) * FileCount);
-	fread(Files, sizeof(FILE_TOC), FileCount, hFileIn);
+	memcpy(Files, &inMap.data[0x01], sizeof(FILE_TOC) * FileCount);
 	
-	HdrOffset = ftell(hFileIn);
 	printf("Header Offset: 0x%04u\n", HdrOffset);
 	
 	for (CurFile = 0x00; CurFile < FileCount; CurFile ++)
 	{
-		fseek(hFileIn, HdrOffset + Files[CurFile].Offset, SEEK_SET);
+		FileOfs = HdrOffset + Files[CurFile].Offset;
 		RemBytes = Files[CurFile].Length;
+		if (FileOfs > inMap.len || RemBytes > inMap.len - FileOfs)
+		{
+			printf("File %hu lies outside of the archive!\n", CurFile);
+			continue;
+		}
 		
-		fread(&WrtBytes, 0x04, 0x01, hFileIn);	// read first 4 bytes
-		fseek(hFileIn, -4, SEEK_CUR);
+		WrtBytes = 0;
+		if (RemBytes >= 0x04)
+			memcpy(&WrtBytes, &inMap.data[FileOfs], 0x04);	// read first 4 bytes
 		
 		switch(WrtBytes)	// select file extention based on file header
 		{
@@ -97,31 +114,19 @@ int main(int argc, char* argv[])
 			continue;
 		}
 		
-		while(RemBytes)
-		{
-			WrtBytes = (RemBytes <= BUFFER_SIZE) ? RemBytes : BUFFER_SIZE;
-			WrtBytes = fread(Buffer, 0x01, WrtBytes, hFileIn);
-			if (! WrtBytes)
-			{
-				printf("Read error!\n");
-				break;
-			}
-			
-			fwrite(Buffer, 0x01, WrtBytes, hFileOut);
-			
-			RemBytes -= WrtBytes;
-		}
+		fwrite(&inMap.data[FileOfs], 0x01, RemBytes, hFileOut);
 		
 		fclose(hFileOut);
 		
 		printf("\n");
 	}
 	
-	fclose(hFileIn);
+	UnmapFile(&inMap, 0);
 	printf("Done.\n");
 	
 	free(FileBase);
 	free(OutName);
+	free(Files);
 	
 	return 0;
 }
@@ -17,6 +17,7 @@ typedef unsigned char	UINT8;
 typedef unsigned short	UINT16;
 
 #endif	// HAVE_STDINT
+#include "file-map.h"
 
 
 static void ExtractArchive(size_t arcSize, const UINT8* arcData, size_t fileCnt, const char* fileName);
@@ -32,9 +33,9 @@ static size_t songCnt = 20;
 int main(int argc, char* argv[])
 {
 	int argbase;
-	FILE* hFile;
 	size_t inLen;
 	UINT8* inData;
+	FILE_MAP inMap;
 	
 	printf("Fox Ranger Music Extractor\n--------------------------\n");
 	if (argc < 2)
@@ -72,24 +73,14 @@ int main(int argc, char* argv[])
 		return 0;
 	}
 	
-	hFile = fopen(argv[argbase + 0], "rb");
-	if (hFile == NULL)
+	if (MapInputFile(argv[argbase + 0], &inMap))
 		return 1;
-	
-	fseek(hFile, 0, SEEK_END);
-	inLen = ftell(hFile);
-	if (inLen > 0x1000000)
-		inLen = 0x1000000;	// limit to 16 MB
-	
-	inData = (UINT8*)malloc(inLen);
-	fseek(hFile, 0, SEEK_SET);
-	fread(inData, 0x01, inLen, hFile);
-	
-	fclose(hFile);
+	inLen = inMap.len;
+	inData = inMap.data;
 	
 	ExtractArchive(inLen, inData, songCnt, argv[argbase + 1]);
 	
-	free(inData);
+	UnmapFile(&inMap, 0);
 	
 	return 0;
 }
@@ -5,7 +5,13 @@
 #include <stdio.h>
 #include <malloc.h>
 #include <string.h>
+#if defined(WIN32) || defined(_WIN32)
 #include <direct.h>	// for mkdir
+#else
+#include <sys/stat.h>
+#define mkdir(dir)	mkdir(dir, 0777)
+#endif
+#include "file-map.h"
 
 
 // Type Definitions for short types
@@ -63,7 +69,7 @@ UINT8 UnpackLBXArchive(const char* InputFile, const char* ExtractPath)
 	UINT32 TOCPos;
 	LBX_TOC* Files;
 	UINT32 CurFile;
-	FILE* hFile;
+	FILE_MAP inMap;
 	FILE* hFileOut;
 	UINT32 TempLng;
 	LBX_TOC* TempFile;
@@ -71,22 +77,25 @@ UINT8 UnpackLBXArchive(const char* InputFile, const char* ExtractPath)
 	char* FileName;
 	char* FileNameTitle;
 	
-	hFile = fopen(InputFile, "rb");
-	if (hFile == NULL)
+	if (MapInputFile(InputFile, &inMap))
 	{
 		printerr("Error opening file!\n");
 		return 0x10;
 	}
+	if (inMap.len < 0x06)
+	{
+		UnmapFile(&inMap, 0);
+		printerr("File too small! File invalid!\n");
+		return 0x20;
+	}
 	
-	fseek(hFile, -0x06, SEEK_END);
-	
-	TempLng = ftell(hFile);		// get TOC end offset
-	fread(&FileCount, 0x02, 0x01, hFile);
-	fread(&TOCPos, 0x04, 0x01, hFile);
+	TempLng = (UINT32)(inMap.len - 0x06);	// get TOC end offset
+	memcpy(&FileCount, &inMap.data[TempLng + 0x00], 0x02);
+	memcpy(&TOCPos, &inMap.data[TempLng + 0x02], 0x04);
 	
 	if (TOCPos + FileCount * 0x14 > TempLng)
 	{
-		fclose(hFile);
+		UnmapFile(&inMap, 0);
 		printerr("TOC too large! File invalid!\n");
 		return 0x20;
 	}
@@ -95,13 +104,7 @@ UINT8 UnpackLBXArchive(const char* InputFile, const char* ExtractPath)
 	
 	Files = (LBX_TOC*)malloc(FileCount * sizeof(LBX_TOC));
 	printf("Reading TOC ...");
-	fseek(hFile, TOCPos, SEEK_SET);
-	TempLng = fread(Files, 0x14, FileCount, hFile);
-	if (TempLng < FileCount)
-	{
-		printerr2("Warning: Could read only %u TOC entries!", TempLng);
-		FileCount = TempLng;
-	}
+	memcpy(Files, &inMap.data[TOCPos], FileCount * 0x14);
 	printf("  OK\n");
 	
 	printf("Extracting Files ...\n");
@@ -117,6 +120,12 @@ UINT8 UnpackLBXArchive(const char* InputFile, const char* ExtractPath)
 		FileNameTitle[0x0C] = '\0';
 		RTrimSpaces(FileNameTitle);
 		
+		if (TempFile->Position > inMap.len || TempFile->Size > inMap.len - TempFile->Position)
+		{
+			printf("Error: %s lies outside of the archive!\n", FileNameTitle);
+			continue;
+		}
+		
 		CreatePath(FileName);
 		hFileOut = fopen(FileName, "wb");
 		if (hFileOut == NULL)
@@ -126,21 +135,19 @@ UINT8 UnpackLBXArchive(const char* InputFile, const char* ExtractPath)
 		else
 		{
 			printf("%.12s\n", TempFile->Name);
-			FileBuf = (UINT8*)malloc(TempFile->Size);
-			
-			fseek(hFile, TempFile->Position, SEEK_SET);
-			fread(FileBuf, 0x01, TempFile->Size, hFile);
+			FileBuf = &inMap.data[TempFile->Position];
 			fwrite(FileBuf, 0x01, TempFile->Size, hFileOut);
 			
-			if (FileBuf[0] == 0x02 && FileBuf[1] == 0x1A && FileBuf[2] == 0x00)
+			if (TempFile->Size >= 0x03 && FileBuf[0] == 0x02 && FileBuf[1] == 0x1A && FileBuf[2] == 0x00)
 				PrintPMDIBMTags(TempFile->Size, FileBuf);
 			
-			free(FileBuf);		FileBuf = NULL;
 			fclose(hFileOut);	hFileOut = NULL;
 		}
 	}
 	printf("Done.\n");
 	free(FileName);
+	free(Files);
+	UnmapFile(&inMap, 0);
 	
 	return 0x00;
 }
@@ -0,0 +1,265 @@
+/* memory-mapped file input/output, shared by the tools
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "file-map.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>		// for _setmode()
+#include <fcntl.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+
+static uint8_t MapInput(const char* fileName, FILE_MAP* map, int writable);
+static uint8_t ReadWholeFile(FILE* hFile, FILE_MAP* map);
+
+
+uint8_t MapInputFile(const char* fileName, FILE_MAP* map)
+{
+	return MapInput(fileName, map, 0);
+}
+
+uint8_t MapInputFileCopy(const char* fileName, FILE_MAP* map)
+{
+	return MapInput(fileName, map, 1);
+}
+
+uint8_t ReadInputFile(const char* fileName, FILE_MAP* map)
+{
+	FILE* hFile;
+	uint8_t retVal;
+
+	map->len = 0;
+	map->data = NULL;
+	map->mapped = 0;
+	map->output = 0;
+	if (! strcmp(fileName, "-"))
+		return MapInput(fileName, map, 0);
+	hFile = fopen(fileName, "rb");
+	if (hFile == NULL)
+		return 1;
+	retVal = ReadWholeFile(hFile, map);
+	fclose(hFile);
+	return retVal;
+}
+
+uint8_t IsSameFile(const char* fileName1, const char* fileName2)
+{
+	if (! strcmp(fileName1, "-") || ! strcmp(fileName2, "-"))
+		return 0;
+#ifdef _WIN32
+	{
+		HANDLE hFile1;
+		HANDLE hFile2;
+		BY_HANDLE_FILE_INFORMATION info1;
+		BY_HANDLE_FILE_INFORMATION info2;
+		uint8_t retVal = 0;
+
+		hFile1 = CreateFileA(fileName1, 0, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, 0, NULL);
+		if (hFile1 == INVALID_HANDLE_VALUE)
+			return 0;
+		hFile2 = CreateFileA(fileName2, 0, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, 0, NULL);
+		if (hFile2 != INVALID_HANDLE_VALUE)
+		{
+			if (GetFileInformationByHandle(hFile1, &info1) && GetFileInformationByHandle(hFile2, &info2))
+				retVal = (info1.dwVolumeSerialNumber == info2.dwVolumeSerialNumber &&
+					info1.nFileIndexHigh == info2.nFileIndexHigh && info1.nFileIndexLow == info2.nFileIndexLow);
+			CloseHandle(hFile2);
+		}
+		CloseHandle(hFile1);
+		return retVal;
+	}
+#else
+	{
+		struct stat st1;
+		struct stat st2;
+
+		if (stat(fileName1, &st1) != 0 || stat(fileName2, &st2) != 0)
+			return 0;	// the output file doesn't exist yet
+		return (st1.st_dev == st2.st_dev && st1.st_ino == st2.st_ino);
+	}
+#endif
+}
+
+static uint8_t MapInput(const char* fileName, FILE_MAP* map, int writable)
+{
+	FILE* hFile;
+	uint8_t retVal;
+
+	map->len = 0;
+	map->data = NULL;
+	map->mapped = 0;
+	map->output = 0;
+	if (! strcmp(fileName, "-"))
+	{
+#ifdef _WIN32
+		_setmode(_fileno(stdin), _O_BINARY);
+#endif
+		return ReadWholeFile(stdin, map);
+	}
+#ifdef _WIN32
+	map->hFile = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (map->hFile != INVALID_HANDLE_VALUE)
+	{
+		LARGE_INTEGER fileSize;
+		map->hMap = NULL;
+		if (GetFileType(map->hFile) == FILE_TYPE_DISK && GetFileSizeEx(map->hFile, &fileSize) &&
+			fileSize.QuadPart > 0 && (ULONGLONG)fileSize.QuadPart <= (size_t)-1)
+			map->hMap = CreateFileMappingA(map->hFile, NULL, writable ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, NULL);
+		if (map->hMap != NULL)
+		{
+			map->data = (uint8_t*)MapViewOfFile(map->hMap, writable ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0);
+			if (map->data != NULL)
+			{
+				map->len = (size_t)fileSize.QuadPart;
+				map->mapped = 1;
+				return 0;
+			}
+			CloseHandle(map->hMap);
+		}
+		CloseHandle(map->hFile);
+	}
+#else
+	map->fd = open(fileName, O_RDONLY);
+	if (map->fd >= 0)
+	{
+		struct stat st;
+		if (fstat(map->fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 && (unsigned long long)st.st_size <= (size_t)-1)
+		{
+			int prot = writable ? (PROT_READ | PROT_WRITE) : PROT_READ;
+			void* ptr = mmap(NULL, (size_t)st.st_size, prot, MAP_PRIVATE, map->fd, 0);
+			if (ptr != MAP_FAILED)
+			{
+				madvise(ptr, (size_t)st.st_size, MADV_SEQUENTIAL);
+				map->data = (uint8_t*)ptr;
+				map->len = (size_t)st.st_size;
+				map->mapped = 1;
+				return 0;
+			}
+		}
+		close(map->fd);
+	}
+#endif
+
+	// not mappable (pipe, device, empty file, ...) - read it without relying on the reported size
+	hFile = fopen(fileName, "rb");
+	if (hFile == NULL)
+		return 1;
+	retVal = ReadWholeFile(hFile, map);
+	fclose(hFile);
+	return retVal;
+}
+
+static uint8_t ReadWholeFile(FILE* hFile, FILE_MAP* map)
+{
+	size_t bufSize = 0x10000;
+	uint8_t* newBuf;
+
+	map->len = 0;
+	map->data = (uint8_t*)malloc(bufSize);
+	if (map->data == NULL)
+		return 2;
+	while(1)
+	{
+		map->len += fread(&map->data[map->len], 1, bufSize - map->len, hFile);
+		if (map->len < bufSize)
+			break;
+		newBuf = (bufSize * 2 > bufSize) ? (uint8_t*)realloc(map->data, bufSize * 2) : NULL;
+		if (newBuf == NULL)
+		{
+			free(map->data);
+			map->data = NULL;
+			map->len = 0;
+			return 2;
+		}
+		map->data = newBuf;
+		bufSize *= 2;
+	}
+	return 0;
+}
+
+uint8_t MapOutputFile(const char* fileName, size_t size, FILE_MAP* map)
+{
+	map->len = size;
+	map->data = NULL;
+	map->mapped = 0;
+	map->output = 1;
+	if (size == 0)
+		return 1;
+#ifdef _WIN32
+	map->hFile = CreateFileA(fileName, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (map->hFile == INVALID_HANDLE_VALUE)
+		return 1;
+	map->hMap = CreateFileMappingA(map->hFile, NULL, PAGE_READWRITE,
+		(DWORD)((ULONGLONG)size >> 32), (DWORD)(size & 0xFFFFFFFF), NULL);
+	if (map->hMap != NULL)
+	{
+		map->data = (uint8_t*)MapViewOfFile(map->hMap, FILE_MAP_WRITE, 0, 0, size);
+		if (map->data != NULL)
+		{
+			map->mapped = 1;
+			return 0;
+		}
+		CloseHandle(map->hMap);
+	}
+	CloseHandle(map->hFile);
+	return 1;
+#else
+	map->fd = open(fileName, O_RDWR | O_CREAT | O_TRUNC, 0666);
+	if (map->fd < 0)
+		return 1;
+	if (ftruncate(map->fd, (off_t)size) == 0)
+	{
+		void* ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, map->fd, 0);
+		if (ptr != MAP_FAILED)
+		{
+			map->data = (uint8_t*)ptr;
+			map->mapped = 1;
+			return 0;
+		}
+	}
+	close(map->fd);
+	return 1;
+#endif
+}
+
+void UnmapFile(FILE_MAP* map, size_t finalLen)
+{
+	if (! map->mapped)
+	{
+		free(map->data);
+		map->data = NULL;
+		return;
+	}
+#ifdef _WIN32
+	UnmapViewOfFile(map->data);
+	CloseHandle(map->hMap);
+	if (map->output && finalLen < map->len)
+	{
+		LARGE_INTEGER ofs;
+		ofs.QuadPart = (LONGLONG)finalLen;
+		if (SetFilePointerEx(map->hFile, ofs, NULL, FILE_BEGIN))
+			SetEndOfFile(map->hFile);
+	}
+	CloseHandle(map->hFile);
+#else
+	munmap(map->data, map->len);
+	if (map->output && finalLen < map->len)
+	{
+		if (ftruncate(map->fd, (off_t)finalLen) != 0)
+			fprintf(stderr, "Error truncating output file!\n");
+	}
+	close(map->fd);
+#endif
+	map->data = NULL;
+	map->mapped = 0;
+	return;
+}
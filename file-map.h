@@ -0,0 +1,46 @@
+#ifndef FILEMAP_H
+#define FILEMAP_H
+
+#include <stddef.h>
+
+#if !defined(_STDINT_H) && !defined(_STDINT)
+#ifdef HAVE_STDINT_H
+#include <stdint.h>
+#else
+typedef unsigned char	uint8_t;
+#endif	// !HAVE_STDINT_H
+#endif	// !_STDINT_H
+
+
+// A whole file in memory: a memory mapping where possible, a heap buffer otherwise.
+typedef struct _file_map
+{
+	size_t len;
+	uint8_t* data;
+	uint8_t mapped;	// 1 = data is a memory mapping, 0 = heap buffer
+	uint8_t output;	// 1 = writable mapping of an output file
+#ifdef _WIN32
+	void* hFile;	// HANDLE
+	void* hMap;		// HANDLE
+#else
+	int fd;
+#endif
+} FILE_MAP;
+
+//	MapInputFile() maps the whole file read-only. Files that can't be mapped (pipes, empty files, ...) are read
+//		into a heap buffer instead, "-" reads all of standard input. map->len is always the real file size.
+//		Returns 0 on success, 1 when the file can't be opened, 2 when there is not enough memory.
+//	MapInputFileCopy() is the same, but the data may be modified in memory (copy-on-write). The file stays unchanged.
+//	ReadInputFile() always reads the file into a heap buffer. Use it when the output overwrites the input file.
+//	IsSameFile() returns 1 when both names refer to the same existing file (checked via device/inode).
+//	MapOutputFile() creates the output file with the specified size and maps it for writing.
+//		Returns 1 when that isn't possible, the caller writes the file normally then.
+//	UnmapFile() releases the file. Output files are truncated to finalLen bytes (ignored for input files).
+uint8_t MapInputFile(const char* fileName, FILE_MAP* map);
+uint8_t MapInputFileCopy(const char* fileName, FILE_MAP* map);
+uint8_t ReadInputFile(const char* fileName, FILE_MAP* map);
+uint8_t IsSameFile(const char* fileName1, const char* fileName2);
+uint8_t MapOutputFile(const char* fileName, size_t size, FILE_MAP* map);
+void UnmapFile(FILE_MAP* map, size_t finalLen);
+
+#endif // FILEMAP_H
@@ -6,6 +6,7 @@
 #include <string.h>
 
 #include "stdtype.h"
+#include "file-map.h"
 
 
 static void DecompressFile(UINT32 inLen, const UINT8* inData, const char* fileName);
@@ -18,9 +19,9 @@ static UINT32 ReadLE32(const UINT8* Data);
 int main(int argc, char* argv[])
 {
 	int argbase;
-	FILE* hFile;
 	UINT32 inLen;
 	UINT8* inData;
+	FILE_MAP inMap;
 	UINT8 fileFmt;
 	
 	printf("Genocide Square Decompressor\n----------------------------\n");
@@ -54,20 +55,12 @@ int main(int argc, char* argv[])
 		return 0;
 	}
 	
-	hFile = fopen(argv[argbase + 0], "rb");
-	if (hFile == NULL)
+	// the output may overwrite the input file, so it must not stay mapped then
+	if (IsSameFile(argv[argbase + 0], argv[argbase + 1]) ? ReadInputFile(argv[argbase + 0], &inMap) :
+		MapInputFile(argv[argbase + 0], &inMap))
 		return 1;
-	
-	fseek(hFile, 0, SEEK_END);
-	inLen = ftell(hFile);
-	if (inLen > 0x1000000)
-		inLen = 0x1000000;	// limit to 16 MB
-	
-	inData = (UINT8*)malloc(inLen);
-	fseek(hFile, 0, SEEK_SET);
-	fread(inData, 0x01, inLen, hFile);
-	
-	fclose(hFile);
+	inLen = inMap.len;
+	inData = inMap.data;
 	
 	switch(fileFmt)
 	{
@@ -82,7 +75,7 @@ int main(int argc, char* argv[])
 		break;
 	}
 	
-	free(inData);
+	UnmapFile(&inMap, 0);
 	
 	return 0;
 }
@@ -7,6 +7,7 @@
 #include <string.h>
 
 #include "stdtype.h"
+#include "file-map.h"
 
 
 static UINT8 DetectFileType(UINT32 fileSize, const UINT8* fileData, const char* fileName);
@@ -20,9 +21,9 @@ static UINT32 ReadLE32(const UINT8* Data);
 int main(int argc, char* argv[])
 {
 	int argbase;
-	FILE* hFile;
 	UINT32 inLen;
 	UINT8* inData;
+	FILE_MAP inMap;
 	UINT8 fileFmt;
 	
 	printf("Kenji Decompressor\n------------------\n");
@@ -57,20 +58,12 @@ int main(int argc, char* argv[])
 		return 0;
 	}
 	
-	hFile = fopen(argv[argbase + 0], "rb");
-	if (hFile == NULL)
+	// the output may overwrite the input file, so it must not stay mapped then
+	if (IsSameFile(argv[argbase + 0], argv[argbase + 1]) ? ReadInputFile(argv[argbase + 0], &inMap) :
+		MapInputFile(argv[argbase + 0], &inMap))
 		return 1;
-	
-	fseek(hFile, 0, SEEK_END);
-	inLen = ftell(hFile);
-	if (inLen > 0x100000)
-		inLen = 0x100000;	// limit to 1 MB
-	
-	inData = (UINT8*)malloc(inLen);
-	fseek(hFile, 0, SEEK_SET);
-	fread(inData, 0x01, inLen, hFile);
-	
-	fclose(hFile);
+	inLen = inMap.len;
+	inData = inMap.data;
 	
 	if (fileFmt == 0)
 	{
@@ -90,7 +83,7 @@ int main(int argc, char* argv[])
 		break;
 	}
 	
-	free(inData);
+	UnmapFile(&inMap, 0);
 	
 	return 0;
 }
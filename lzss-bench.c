@@ -0,0 +1,1055 @@
+/* LZSS library benchmark
+   measures lzss-lib encoding speed and compression ratio on a synthetic corpus
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "lzss-lib.h"
+
+#ifndef _WIN32
+#include <sys/resource.h>	// for getrusage()
+#endif
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#include <intrin.h>
+#define HAVE_TSC
+#define ReadTSC()	__rdtsc()
+#elif defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#include <x86intrin.h>
+#define HAVE_TSC
+#define ReadTSC()	__rdtsc()
+#endif
+
+
+typedef struct corpus_item
+{
+	const char* name;
+	size_t len;
+	uint8_t* data;
+} CORPUS_ITEM;
+
+#define CORPUS_COUNT	6
+
+typedef struct benchmark
+{
+	const char* name;
+	const char* desc;
+	void (*func)(const CORPUS_ITEM* corpus);
+} BENCHMARK;
+
+
+static const BENCHMARK* FindBenchmark(const char* name);
+static void PrintHelp(const char* appName);
+static void GenerateCorpus(CORPUS_ITEM* corpus, size_t itemSize);
+static void FreeCorpus(CORPUS_ITEM* corpus);
+static int CheckAllLayouts(const CORPUS_ITEM* corpus);
+static void BenchMatchFinders(const CORPUS_ITEM* corpus);
+static void BenchLevels(const CORPUS_ITEM* corpus);
+static void BenchParallel(const CORPUS_ITEM* corpus);
+static void BenchParsers(const CORPUS_ITEM* corpus);
+static void BenchStore(const CORPUS_ITEM* corpus);
+static void BenchDecoders(const CORPUS_ITEM* corpus);
+static void BenchContexts(const CORPUS_ITEM* corpus);
+static void BenchConfigs(const CORPUS_ITEM* corpus);
+static uint8_t ChunkedDecode(LZSS_COMPR* lzss, size_t bufSize, uint8_t* buffer, size_t* bytesWritten, size_t inSize, const uint8_t* inData);
+static uint8_t ChunkedEncode(LZSS_COMPR* lzss, size_t bufSize, uint8_t* buffer, size_t* bytesWritten, size_t inSize, const uint8_t* inData);
+static uint8_t RoundTrip(const LZSS_CFG* cfg, size_t inLen, const uint8_t* inData, size_t* encLen);
+static double TimeEncode(const LZSS_CFG* cfg, size_t inLen, const uint8_t* inData, size_t* encLen);
+static double TimeEncodeParallel(const LZSS_CFG* cfg, size_t inLen, const uint8_t* inData, size_t* encLen, unsigned int threads);
+static double TimeDecode(const LZSS_CFG* cfg, size_t inLen, const uint8_t* inData, size_t decLen, int sizeOnly);
+static double TimeSmallFiles(const LZSS_CFG* cfg, size_t fileCount, size_t fileSize, const uint8_t* data, unsigned int ctxMode);
+static void JsonBegin(size_t itemSize);
+static void JsonEnd(void);
+
+
+static const BENCHMARK BENCHMARKS[] =
+{
+	{"mf", "match finder engines (encoding)", BenchMatchFinders},
+	{"lvl", "compression levels 0..9 (ratio vs. encoding speed)", BenchLevels},
+	{"opt", "greedy vs. lazy vs. optimal parsing (encoding)", BenchParsers},
+	{"store", "incompressible data detection off vs. auto (encoding)", BenchStore},
+	{"par", "parallel encoding with 1..8 threads (whole corpus as one input)", BenchParallel},
+	{"dec", "generic vs. specialized decoder and size query for all 16 stream layouts", BenchDecoders},
+	{"ctx", "context setup cost when processing many small files", BenchContexts},
+	{"cfg", "encoding + decoding for all stream layouts and name tables (verified, JSON output)", BenchConfigs},
+	{NULL, NULL, NULL},
+};
+static const char* MF_NAMES[] = {"tree", "hash"};
+
+#define CTX_CREATE	0x00	// lzssCreate/lzssDestroy for each file
+#define CTX_REUSE	0x01	// one context for all files
+#define CTX_POOL	0x02	// lzssPoolAcquire/lzssPoolRelease for each file
+#define CTX_ARENA	0x03	// lzssCreateInArena for each file, reusing the arena
+static const char* CTX_NAMES[] = {"create", "reuse", "pool", "arena"};
+static double MinBenchTime = 0.5;	// minimum measuring time per benchmark, in seconds
+static FILE* JsonFile = NULL;		// receives the results of benchmarks with JSON output (-j)
+static unsigned int JsonItems;		// number of results written to JsonFile
+static int BenchErrors = 0;			// number of failed round trips during benchmarks
+
+
+int main(int argc, char* argv[])
+{
+	CORPUS_ITEM corpus[CORPUS_COUNT];
+	size_t itemSize;
+	int argbase;
+	int curArg;
+	int doCheck;
+	int errors;
+
+	itemSize = 0x100000;
+	doCheck = 0;
+	argbase = 1;
+	while(argbase < argc)
+	{
+		if (!strcmp(argv[argbase], "-h"))
+		{
+			PrintHelp(argv[0]);
+			return 0;
+		}
+		else if (!strcmp(argv[argbase], "-s"))	// corpus item size
+		{
+			argbase ++;
+			if (argbase >= argc)
+			{
+				fprintf(stderr, "Insufficient arguments.\n");
+				return 1;
+			}
+			itemSize = (size_t)strtoul(argv[argbase], NULL, 0) * 1024;
+			if (itemSize == 0)
+				itemSize = 1024;
+		}
+		else if (!strcmp(argv[argbase], "-t"))	// minimum time per benchmark
+		{
+			argbase ++;
+			if (argbase >= argc)
+			{
+				fprintf(stderr, "Insufficient arguments.\n");
+				return 1;
+			}
+			MinBenchTime = strtod(argv[argbase], NULL);
+		}
+		else if (!strcmp(argv[argbase], "-c"))	// check all stream layouts
+		{
+			doCheck = 1;
+		}
+		else if (!strcmp(argv[argbase], "-j"))	// JSON output file
+		{
+			argbase ++;
+			if (argbase >= argc)
+			{
+				fprintf(stderr, "Insufficient arguments.\n");
+				return 1;
+			}
+			if (!strcmp(argv[argbase], "-"))
+				JsonFile = stdout;
+			else
+				JsonFile = fopen(argv[argbase], "wt");
+			if (JsonFile == NULL)
+			{
+				fprintf(stderr, "Error opening JSON file: %s\n", argv[argbase]);
+				return 1;
+			}
+		}
+		else if (argv[argbase][0] == '-')
+		{
+			fprintf(stderr, "Unknown option: %s\n", argv[argbase]);
+			return 1;
+		}
+		else
+		{
+			break;
+		}
+		argbase ++;
+	}
+	for (curArg = argbase; curArg < argc; curArg ++)
+	{
+		if (FindBenchmark(argv[curArg]) == NULL)
+		{
+			fprintf(stderr, "Unknown benchmark: %s\n", argv[curArg]);
+			return 1;
+		}
+	}
+
+	GenerateCorpus(corpus, itemSize);
+	errors = 0;
+	if (doCheck)
+		errors = CheckAllLayouts(corpus);
+	JsonBegin(itemSize);
+	if (argbase >= argc)
+	{
+		// no benchmarks specified - run all of them
+		const BENCHMARK* bm;
+		for (bm = BENCHMARKS; bm->name != NULL; bm++)
+			bm->func(corpus);
+	}
+	else
+	{
+		for (curArg = argbase; curArg < argc; curArg ++)
+			FindBenchmark(argv[curArg])->func(corpus);
+	}
+	JsonEnd();
+	FreeCorpus(corpus);
+
+	return (errors || BenchErrors) ? 2 : 0;
+}
+
+static const BENCHMARK* FindBenchmark(const char* name)
+{
+	const BENCHMARK* bm;
+
+	for (bm = BENCHMARKS; bm->name != NULL; bm++)
+	{
+		if (!strcmp(bm->name, name))
+			return bm;
+	}
+	return NULL;
+}
+
+static void PrintHelp(const char* appName)
+{
+	const BENCHMARK* bm;
+
+	fprintf(stderr, "Usage: %s [options] [benchmarks]\n", appName);
+	fprintf(stderr, "\n");
+	fprintf(stderr, "Options:\n");
+	fprintf(stderr, "    -h    show this help screen\n");
+	fprintf(stderr, "    -s n  size of each corpus item in KB (default: 1024)\n");
+	fprintf(stderr, "    -t n  minimum measuring time per benchmark in seconds (default: 0.5)\n");
+	fprintf(stderr, "    -c    verify round trips for all stream layouts first\n");
+	fprintf(stderr, "    -j f  write results as JSON to file f (- = stdout), for benchmarks that support it\n");
+	fprintf(stderr, "\n");
+	fprintf(stderr, "Benchmarks: (default: all)\n");
+	for (bm = BENCHMARKS; bm->name != NULL; bm++)
+		fprintf(stderr, "    %-6s %s\n", bm->name, bm->desc);
+	return;
+}
+
+static unsigned int rngState;
+
+static unsigned int Random32(void)
+{
+	// xorshift32
+	rngState ^= rngState << 13;
+	rngState ^= rngState >> 17;
+	rngState ^= rngState << 5;
+	return rngState;
+}
+
+static void GenerateCorpus(CORPUS_ITEM* corpus, size_t itemSize)
+{
+	static const char* WORDS[] = {
+		"the", "music", "driver", "sound", "track", "loop", "channel", "volume", "note", "game",
+		"archive", "file", "data", "compressed", "header", "offset", "length", "stage", "boss", "end",
+	};
+	size_t pos;
+	unsigned int i;
+
+	rngState = 0x12345678;
+	for (i = 0; i < CORPUS_COUNT; i++)
+	{
+		corpus[i].len = itemSize;
+		corpus[i].data = (uint8_t*)malloc(itemSize);
+	}
+
+	// text: random words from a small vocabulary
+	corpus[0].name = "text";
+	pos = 0;
+	while(pos < itemSize)
+	{
+		const char* word = WORDS[Random32() % 20];
+		while(*word != '\0' && pos < itemSize)
+			corpus[0].data[pos++] = (uint8_t)*word++;
+		if (pos < itemSize)
+			corpus[0].data[pos++] = (Random32() % 12) ? ' ' : '\n';
+	}
+
+	// MIDI-like event stream: delta time, status byte, note, velocity
+	corpus[1].name = "events";
+	pos = 0;
+	while(pos < itemSize)
+	{
+		uint8_t ev[4];
+		unsigned int rnd = Random32();
+		ev[0] = (uint8_t)((rnd & 0x03) * 0x18);
+		ev[1] = (uint8_t)(0x90 | ((rnd >> 2) & 0x03));
+		ev[2] = (uint8_t)(0x30 + ((rnd >> 4) % 24));
+		ev[3] = (rnd & 0x100) ? 0x00 : 0x64;
+		for (i = 0; i < 4 && pos < itemSize; i++)
+			corpus[1].data[pos++] = ev[i];
+	}
+
+	// 8-bit PCM: triangle wave with a bit of noise
+	corpus[2].name = "pcm8";
+	for (pos = 0; pos < itemSize; pos++)
+	{
+		unsigned int phase = (unsigned int)(pos % 200);
+		int smpl = (phase < 100) ? (int)phase : (int)(200 - phase);
+		smpl = 0x80 - 50 + smpl + (int)(Random32() % 3) - 1;
+		corpus[2].data[pos] = (uint8_t)smpl;
+	}
+
+	// 16-bit PCM (Little Endian): sawtooth with noise in the low byte
+	corpus[3].name = "pcm16";
+	for (pos = 0; pos + 1 < itemSize; pos += 2)
+	{
+		unsigned int phase = (unsigned int)((pos / 2) % 150);
+		int smpl = (int)(phase * 400) - 30000 + (int)(Random32() % 64) - 32;
+		corpus[3].data[pos + 0] = (uint8_t)(smpl & 0xFF);
+		corpus[3].data[pos + 1] = (uint8_t)((smpl >> 8) & 0xFF);
+	}
+	if (pos < itemSize)
+		corpus[3].data[pos] = 0x00;
+
+	// long runs of zeros, interrupted by short bursts of data
+	corpus[4].name = "zeros";
+	for (pos = 0; pos < itemSize; pos++)
+		corpus[4].data[pos] = ((pos & 0xFFF) < 0x20) ? (uint8_t)Random32() : 0x00;
+
+	// random data (incompressible), must be the last item
+	corpus[5].name = "random";
+	for (pos = 0; pos < itemSize; pos++)
+		corpus[5].data[pos] = (uint8_t)(Random32() >> 24);
+
+	return;
+}
+
+static void FreeCorpus(CORPUS_ITEM* corpus)
+{
+	unsigned int i;
+
+	for (i = 0; i < CORPUS_COUNT; i++)
+		free(corpus[i].data);
+	return;
+}
+
+static uint8_t RoundTrip(const LZSS_CFG* cfg, size_t inLen, const uint8_t* inData, size_t* encLen)
+{
+	LZSS_COMPR* lzss;
+	size_t encBufLen = inLen + inLen / 8 + 4;
+	uint8_t* encBuf = (uint8_t*)malloc(encBufLen);
+	uint8_t* decBuf = (uint8_t*)malloc(inLen + 1);
+	size_t decLen;
+	uint8_t ret;
+
+	lzss = lzssCreate(cfg);
+	ret = lzssEncode(lzss, encBufLen, encBuf, encLen, inLen, inData);
+	if (ret == LZSS_ERR_OK)
+	{
+		ret = lzssDecode(lzss, inLen + 1, decBuf, &decLen, *encLen, encBuf);
+		if (ret == LZSS_ERR_OK && (decLen != inLen || memcmp(decBuf, inData, inLen)))
+			ret = 0xFF;
+	}
+	if (ret == LZSS_ERR_OK)
+	{
+		LZSS_CFG genCfg = *cfg;
+		LZSS_COMPR* genLzss;
+		genCfg.decoder = LZSS_DEC_GENERIC;
+		genLzss = lzssCreate(&genCfg);
+		ret = lzssDecode(genLzss, inLen + 1, decBuf, &decLen, *encLen, encBuf);
+		if (ret == LZSS_ERR_OK && (decLen != inLen || memcmp(decBuf, inData, inLen)))
+			ret = 0xFC;
+		lzssDestroy(genLzss);
+	}
+	if (ret == LZSS_ERR_OK)
+	{
+		LZSS_CFG tblCfg = *cfg;
+		LZSS_COMPR* tblLzss;
+		tblCfg.decoder = LZSS_DEC_TABLE;
+		tblLzss = lzssCreate(&tblCfg);
+		ret = lzssDecode(tblLzss, inLen + 1, decBuf, &decLen, *encLen, encBuf);
+		if (ret == LZSS_ERR_OK && (decLen != inLen || memcmp(decBuf, inData, inLen)))
+			ret = 0xFB;
+		lzssDestroy(tblLzss);
+	}
+	if (ret == LZSS_ERR_OK)
+	{
+		ret = ChunkedDecode(lzss, inLen + 1, decBuf, &decLen, *encLen, encBuf);
+		if (ret == LZSS_ERR_OK && (decLen != inLen || memcmp(decBuf, inData, inLen)))
+			ret = 0xFE;
+	}
+	if (ret == LZSS_ERR_OK && cfg->parser == LZSS_PARSE_GREEDY)	// the incremental encoder parses greedily
+	{
+		uint8_t* chkBuf = (uint8_t*)malloc(encBufLen);
+		size_t chkLen;
+		ret = ChunkedEncode(lzss, encBufLen, chkBuf, &chkLen, inLen, inData);
+		if (ret == LZSS_ERR_OK && (chkLen != *encLen || memcmp(chkBuf, encBuf, chkLen)))
+			ret = 0xFD;
+		free(chkBuf);
+	}
+	lzssDestroy(lzss);
+	free(encBuf);
+	free(decBuf);
+	return ret;
+}
+
+static uint8_t ChunkedDecode(LZSS_COMPR* lzss, size_t bufSize, uint8_t* buffer, size_t* bytesWritten, size_t inSize, const uint8_t* inData)
+{
+	// decode using the incremental API, feeding and draining slices of varying sizes
+	size_t inPos = 0;
+	size_t outPos = 0;
+	unsigned int slice = 0;
+	uint8_t ret;
+
+	lzssDecodeBegin(lzss);
+	do
+	{
+		size_t inLen = 1 + (slice % 7);
+		size_t outLen = 1 + (slice % 5) * 3;
+		size_t decLen, readLen;
+		if (inLen > inSize - inPos)
+			inLen = inSize - inPos;
+		if (outLen > bufSize - outPos)
+			outLen = bufSize - outPos;
+		ret = lzssDecodeChunk(lzss, outLen, &buffer[outPos], &decLen, inLen, &inData[inPos], &readLen);
+		inPos += readLen;
+		outPos += decLen;
+		slice ++;
+		if (ret != LZSS_ERR_OK && ret != LZSS_ERR_EOF_OUT)
+			break;
+		if (ret == LZSS_ERR_EOF_OUT && outPos >= bufSize)
+			break;
+	} while(inPos < inSize || ret == LZSS_ERR_EOF_OUT);
+	if (ret == LZSS_ERR_OK)
+		ret = lzssDecodeEnd(lzss);
+
+	*bytesWritten = outPos;
+	return ret;
+}
+
+static uint8_t ChunkedEncode(LZSS_COMPR* lzss, size_t bufSize, uint8_t* buffer, size_t* bytesWritten, size_t inSize, const uint8_t* inData)
+{
+	// encode using the incremental API, feeding and draining slices of varying sizes
+	size_t inPos = 0;
+	size_t outPos = 0;
+	unsigned int slice = 0;
+	uint8_t ret;
+
+	lzssEncodeBegin(lzss);
+	do
+	{
+		size_t inLen = 1 + (slice % 11) * 5;
+		size_t outLen = 1 + (slice % 4);
+		size_t encLen, readLen;
+		if (inLen > inSize - inPos)
+			inLen = inSize - inPos;
+		if (outLen > bufSize - outPos)
+			outLen = bufSize - outPos;
+		ret = lzssEncodeChunk(lzss, outLen, &buffer[outPos], &encLen, inLen, &inData[inPos], &readLen);
+		inPos += readLen;
+		outPos += encLen;
+		slice ++;
+	} while(inPos < inSize && (ret == LZSS_ERR_OK || outPos < bufSize));
+	do
+	{
+		size_t outLen = 1 + (slice % 4);
+		size_t encLen;
+		if (outLen > bufSize - outPos)
+			outLen = bufSize - outPos;
+		ret = lzssEncodeEnd(lzss, outLen, &buffer[outPos], &encLen);
+		outPos += encLen;
+		slice ++;
+	} while(ret == LZSS_ERR_EOF_OUT && outPos < bufSize);
+
+	*bytesWritten = outPos;
+	return ret;
+}
+
+static int CheckAllLayouts(const CORPUS_ITEM* corpus)
+{
+	static const uint8_t NT_TYPES[] = {LZSS_NTINIT_VALUE, LZSS_NTINIT_FUNC, LZSS_NTINIT_NONE};
+	static const char* NT_NAMES[] = {"value", "func", "none"};
+	// N, F, THRESHOLD
+	static const unsigned int GEOMETRIES[][3] =
+		{{0x1000, 18, 2}, {0x2000, 9, 2}, {0x400, 65, 1}, {0x100, 66, 1}, {0x8000, 3, 1}};
+	unsigned int geo, mf, layout, nt, eos, item;
+	unsigned int tests = 0;
+	int errors = 0;
+
+	printf("Checking round trips for all stream layouts ...\n");
+	for (geo = 0; geo < sizeof(GEOMETRIES) / sizeof(GEOMETRIES[0]); geo++)
+	for (mf = LZSS_MF_TREE; mf <= LZSS_MF_HASH; mf++)
+	for (layout = 0x00; layout < 0x10; layout++)
+	for (nt = 0; nt < 3; nt++)
+	for (eos = LZSS_EOSM_NONE; eos <= LZSS_EOSM_REF0; eos++)
+	{
+		LZSS_CFG cfg;
+		lzssGetDefaultConfig(&cfg);
+		cfg.flags = (uint8_t)(((layout & 0x01) ? LZSS_FLAGS_CTRL_M : LZSS_FLAGS_CTRL_L) | ((layout & 0x0E) << 3));
+		cfg.nameTblType = NT_TYPES[nt];
+		cfg.nameTblFunc = lzssNameTbl_CommonPatterns;
+		cfg.eosMode = (uint8_t)eos;
+		cfg.matchFinder = (uint8_t)mf;
+		cfg.N = GEOMETRIES[geo][0];
+		cfg.F = GEOMETRIES[geo][1];
+		cfg.THRESHOLD = GEOMETRIES[geo][2];
+		for (item = 0; item < CORPUS_COUNT; item++)
+		{
+			size_t len = (corpus[item].len < 0x8000) ? corpus[item].len : 0x8000;
+			size_t encLen;
+			uint8_t ret;
+			cfg.level = (uint8_t)(tests % 10);	// cycle through the compression levels
+			cfg.parser = (uint8_t)((tests / 10) % 2);	// ... with both parsers
+			cfg.storeMode = (uint8_t)((tests / 20) % 2);	// ... and incompressible data detection
+			ret = RoundTrip(&cfg, len, corpus[item].data, &encLen);
+			tests ++;
+			if (ret != LZSS_ERR_OK)
+			{
+				printf("FAILED: N 0x%X, F %u, THRESHOLD %u, mf %s, level %u, parser %u, store %u, flags 0x%02X, name table %s, EOS mode %u, corpus %s: error %u\n",
+					cfg.N, cfg.F, cfg.THRESHOLD, MF_NAMES[mf], cfg.level, cfg.parser, cfg.storeMode, cfg.flags, NT_NAMES[nt], eos, corpus[item].name, ret);
+				errors ++;
+			}
+		}
+	}
+	printf("%u round trips, %d errors\n\n", tests, errors);
+	return errors;
+}
+
+static double TimeEncode(const LZSS_CFG* cfg, size_t inLen, const uint8_t* inData, size_t* encLen)
+{
+	LZSS_COMPR* lzss;
+	size_t encBufLen = inLen + inLen / 8 + 4;
+	uint8_t* encBuf = (uint8_t*)malloc(encBufLen);
+	clock_t start, elapsed;
+	unsigned int runs;
+
+	lzss = lzssCreate(cfg);
+	runs = 0;
+	start = clock();
+	do
+	{
+		lzssEncode(lzss, encBufLen, encBuf, encLen, inLen, inData);
+		runs ++;
+		elapsed = clock() - start;
+	} while((double)elapsed / CLOCKS_PER_SEC < MinBenchTime);
+	lzssDestroy(lzss);
+	free(encBuf);
+
+	// return MB/s
+	return (double)inLen * runs / 1048576.0 / ((double)elapsed / CLOCKS_PER_SEC);
+}
+
+static void BenchMatchFinders(const CORPUS_ITEM* corpus)
+{
+	unsigned int item, mf;
+
+	printf("Match finder benchmark (encoding, default configuration)\n");
+	printf("%-8s %-5s %10s %10s %8s %10s\n", "corpus", "mf", "in", "out", "ratio", "MB/s");
+	for (item = 0; item < CORPUS_COUNT; item++)
+	{
+		for (mf = LZSS_MF_TREE; mf <= LZSS_MF_HASH; mf++)
+		{
+			LZSS_CFG cfg;
+			size_t encLen;
+			double speed;
+
+			lzssGetDefaultConfig(&cfg);
+			cfg.matchFinder = (uint8_t)mf;
+			speed = TimeEncode(&cfg, corpus[item].len, corpus[item].data, &encLen);
+			printf("%-8s %-5s %10u %10u %7.2f%% %10.2f\n", corpus[item].name, MF_NAMES[mf],
+				(unsigned)corpus[item].len, (unsigned)encLen, 100.0 * encLen / corpus[item].len, speed);
+		}
+	}
+	printf("\n");
+	return;
+}
+
+static void BenchLevels(const CORPUS_ITEM* corpus)
+{
+	unsigned int item, mf, level;
+
+	printf("Compression level benchmark (encoding, default configuration)\n");
+	printf("%-8s %-5s %5s %10s %8s %10s\n", "corpus", "mf", "level", "out", "ratio", "MB/s");
+	for (item = 0; item < CORPUS_COUNT; item++)
+	{
+		for (mf = LZSS_MF_TREE; mf <= LZSS_MF_HASH; mf++)
+		{
+			for (level = 0; level <= 9; level++)
+			{
+				LZSS_CFG cfg;
+				size_t encLen;
+				double speed;
+
+				lzssGetDefaultConfig(&cfg);
+				cfg.matchFinder = (uint8_t)mf;
+				cfg.level = (uint8_t)level;
+				speed = TimeEncode(&cfg, corpus[item].len, corpus[item].data, &encLen);
+				printf("%-8s %-5s %5u %10u %7.2f%% %10.2f\n", corpus[item].name, MF_NAMES[mf], level,
+					(unsigned)encLen, 100.0 * encLen / corpus[item].len, speed);
+			}
+		}
+	}
+	printf("\n");
+	return;
+}
+
+static void BenchStore(const CORPUS_ITEM* corpus)
+{
+	static const char* STORE_NAMES[] = {"off", "auto"};
+	unsigned int item, mf, store;
+
+	printf("Incompressible data detection benchmark (encoding, default configuration)\n");
+	printf("%-8s %-5s %-5s %10s %8s %10s\n", "corpus", "mf", "store", "out", "ratio", "MB/s");
+	for (item = 0; item < CORPUS_COUNT; item++)
+	{
+		for (mf = LZSS_MF_TREE; mf <= LZSS_MF_HASH; mf++)
+		{
+			for (store = LZSS_STORE_OFF; store <= LZSS_STORE_AUTO; store++)
+			{
+				LZSS_CFG cfg;
+				size_t encLen;
+				double speed;
+
+				lzssGetDefaultConfig(&cfg);
+				cfg.matchFinder = (uint8_t)mf;
+				cfg.storeMode = (uint8_t)store;
+				speed = TimeEncode(&cfg, corpus[item].len, corpus[item].data, &encLen);
+				printf("%-8s %-5s %-5s %10u %7.2f%% %10.2f\n", corpus[item].name, MF_NAMES[mf], STORE_NAMES[store],
+					(unsigned)encLen, 100.0 * encLen / corpus[item].len, speed);
+			}
+		}
+	}
+	printf("\n");
+	return;
+}
+
+static void BenchParsers(const CORPUS_ITEM* corpus)
+{
+	// parser, level
+	static const uint8_t MODES[][2] = {{LZSS_PARSE_GREEDY, 0}, {LZSS_PARSE_GREEDY, 9}, {LZSS_PARSE_OPTIMAL, 0}};
+	static const char* MODE_NAMES[] = {"greedy", "lazy", "optimal"};
+	unsigned int item, mf, mode;
+
+	printf("Parser benchmark (encoding, default configuration, lazy = level 9)\n");
+	printf("%-8s %-5s %-8s %10s %8s %8s %10s %8s\n", "corpus", "mf", "parser", "out", "ratio", "gain", "MB/s", "time");
+	for (item = 0; item < CORPUS_COUNT; item++)
+	{
+		for (mf = LZSS_MF_TREE; mf <= LZSS_MF_HASH; mf++)
+		{
+			size_t greedyLen = 0;
+			double greedySpeed = 0.0;
+			for (mode = 0; mode < sizeof(MODES) / sizeof(MODES[0]); mode++)
+			{
+				LZSS_CFG cfg;
+				size_t encLen;
+				double speed;
+
+				lzssGetDefaultConfig(&cfg);
+				cfg.matchFinder = (uint8_t)mf;
+				cfg.parser = MODES[mode][0];
+				cfg.level = MODES[mode][1];
+				speed = TimeEncode(&cfg, corpus[item].len, corpus[item].data, &encLen);
+				if (mode == 0)
+				{
+					greedyLen = encLen;
+					greedySpeed = speed;
+				}
+				// gain: output size saved vs. greedy, time: encoding time relative to greedy
+				printf("%-8s %-5s %-8s %10u %7.2f%% %7.2f%% %10.2f %7.2fx\n", corpus[item].name, MF_NAMES[mf], MODE_NAMES[mode],
+					(unsigned)encLen, 100.0 * encLen / corpus[item].len, 100.0 - 100.0 * encLen / greedyLen,
+					speed, greedySpeed / speed);
+			}
+		}
+	}
+	printf("\n");
+	return;
+}
+
+static double TimeEncodeParallel(const LZSS_CFG* cfg, size_t inLen, const uint8_t* inData, size_t* encLen, unsigned int threads)
+{
+	LZSS_COMPR* lzss;
+	size_t encBufLen = lzssEncodeBound(cfg, inLen);
+	uint8_t* encBuf = (uint8_t*)malloc(encBufLen);
+	struct timespec start, now;
+	double elapsed;
+	unsigned int runs;
+
+	// measure wall clock time, clock() would sum up the CPU time of all threads
+	lzss = lzssCreate(cfg);
+	runs = 0;
+	timespec_get(&start, TIME_UTC);
+	do
+	{
+		lzssEncodeParallel(lzss, encBufLen, encBuf, encLen, inLen, inData, threads);
+		runs ++;
+		timespec_get(&now, TIME_UTC);
+		elapsed = (double)(now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) / 1.0E+9;
+	} while(elapsed < MinBenchTime);
+	lzssDestroy(lzss);
+	free(encBuf);
+
+	// return MB/s
+	return (double)inLen * runs / 1048576.0 / elapsed;
+}
+
+static void BenchParallel(const CORPUS_ITEM* corpus)
+{
+	static const unsigned int THREADS[] = {1, 2, 4, 8};
+	size_t inLen, pos;
+	uint8_t* inData;
+	unsigned int item, mf, thr;
+
+	inLen = 0;
+	for (item = 0; item < CORPUS_COUNT; item++)
+		inLen += corpus[item].len;
+	inData = (uint8_t*)malloc(inLen);
+	for (pos = 0, item = 0; item < CORPUS_COUNT; item++)
+	{
+		memcpy(&inData[pos], corpus[item].data, corpus[item].len);
+		pos += corpus[item].len;
+	}
+
+	printf("Parallel encoding benchmark (default configuration, %u bytes, wall clock time)\n", (unsigned)inLen);
+	printf("%-5s %7s %10s %8s %10s %8s\n", "mf", "threads", "out", "ratio", "MB/s", "speedup");
+	for (mf = LZSS_MF_TREE; mf <= LZSS_MF_HASH; mf++)
+	{
+		double speed1 = 0.0;
+		for (thr = 0; thr < sizeof(THREADS) / sizeof(THREADS[0]); thr++)
+		{
+			LZSS_CFG cfg;
+			size_t encLen;
+			double speed;
+
+			lzssGetDefaultConfig(&cfg);
+			cfg.matchFinder = (uint8_t)mf;
+			speed = TimeEncodeParallel(&cfg, inLen, inData, &encLen, THREADS[thr]);
+			if (thr == 0)
+				speed1 = speed;
+			printf("%-5s %7u %10u %7.2f%% %10.2f %7.2fx\n", MF_NAMES[mf], THREADS[thr],
+				(unsigned)encLen, 100.0 * encLen / inLen, speed, speed / speed1);
+		}
+	}
+	printf("\n");
+	free(inData);
+	return;
+}
+
+static double TimeDecode(const LZSS_CFG* cfg, size_t inLen, const uint8_t* inData, size_t decLen, int sizeOnly)
+{
+	LZSS_COMPR* lzss;
+	uint8_t* decBuf = (uint8_t*)malloc(decLen);
+	clock_t start, elapsed;
+	unsigned int runs;
+
+	lzss = lzssCreate(cfg);
+	runs = 0;
+	start = clock();
+	do
+	{
+		if (sizeOnly)
+			lzssDecodedSize(lzss, inLen, inData, NULL);
+		else
+			lzssDecode(lzss, decLen, decBuf, NULL, inLen, inData);
+		runs ++;
+		elapsed = clock() - start;
+	} while((double)elapsed / CLOCKS_PER_SEC < MinBenchTime);
+	lzssDestroy(lzss);
+	free(decBuf);
+
+	// return MB/s of decoded data
+	return (double)decLen * runs / 1048576.0 / ((double)elapsed / CLOCKS_PER_SEC);
+}
+
+static void BenchDecoders(const CORPUS_ITEM* corpus)
+{
+	unsigned int layout, item;
+	size_t totalLen;
+	uint8_t* decData;
+	uint8_t* encData;
+	size_t encBufLen;
+
+	// decode all corpus items but the random data in one go
+	totalLen = 0;
+	for (item = 0; item < CORPUS_COUNT - 1; item++)
+		totalLen += corpus[item].len;
+	decData = (uint8_t*)malloc(totalLen);
+	totalLen = 0;
+	for (item = 0; item < CORPUS_COUNT - 1; item++)
+	{
+		memcpy(&decData[totalLen], corpus[item].data, corpus[item].len);
+		totalLen += corpus[item].len;
+	}
+	encBufLen = totalLen + totalLen / 8 + 4;
+	encData = (uint8_t*)malloc(encBufLen);
+
+	printf("Decoder benchmark (%u bytes of mixed data)\n", (unsigned)totalLen);
+	printf("%-6s %12s %12s %12s %8s %12s\n", "flags", "generic MB/s", "table MB/s", "special MB/s", "speedup", "size MB/s");
+	for (layout = 0x00; layout < 0x10; layout++)
+	{
+		LZSS_CFG cfg;
+		LZSS_COMPR* lzss;
+		size_t encLen;
+		double speedGen, speedTbl, speedSpc, speedSize;
+
+		lzssGetDefaultConfig(&cfg);
+		cfg.flags = (uint8_t)(((layout & 0x01) ? LZSS_FLAGS_CTRL_M : LZSS_FLAGS_CTRL_L) | ((layout & 0x0E) << 3));
+		cfg.matchFinder = LZSS_MF_HASH;
+		lzss = lzssCreate(&cfg);
+		lzssEncode(lzss, encBufLen, encData, &encLen, totalLen, decData);
+		lzssDestroy(lzss);
+
+		cfg.decoder = LZSS_DEC_GENERIC;
+		speedGen = TimeDecode(&cfg, encLen, encData, totalLen, 0);
+		cfg.decoder = LZSS_DEC_TABLE;
+		speedTbl = TimeDecode(&cfg, encLen, encData, totalLen, 0);
+		cfg.decoder = LZSS_DEC_AUTO;
+		speedSpc = TimeDecode(&cfg, encLen, encData, totalLen, 0);
+		speedSize = TimeDecode(&cfg, encLen, encData, totalLen, 1);	// lzssDecodedSize
+		printf("0x%02X   %12.2f %12.2f %12.2f %7.2fx %12.2f\n", cfg.flags, speedGen, speedTbl, speedSpc, speedSpc / speedGen, speedSize);
+	}
+	printf("\n");
+	free(encData);
+	free(decData);
+	return;
+}
+
+static double TimeSmallFiles(const LZSS_CFG* cfg, size_t fileCount, size_t fileSize, const uint8_t* data, unsigned int ctxMode)
+{
+	size_t encBufLen = lzssEncodeBound(cfg, fileSize);
+	uint8_t* encBuf = (uint8_t*)malloc(encBufLen);
+	uint8_t* decBuf = (uint8_t*)malloc(fileSize);
+	void* arena = malloc(lzssGetContextSize(cfg));
+	LZSS_COMPR* shared = lzssCreate(cfg);
+	LZSS_POOL* pool = lzssPoolCreate(cfg, 4);
+	clock_t start, elapsed;
+	unsigned int runs;
+	size_t file;
+
+	runs = 0;
+	start = clock();
+	do
+	{
+		for (file = 0; file < fileCount; file++)
+		{
+			LZSS_COMPR* lzss;
+			size_t encLen;
+
+			if (ctxMode == CTX_CREATE)
+				lzss = lzssCreate(cfg);
+			else if (ctxMode == CTX_POOL)
+				lzss = lzssPoolAcquire(pool);
+			else if (ctxMode == CTX_ARENA)
+				lzss = lzssCreateInArena(cfg, arena, lzssGetContextSize(cfg));
+			else
+				lzss = shared;
+			lzssEncode(lzss, encBufLen, encBuf, &encLen, fileSize, &data[file * fileSize]);
+			lzssDecode(lzss, fileSize, decBuf, NULL, encLen, encBuf);
+			if (ctxMode == CTX_CREATE || ctxMode == CTX_ARENA)
+				lzssDestroy(lzss);
+			else if (ctxMode == CTX_POOL)
+				lzssPoolRelease(pool, lzss);
+		}
+		runs ++;
+		elapsed = clock() - start;
+	} while((double)elapsed / CLOCKS_PER_SEC < MinBenchTime);
+	lzssPoolDestroy(pool);
+	lzssDestroy(shared);
+	free(arena);
+	free(decBuf);
+	free(encBuf);
+
+	// return microseconds per file
+	return (double)elapsed / CLOCKS_PER_SEC * 1000000.0 / ((double)fileCount * runs);
+}
+
+static void BenchContexts(const CORPUS_ITEM* corpus)
+{
+	static const size_t FILE_SIZES[] = {0x40, 0x400, 0x4000};
+	static const uint8_t NT_TYPES[] = {LZSS_NTINIT_VALUE, LZSS_NTINIT_FUNC};
+	static const char* NT_NAMES[] = {"value", "func"};
+	unsigned int mf, nt, sizeIdx, ctxMode;
+
+	// encode + decode many small files, taken from the text item
+	printf("Context benchmark (encode + decode per file, text data)\n");
+	printf("%-5s %-6s %6s", "mf", "ntbl", "size");
+	for (ctxMode = CTX_CREATE; ctxMode <= CTX_ARENA; ctxMode++)
+		printf(" %9s us", CTX_NAMES[ctxMode]);
+	printf("\n");
+	for (mf = LZSS_MF_TREE; mf <= LZSS_MF_HASH; mf++)
+	for (nt = 0; nt < 2; nt++)
+	for (sizeIdx = 0; sizeIdx < sizeof(FILE_SIZES) / sizeof(FILE_SIZES[0]); sizeIdx++)
+	{
+		LZSS_CFG cfg;
+		size_t fileSize = FILE_SIZES[sizeIdx];
+		size_t fileCount = corpus[0].len / fileSize;
+
+		if (fileCount == 0)
+			continue;
+		if (fileCount > 0x1000)
+			fileCount = 0x1000;
+		lzssGetDefaultConfig(&cfg);
+		cfg.matchFinder = (uint8_t)mf;
+		cfg.nameTblType = NT_TYPES[nt];
+		cfg.nameTblFunc = lzssNameTbl_CommonPatterns;
+		printf("%-5s %-6s %6u", MF_NAMES[mf], NT_NAMES[nt], (unsigned)fileSize);
+		for (ctxMode = CTX_CREATE; ctxMode <= CTX_ARENA; ctxMode++)
+			printf(" %12.2f", TimeSmallFiles(&cfg, fileCount, fileSize, corpus[0].data, ctxMode));
+		printf("\n");
+	}
+	printf("\n");
+	return;
+}
+
+static void JsonBegin(size_t itemSize)
+{
+	if (JsonFile == NULL)
+		return;
+	fprintf(JsonFile, "{\n");
+	fprintf(JsonFile, "  \"corpus_item_size\": %u,\n", (unsigned)itemSize);
+	fprintf(JsonFile, "  \"results\": [");
+	JsonItems = 0;
+	return;
+}
+
+static void JsonEnd(void)
+{
+	long maxRSS = -1;	// peak resident memory of the whole process in KB, -1 = unknown
+#ifndef _WIN32
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) == 0)
+		maxRSS = usage.ru_maxrss;
+#endif
+
+	if (JsonFile == NULL)
+		return;
+	fprintf(JsonFile, "%s  ],\n", JsonItems ? "\n" : "");
+	if (maxRSS >= 0)
+		fprintf(JsonFile, "  \"process_max_rss_kb\": %ld\n", maxRSS);
+	else
+		fprintf(JsonFile, "  \"process_max_rss_kb\": null\n");
+	fprintf(JsonFile, "}\n");
+	if (JsonFile != stdout)
+		fclose(JsonFile);
+	JsonFile = NULL;
+	return;
+}
+
+static void JsonNumber(const char* key, double value, int last)
+{
+	// JSON has no representation for "unavailable" numbers, use null
+	if (value < 0.0)
+		fprintf(JsonFile, "\"%s\": null%s", key, last ? "" : ", ");
+	else
+		fprintf(JsonFile, "\"%s\": %.4f%s", key, value, last ? "" : ", ");
+	return;
+}
+
+typedef struct codec_result
+{
+	size_t encLen;
+	double encSpeed;	// MB/s of input data
+	double decSpeed;	// MB/s of decoded data
+	double encCPB;		// TSC cycles per input byte, < 0 = unknown
+	double decCPB;
+	uint8_t error;		// round trip result, see RoundTrip()
+} CODEC_RESULT;
+
+static void MeasureCodec(const LZSS_CFG* cfg, size_t inLen, const uint8_t* inData, double minTime, CODEC_RESULT* res)
+{
+	LZSS_COMPR* lzss;
+	size_t encBufLen = lzssEncodeBound(cfg, inLen);
+	uint8_t* encBuf = (uint8_t*)malloc(encBufLen);
+	uint8_t* decBuf = (uint8_t*)malloc(inLen + 1);
+	size_t decLen = 0;
+	clock_t start, elapsed;
+	unsigned int runs;
+#ifdef HAVE_TSC
+	unsigned long long tscStart;
+#endif
+
+	// check all encoders/decoders first, then time the regular one-shot functions
+	res->error = RoundTrip(cfg, inLen, inData, &res->encLen);
+	res->encCPB = res->decCPB = -1.0;
+	lzss = lzssCreate(cfg);
+
+	runs = 0;
+#ifdef HAVE_TSC
+	tscStart = ReadTSC();
+#endif
+	start = clock();
+	do
+	{
+		lzssEncode(lzss, encBufLen, encBuf, &res->encLen, inLen, inData);
+		runs ++;
+		elapsed = clock() - start;
+	} while((double)elapsed / CLOCKS_PER_SEC < minTime);
+#ifdef HAVE_TSC
+	res->encCPB = (double)(ReadTSC() - tscStart) / ((double)inLen * runs);
+#endif
+	res->encSpeed = (double)inLen * runs / 1048576.0 / ((double)elapsed / CLOCKS_PER_SEC);
+
+	runs = 0;
+#ifdef HAVE_TSC
+	tscStart = ReadTSC();
+#endif
+	start = clock();
+	do
+	{
+		lzssDecode(lzss, inLen + 1, decBuf, &decLen, res->encLen, encBuf);
+		runs ++;
+		elapsed = clock() - start;
+	} while((double)elapsed / CLOCKS_PER_SEC < minTime);
+#ifdef HAVE_TSC
+	res->decCPB = (double)(ReadTSC() - tscStart) / ((double)inLen * runs);
+#endif
+	res->decSpeed = (double)inLen * runs / 1048576.0 / ((double)elapsed / CLOCKS_PER_SEC);
+	// the timed run must produce the original data as well
+	if (res->error == LZSS_ERR_OK && (decLen != inLen || memcmp(decBuf, inData, inLen)))
+		res->error = 0xFF;
+
+	lzssDestroy(lzss);
+	free(encBuf);
+	free(decBuf);
+	return;
+}
+
+static void BenchConfigs(const CORPUS_ITEM* corpus)
+{
+	static const uint8_t NT_TYPES[] = {LZSS_NTINIT_VALUE, LZSS_NTINIT_FUNC, LZSS_NTINIT_NONE};
+	static const char* NT_NAMES[] = {"value", "func", "none"};
+	unsigned int layout, nt, item;
+	double minTime = MinBenchTime / 10;	// 48 configurations per item - keep the total time reasonable
+
+	printf("Configuration benchmark (default geometry, each result verified by a round trip)\n");
+	printf("%-5s %-6s %-8s %8s %10s %10s %8s %8s %8s %s\n", "flags", "ntbl", "corpus", "ratio",
+		"enc MB/s", "dec MB/s", "enc c/B", "dec c/B", "ctx KB", "");
+	for (layout = 0x00; layout < 0x10; layout++)
+	for (nt = 0; nt < 3; nt++)
+	for (item = 0; item < CORPUS_COUNT; item++)
+	{
+		LZSS_CFG cfg;
+		CODEC_RESULT res;
+		size_t ctxSize;
+		double ratio;
+
+		lzssGetDefaultConfig(&cfg);
+		cfg.flags = (uint8_t)(((layout & 0x01) ? LZSS_FLAGS_CTRL_M : LZSS_FLAGS_CTRL_L) | ((layout & 0x0E) << 3));
+		cfg.nameTblType = NT_TYPES[nt];
+		cfg.nameTblFunc = lzssNameTbl_CommonPatterns;
+		ctxSize = lzssGetContextSize(&cfg);	// all memory the library allocates for encoding/decoding
+		MeasureCodec(&cfg, corpus[item].len, corpus[item].data, minTime, &res);
+		ratio = (double)res.encLen / corpus[item].len;
+		if (res.error != LZSS_ERR_OK)
+			BenchErrors ++;
+		printf("0x%02X  %-6s %-8s %7.2f%% %10.2f %10.2f %8.2f %8.2f %8.1f %s\n", cfg.flags, NT_NAMES[nt], corpus[item].name,
+			100.0 * ratio, res.encSpeed, res.decSpeed, res.encCPB, res.decCPB, ctxSize / 1024.0,
+			(res.error != LZSS_ERR_OK) ? "ROUND TRIP FAILED" : "");
+
+		if (JsonFile != NULL)
+		{
+			fprintf(JsonFile, "%s\n    {", JsonItems ? "," : "");
+			fprintf(JsonFile, "\"benchmark\": \"cfg\", \"flags\": %u, \"name_table\": \"%s\", \"corpus\": \"%s\", ",
+				cfg.flags, NT_NAMES[nt], corpus[item].name);
+			fprintf(JsonFile, "\"in_bytes\": %u, \"out_bytes\": %u, ", (unsigned)corpus[item].len, (unsigned)res.encLen);
+			JsonNumber("ratio", ratio, 0);
+			JsonNumber("enc_mb_s", res.encSpeed, 0);
+			JsonNumber("dec_mb_s", res.decSpeed, 0);
+			JsonNumber("enc_cycles_per_byte", res.encCPB, 0);
+			JsonNumber("dec_cycles_per_byte", res.decCPB, 0);
+			fprintf(JsonFile, "\"context_bytes\": %u, \"verified\": %s}", (unsigned)ctxSize,
+				(res.error == LZSS_ERR_OK) ? "true" : "false");
+			JsonItems ++;
+		}
+	}
+	printf("%d errors\n\n", BenchErrors);
+	return;
+}
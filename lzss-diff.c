@@ -0,0 +1,847 @@
+/* LZSS decoder differential test
+   compares the hand-written LZSS decoders of the extraction tools with lzss-lib
+   and measures the speed of both
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "lzss-lib.h"
+
+// The tool sources are included directly, as their decoders are static and share names.
+// Everything that collides is renamed per tool.
+#define main			kenji_main
+#define DecompressFile	kenji_DecompressFile
+#define DecompressArchive	kenji_DecompressArchive
+#define LZSS_BufInit	kenji_LZSS_BufInit
+#define LZSS_Decode		kenji_LZSS_Decode
+#define ReadLE16		kenji_ReadLE16
+#define ReadLE32		kenji_ReadLE32
+#include "kenji_dec.c"
+#undef main
+#undef DecompressFile
+#undef DecompressArchive
+#undef LZSS_BufInit
+#undef LZSS_Decode
+#undef ReadLE16
+#undef ReadLE32
+#undef N
+#undef F
+#undef THRESHOLD
+
+#define main			wolfteam_main
+#define DecompressFile	wolfteam_DecompressFile
+#define LZSS_BufInit	wolfteam_LZSS_BufInit
+#define LZSS_Decode		wolfteam_LZSS_Decode
+#define ReadLE16		wolfteam_ReadLE16
+#define ReadLE32		wolfteam_ReadLE32
+#define ReadBE16		wolfteam_ReadBE16
+#define ReadBE32		wolfteam_ReadBE32
+#include "wolfteam_dec.c"
+#undef main
+#undef DecompressFile
+#undef LZSS_BufInit
+#undef LZSS_Decode
+#undef ReadLE16
+#undef ReadLE32
+#undef ReadBE16
+#undef ReadBE32
+#undef N
+#undef F
+#undef THRESHOLD
+
+#define main			gensqu_main
+#define DecompressFile	gensqu_DecompressFile
+#define DecompressArchive	gensqu_DecompressArchive
+#define LZSS_Decode		gensqu_LZSS_Decode
+#define ReadLE16		gensqu_ReadLE16
+#define ReadLE32		gensqu_ReadLE32
+#include "gensqu_dec.c"
+#undef main
+#undef DecompressFile
+#undef DecompressArchive
+#undef LZSS_Decode
+#undef ReadLE16
+#undef ReadLE32
+
+#define main			x68k_main
+#define DecompressFile	x68k_DecompressFile
+#define ReadBE16		x68k_ReadBE16
+#define ReadBE32		x68k_ReadBE32
+#include "x68k_sps_dec.c"
+#undef main
+#undef DecompressFile
+#undef ReadBE16
+#undef ReadBE32
+
+#define main			mrn_main
+#define DecompressFile	mrn_DecompressFile
+#define ReadLE16		mrn_ReadLE16
+#include "mrndec.c"
+#undef main
+#undef DecompressFile
+#undef ReadLE16
+
+
+typedef size_t (*OLD_DECODE)(size_t inLen, const uint8_t* inData, size_t outLen, uint8_t* outData);
+
+typedef struct test_stream
+{
+	uint8_t* enc;			// compressed data
+	size_t encLen;
+	uint8_t* dec;			// expected decoded data
+	size_t decLen;
+	size_t decTarget;		// generators stop once this many bytes were produced
+
+	// control words
+	unsigned int ctrlWidth;	// size in bytes (1 or 2, 2 = Little Endian)
+	uint8_t ctrlMSB;		// 1 = bits are used from the highest bit on
+	uint8_t ctrlEager;		// 1 = the next control word is read right after the last bit was used
+	size_t ctrlPos;			// position of the current control word in enc
+	unsigned int ctrlBits;	// unused bits of the current control word
+	uint8_t ring[0x1000];	// ring buffer (Okumura-style formats)
+	unsigned int r;
+} TEST_STREAM;
+
+typedef struct decoder_variant
+{
+	const char* name;
+	OLD_DECODE oldDecode;
+	void (*generate)(TEST_STREAM* ts);
+	void (*setupCfg)(LZSS_CFG* cfg);	// NULL = there is no lzss-lib equivalent yet
+	unsigned int nameTblDefined;	// initialized part of the tool's name table (ring buffer formats)
+	uint8_t ctrlMSB;				// control bit order (ring buffer formats)
+	uint8_t lenFirst;				// 1 = the byte with the length nibble comes first (ring buffer formats)
+} DECODER_VARIANT;
+
+
+static size_t Old_Kenji(size_t inLen, const uint8_t* inData, size_t outLen, uint8_t* outData);
+static size_t Old_Wolfteam(size_t inLen, const uint8_t* inData, size_t outLen, uint8_t* outData);
+static size_t Old_GenSqu(size_t inLen, const uint8_t* inData, size_t outLen, uint8_t* outData);
+static size_t Old_SPSv1(size_t inLen, const uint8_t* inData, size_t outLen, uint8_t* outData);
+static size_t Old_SPSv2(size_t inLen, const uint8_t* inData, size_t outLen, uint8_t* outData);
+static size_t Old_SPSv3(size_t inLen, const uint8_t* inData, size_t outLen, uint8_t* outData);
+static size_t Old_MRN(size_t inLen, const uint8_t* inData, size_t outLen, uint8_t* outData);
+static void Gen_Okumura(TEST_STREAM* ts);
+static void Gen_SPSv1(TEST_STREAM* ts);
+static void Gen_SPSv2(TEST_STREAM* ts);
+static void Gen_SPSv3(TEST_STREAM* ts);
+static void Gen_GenSqu(TEST_STREAM* ts);
+static void Gen_MRN(TEST_STREAM* ts);
+static void Cfg_Patterns(LZSS_CFG* cfg);
+static void Cfg_SPSv1(LZSS_CFG* cfg);
+static void GenerateStream(const DECODER_VARIANT* dv, TEST_STREAM* ts, size_t decTarget);
+static void FreeStream(TEST_STREAM* ts);
+static size_t DefinedLength(const DECODER_VARIANT* dv, size_t inLen, const uint8_t* inData, size_t outLen);
+static unsigned int TestVariant(const DECODER_VARIANT* dv, unsigned int iterations);
+static void BenchVariant(const DECODER_VARIANT* dv);
+
+
+static const DECODER_VARIANT VARIANTS[] =
+{
+	{"kenji", Old_Kenji, Gen_Okumura, Cfg_Patterns, 0x1000 - 18, 0, 0},
+	{"wolfteam", Old_Wolfteam, Gen_Okumura, Cfg_Patterns, 0x1000 - 18, 0, 0},
+	{"sps-v1", Old_SPSv1, Gen_SPSv1, Cfg_SPSv1, 0x1000, 1, 1},
+	{"sps-v2", Old_SPSv2, Gen_SPSv2, NULL, 0, 1, 1},
+	{"sps-v3", Old_SPSv3, Gen_SPSv3, NULL, 0, 1, 0},
+	{"gensqu", Old_GenSqu, Gen_GenSqu, NULL, 0, 1, 0},
+	{"mrn", Old_MRN, Gen_MRN, NULL, 0, 0, 0},
+	{NULL, NULL, NULL, NULL, 0, 0, 0},
+};
+static double MinBenchTime = 0.5;	// minimum measuring time per decoder, in seconds
+static unsigned int rngState = 0x12345678;
+
+
+int main(int argc, char* argv[])
+{
+	const DECODER_VARIANT* dv;
+	unsigned int iterations;
+	unsigned int mismatches;
+	int argbase;
+
+	iterations = 1000;
+	argbase = 1;
+	while(argbase < argc)
+	{
+		if (!strcmp(argv[argbase], "-h"))
+		{
+			printf("Usage: %s [options] [variants]\n", argv[0]);
+			printf("\n");
+			printf("Options:\n");
+			printf("    -i n  number of test streams per decoder (default: 1000)\n");
+			printf("    -s n  random seed (default: 0x12345678)\n");
+			printf("    -t n  minimum measuring time per decoder in seconds (default: 0.5, 0 = no benchmark)\n");
+			printf("\n");
+			printf("Variants: (default: all)\n   ");
+			for (dv = VARIANTS; dv->name != NULL; dv++)
+				printf(" %s", dv->name);
+			printf("\n");
+			return 0;
+		}
+		else if (!strcmp(argv[argbase], "-i") && argbase + 1 < argc)
+		{
+			argbase ++;
+			iterations = (unsigned int)strtoul(argv[argbase], NULL, 0);
+		}
+		else if (!strcmp(argv[argbase], "-s") && argbase + 1 < argc)
+		{
+			argbase ++;
+			rngState = (unsigned int)strtoul(argv[argbase], NULL, 0);
+			if (rngState == 0)
+				rngState = 1;	// xorshift gets stuck at 0
+		}
+		else if (!strcmp(argv[argbase], "-t") && argbase + 1 < argc)
+		{
+			argbase ++;
+			MinBenchTime = strtod(argv[argbase], NULL);
+		}
+		else if (argv[argbase][0] == '-')
+		{
+			fprintf(stderr, "Unknown option: %s\n", argv[argbase]);
+			return 1;
+		}
+		else
+		{
+			break;
+		}
+		argbase ++;
+	}
+
+	mismatches = 0;
+	printf("Differential test (%u streams per decoder)\n", iterations);
+	for (dv = VARIANTS; dv->name != NULL; dv++)
+	{
+		int curArg;
+		for (curArg = argbase; curArg < argc; curArg ++)
+		{
+			if (!strcmp(argv[curArg], dv->name))
+				break;
+		}
+		if (argbase < argc && curArg >= argc)
+			continue;
+		mismatches += TestVariant(dv, iterations);
+		if (MinBenchTime > 0.0)
+			BenchVariant(dv);
+	}
+	printf("%u mismatches\n", mismatches);
+
+	return mismatches ? 2 : 0;
+}
+
+static unsigned int Random32(void)
+{
+	// xorshift32
+	rngState ^= rngState << 13;
+	rngState ^= rngState >> 17;
+	rngState ^= rngState << 5;
+	return rngState;
+}
+
+static size_t Old_Kenji(size_t inLen, const uint8_t* inData, size_t outLen, uint8_t* outData)
+{
+	return kenji_LZSS_Decode((UINT32)inLen, inData, (UINT32)outLen, outData);
+}
+
+static size_t Old_Wolfteam(size_t inLen, const uint8_t* inData, size_t outLen, uint8_t* outData)
+{
+	return wolfteam_LZSS_Decode((UINT32)inLen, inData, (UINT32)outLen, outData);
+}
+
+static size_t Old_GenSqu(size_t inLen, const uint8_t* inData, size_t outLen, uint8_t* outData)
+{
+	return gensqu_LZSS_Decode((UINT32)inLen, inData, (UINT32)outLen, outData);
+}
+
+static size_t Old_SPSv1(size_t inLen, const uint8_t* inData, size_t outLen, uint8_t* outData)
+{
+	return LZSS_Decode_v1((UINT32)inLen, inData, (UINT32)outLen, outData);
+}
+
+static size_t Old_SPSv2(size_t inLen, const uint8_t* inData, size_t outLen, uint8_t* outData)
+{
+	return LZSS_Decode_v2((UINT32)inLen, inData, (UINT32)outLen, outData);
+}
+
+static size_t Old_SPSv3(size_t inLen, const uint8_t* inData, size_t outLen, uint8_t* outData)
+{
+	return LZSS_Decode_v3((UINT32)inLen, inData, (UINT32)outLen, outData);
+}
+
+static size_t Old_MRN(size_t inLen, const uint8_t* inData, size_t outLen, uint8_t* outData)
+{
+	size_t readLen;
+	return MRN_Decode(inLen, inData, outLen, outData, &readLen);
+}
+
+static void Cfg_Patterns(LZSS_CFG* cfg)
+{
+	// standard LZSS.C stream with the name table of Arcus Odyssey/Wolf Team
+	cfg->flags = LZSS_FLAGS_CTRL_L | LZSS_FLAGS_MTCH_DEFAULT;
+	cfg->nameTblType = LZSS_NTINIT_FUNC;
+	cfg->nameTblFunc = lzssNameTbl_CommonPatterns;
+	return;
+}
+
+static void Cfg_SPSv1(LZSS_CFG* cfg)
+{
+	// lzss-tool -n 0 -C 1 -R 0x05
+	cfg->flags = LZSS_FLAGS_CTRL_M | LZSS_FLAGS_MTCH_EBIG | LZSS_FLAGS_MTCH_L_HL;
+	cfg->nameTblType = LZSS_NTINIT_VALUE;
+	cfg->nameTblValue = 0x00;
+	return;
+}
+
+// --- stream writing ---
+static void PutByte(TEST_STREAM* ts, uint8_t val)
+{
+	ts->enc[ts->encLen++] = val;
+	return;
+}
+
+static void StartCtrlWord(TEST_STREAM* ts)
+{
+	unsigned int curByte;
+
+	ts->ctrlPos = ts->encLen;
+	for (curByte = 0; curByte < ts->ctrlWidth; curByte ++)
+		PutByte(ts, 0x00);
+	ts->ctrlBits = ts->ctrlWidth * 8;
+	return;
+}
+
+static void PutBit(TEST_STREAM* ts, unsigned int bit)
+{
+	unsigned int bitPos;
+
+	if (ts->ctrlBits == 0)
+		StartCtrlWord(ts);
+	ts->ctrlBits --;
+	bitPos = ts->ctrlMSB ? ts->ctrlBits : (ts->ctrlWidth * 8 - 1 - ts->ctrlBits);
+	if (bit)
+		ts->enc[ts->ctrlPos + bitPos / 8] |= (uint8_t)(1 << (bitPos % 8));
+	if (ts->ctrlEager && ts->ctrlBits == 0)
+		StartCtrlWord(ts);
+	return;
+}
+
+static uint8_t RandomLiteral(void)
+{
+	// mostly a small alphabet, so that the data looks a bit like text
+	unsigned int rnd = Random32();
+	return (rnd & 0x300) ? (uint8_t)('a' + (rnd >> 12) % 8) : (uint8_t)(rnd >> 16);
+}
+
+static unsigned int RandomDistance(size_t decLen, unsigned int maxDist)
+{
+	// prefer short distances, but cover the whole range
+	unsigned int limit = (decLen < maxDist) ? (unsigned int)decLen : maxDist;
+	unsigned int rnd = Random32();
+	if ((rnd & 0x03) && limit > 0x20)
+		limit = 0x20;
+	return 1 + (rnd >> 8) % limit;
+}
+
+// output copy from distance dist, for formats that reference the decoded data
+static void CopyOutput(TEST_STREAM* ts, unsigned int dist, unsigned int len)
+{
+	while(len > 0)
+	{
+		ts->dec[ts->decLen] = ts->dec[ts->decLen - dist];
+		ts->decLen ++;
+		len --;
+	}
+	return;
+}
+
+// --- stream generators ---
+//	Each one produces valid units of its format in random order and keeps the expected output.
+
+static void GenRingFormat(TEST_STREAM* ts, unsigned int nameTblDefined, uint8_t lenFirst)
+{
+	while(ts->decLen < ts->decTarget)
+	{
+		unsigned int rnd = Random32();
+		if ((rnd & 0x03) == 0 || ts->decLen == 0)
+		{
+			uint8_t c = RandomLiteral();
+			PutBit(ts, 1);
+			PutByte(ts, c);
+			ts->dec[ts->decLen++] = c;
+			ts->ring[ts->r] = c;
+			ts->r = (ts->r + 1) & 0xFFF;
+		}
+		else
+		{
+			unsigned int len = 3 + (rnd >> 4) % 16;
+			unsigned int ofs;
+			unsigned int k;
+			if ((rnd & 0x1C) == 0)
+			{
+				// reference into the name table (or whatever overwrote it)
+				// The tools initialize only part of it, the rest is valid after the first F bytes were written.
+				unsigned int limit = (ts->decLen < 18) ? nameTblDefined : 0x1000;
+				ofs = (rnd >> 8) % (limit - len);
+			}
+			else
+			{
+				ofs = (ts->r - RandomDistance(ts->decLen, 0xFFF)) & 0xFFF;
+			}
+			PutBit(ts, 0);
+			if (lenFirst)
+			{
+				PutByte(ts, (uint8_t)(((ofs >> 4) & 0xF0) | (len - 3)));
+				PutByte(ts, (uint8_t)(ofs & 0xFF));
+			}
+			else
+			{
+				PutByte(ts, (uint8_t)(ofs & 0xFF));
+				PutByte(ts, (uint8_t)(((ofs >> 4) & 0xF0) | (len - 3)));
+			}
+			for (k = 0; k < len; k ++)
+			{
+				uint8_t c = ts->ring[(ofs + k) & 0xFFF];
+				ts->dec[ts->decLen++] = c;
+				ts->ring[ts->r] = c;
+				ts->r = (ts->r + 1) & 0xFFF;
+			}
+		}
+	}
+	return;
+}
+
+static void Gen_Okumura(TEST_STREAM* ts)
+{
+	ts->ctrlWidth = 1;	ts->ctrlMSB = 0;	ts->ctrlEager = 0;
+	lzssNameTbl_CommonPatterns(NULL, NULL, 0x1000, ts->ring);
+	ts->r = 0x1000 - 18;
+	GenRingFormat(ts, 0x1000 - 18, 0);
+	return;
+}
+
+static void Gen_SPSv1(TEST_STREAM* ts)
+{
+	ts->ctrlWidth = 1;	ts->ctrlMSB = 1;	ts->ctrlEager = 0;
+	memset(ts->ring, 0x00, 0x1000);
+	ts->r = 0x1000 - 18;
+	GenRingFormat(ts, 0x1000, 1);
+	return;
+}
+
+static void Gen_SPSv2(TEST_STREAM* ts)
+{
+	ts->ctrlWidth = 1;	ts->ctrlMSB = 1;	ts->ctrlEager = 0;
+	while(ts->decLen < ts->decTarget)
+	{
+		unsigned int rnd = Random32();
+		if ((rnd & 0x03) == 0 || ts->decLen == 0)
+		{
+			PutBit(ts, 1);
+			PutByte(ts, ts->dec[ts->decLen++] = RandomLiteral());
+		}
+		else
+		{
+			unsigned int len = 3 + (rnd >> 4) % 16;
+			unsigned int dist = RandomDistance(ts->decLen, 0xFFF);
+			PutBit(ts, 0);
+			PutByte(ts, (uint8_t)(((dist >> 4) & 0xF0) | (len - 3)));
+			PutByte(ts, (uint8_t)(dist & 0xFF));
+			CopyOutput(ts, dist, len);
+		}
+	}
+	return;
+}
+
+static void Gen_SPSv3(TEST_STREAM* ts)
+{
+	ts->ctrlWidth = 1;	ts->ctrlMSB = 1;	ts->ctrlEager = 0;
+	while(ts->decLen < ts->decTarget)
+	{
+		unsigned int rnd = Random32();
+		if ((rnd & 0x03) == 0 || ts->decLen == 0)
+		{
+			PutBit(ts, 1);
+			PutByte(ts, ts->dec[ts->decLen++] = RandomLiteral());
+		}
+		else if (rnd & 0x04)
+		{
+			// short reference: 3 bits length (2..9), distance 1..0x100
+			unsigned int len = 2 + (rnd >> 4) % 8;
+			unsigned int dist = RandomDistance(ts->decLen, 0x100);
+			PutBit(ts, 0);
+			PutBit(ts, 1);
+			PutBit(ts, (len - 2) & 0x04);
+			PutBit(ts, (len - 2) & 0x02);
+			PutBit(ts, (len - 2) & 0x01);
+			PutByte(ts, (uint8_t)(0x100 - dist));
+			CopyOutput(ts, dist, len);
+		}
+		else
+		{
+			// long reference: distance 1..0x2000, length 2..8 or 1..255 with an extra byte
+			unsigned int dist = RandomDistance(ts->decLen, 0x2000);
+			unsigned int ofs = 0x2000 - dist;
+			unsigned int len;
+			PutBit(ts, 0);
+			PutBit(ts, 0);
+			if (rnd & 0x08)
+			{
+				len = 2 + (rnd >> 4) % 7;
+				PutByte(ts, (uint8_t)(((ofs >> 5) & 0xF8) | (len - 1)));
+			}
+			else
+			{
+				len = 1 + (rnd >> 4) % 255;
+				PutByte(ts, (uint8_t)((ofs >> 5) & 0xF8));
+				PutByte(ts, (uint8_t)len);
+			}
+			PutByte(ts, (uint8_t)(ofs & 0xFF));
+			CopyOutput(ts, dist, len);
+		}
+	}
+	// end marker
+	PutBit(ts, 0);
+	PutBit(ts, 0);
+	PutByte(ts, 0x00);
+	PutByte(ts, 0x00);
+	return;
+}
+
+static void Gen_GenSqu(TEST_STREAM* ts)
+{
+	ts->ctrlWidth = 1;	ts->ctrlMSB = 1;	ts->ctrlEager = 0;
+	while(ts->decLen < ts->decTarget)
+	{
+		unsigned int rnd = Random32();
+		if ((rnd & 0x03) == 0 || ts->decLen == 0)
+		{
+			PutBit(ts, 1);
+			PutByte(ts, ts->dec[ts->decLen++] = RandomLiteral());
+		}
+		else if ((rnd & 0x0C) == 0)
+		{
+			// repeat the last byte 2..256 times
+			unsigned int len = 2 + (rnd >> 4) % 255;
+			PutBit(ts, 0);
+			PutBit(ts, 1);
+			PutByte(ts, (uint8_t)(len - 1));
+			CopyOutput(ts, 1, len);
+		}
+		else if (rnd & 0x10)
+		{
+			// short reference: 2 bits length (2..4), distance 1..0x100
+			unsigned int len = 2 + (rnd >> 5) % 3;
+			unsigned int dist = RandomDistance(ts->decLen, 0x100);
+			PutBit(ts, 0);
+			PutBit(ts, 0);
+			PutBit(ts, (len - 1) & 0x02);
+			PutBit(ts, (len - 1) & 0x01);
+			PutByte(ts, (uint8_t)(0x100 - dist));
+			CopyOutput(ts, dist, len);
+		}
+		else
+		{
+			// long reference: length 1..16, distance 1..0x1000
+			unsigned int len = 1 + (rnd >> 5) % 16;
+			unsigned int dist = RandomDistance(ts->decLen, 0x1000);
+			unsigned int word = (((0x1000 - dist) & 0xFFF) << 4) | (len - 1);
+			PutBit(ts, 0);
+			PutBit(ts, 0);
+			PutBit(ts, 0);
+			PutBit(ts, 0);
+			PutByte(ts, (uint8_t)(word & 0xFF));
+			PutByte(ts, (uint8_t)(word >> 8));
+			CopyOutput(ts, dist, len);
+		}
+	}
+	// end marker
+	PutBit(ts, 0);
+	PutBit(ts, 1);
+	PutByte(ts, 0x00);
+	return;
+}
+
+static void Gen_MRN(TEST_STREAM* ts)
+{
+	ts->ctrlWidth = 2;	ts->ctrlMSB = 0;	ts->ctrlEager = 1;
+	StartCtrlWord(ts);	// the first control word is read before anything else
+	while(ts->decLen < ts->decTarget)
+	{
+		unsigned int rnd = Random32();
+		if ((rnd & 0x03) == 0 || ts->decLen == 0)
+		{
+			PutBit(ts, 1);
+			PutByte(ts, ts->dec[ts->decLen++] = RandomLiteral());
+		}
+		else if (rnd & 0x04)
+		{
+			// short reference: 2 bits length (2..5), distance 1..0x100
+			unsigned int len = 2 + (rnd >> 4) % 4;
+			unsigned int dist = RandomDistance(ts->decLen, 0x100);
+			PutBit(ts, 0);
+			PutBit(ts, 0);
+			PutBit(ts, (len - 2) & 0x02);
+			PutBit(ts, (len - 2) & 0x01);
+			PutByte(ts, (uint8_t)(0x100 - dist));
+			CopyOutput(ts, dist, len);
+		}
+		else
+		{
+			// long reference: distance 1..0x2000, length 3..9 or 3..256 with an extra byte
+			unsigned int dist = RandomDistance(ts->decLen, 0x2000);
+			unsigned int word = (0x2000 - dist) & 0x1FFF;
+			unsigned int len;
+			PutBit(ts, 0);
+			PutBit(ts, 1);
+			if ((rnd & 0xF8) == 0)
+			{
+				// "segment reset" command, produces no data
+				PutByte(ts, (uint8_t)(word & 0xFF));
+				PutByte(ts, (uint8_t)(word >> 8));
+				PutByte(ts, 0x00);
+				continue;
+			}
+			if (rnd & 0x08)
+			{
+				len = 3 + (rnd >> 4) % 7;
+				word |= (len - 2) << 13;
+				PutByte(ts, (uint8_t)(word & 0xFF));
+				PutByte(ts, (uint8_t)(word >> 8));
+			}
+			else
+			{
+				len = 3 + (rnd >> 4) % 254;
+				PutByte(ts, (uint8_t)(word & 0xFF));
+				PutByte(ts, (uint8_t)(word >> 8));
+				PutByte(ts, (uint8_t)(len - 1));
+			}
+			CopyOutput(ts, dist, len);
+		}
+	}
+	// end marker
+	PutBit(ts, 0);
+	PutBit(ts, 1);
+	PutByte(ts, 0x00);
+	PutByte(ts, 0x00);
+	PutByte(ts, 0x01);
+	return;
+}
+
+static void GenerateStream(const DECODER_VARIANT* dv, TEST_STREAM* ts, size_t decTarget)
+{
+	// a unit produces at most 256 bytes and takes at most 2 control words + 3 bytes
+	ts->decTarget = decTarget;
+	ts->dec = (uint8_t*)malloc(decTarget + 0x100);
+	ts->enc = (uint8_t*)malloc(decTarget * 2 + 0x10);
+	ts->decLen = 0;
+	ts->encLen = 0;
+	ts->ctrlBits = 0;
+	dv->generate(ts);
+	return;
+}
+
+static void FreeStream(TEST_STREAM* ts)
+{
+	free(ts->enc);
+	free(ts->dec);
+	return;
+}
+
+// Returns the number of output bytes that don't depend on the part of the name table
+// that the tool leaves uninitialized. Only ring buffer formats have such a part.
+static size_t DefinedLength(const DECODER_VARIANT* dv, size_t inLen, const uint8_t* inData, size_t outLen)
+{
+	uint8_t defined[0x1000];
+	size_t inPos = 0;
+	size_t outPos = 0;
+	unsigned int r = 0x1000 - 18;
+	unsigned int flags = 0;
+	unsigned int flagBits = 0;
+
+	if (dv->nameTblDefined >= 0x1000)
+		return outLen;
+	memset(defined, 1, dv->nameTblDefined);
+	memset(&defined[dv->nameTblDefined], 0, 0x1000 - dv->nameTblDefined);
+	while(inPos < inLen && outPos < outLen)
+	{
+		unsigned int bit;
+		if (flagBits == 0)
+		{
+			flags = inData[inPos++];
+			flagBits = 8;
+		}
+		bit = dv->ctrlMSB ? (flags & 0x80) : (flags & 0x01);
+		flags = dv->ctrlMSB ? (flags << 1) : (flags >> 1);
+		flagBits --;
+		if (bit)
+		{
+			if (inPos >= inLen)
+				break;
+			inPos ++;
+			defined[r] = 1;
+			r = (r + 1) & 0xFFF;
+			outPos ++;
+		}
+		else
+		{
+			unsigned int b0, b1, ofs, len, k;
+			if (inPos + 1 >= inLen)
+				break;
+			b0 = inData[inPos++];
+			b1 = inData[inPos++];
+			if (dv->lenFirst)
+			{
+				ofs = b1 | ((b0 & 0xF0) << 4);
+				len = (b0 & 0x0F) + 3;
+			}
+			else
+			{
+				ofs = b0 | ((b1 & 0xF0) << 4);
+				len = (b1 & 0x0F) + 3;
+			}
+			for (k = 0; k < len && outPos < outLen; k ++)
+			{
+				if (! defined[(ofs + k) & 0xFFF])
+					return outPos;
+				defined[r] = 1;
+				r = (r + 1) & 0xFFF;
+				outPos ++;
+			}
+		}
+	}
+	return outLen;
+}
+
+// decodes a stream with both decoders and returns 1 when they disagree
+static int CompareDecoders(const DECODER_VARIANT* dv, LZSS_COMPR* lzss, size_t inLen, const uint8_t* inData,
+							size_t outLen, uint8_t* oldBuf, uint8_t* newBuf)
+{
+	size_t oldLen;
+	size_t newLen;
+	size_t cmpLen;
+
+	oldLen = dv->oldDecode(inLen, inData, outLen, oldBuf);
+	lzssDecode(lzss, outLen, newBuf, &newLen, inLen, inData);
+	if (oldLen != newLen)
+		return 1;
+	cmpLen = DefinedLength(dv, inLen, inData, oldLen);
+	return memcmp(oldBuf, newBuf, cmpLen) ? 1 : 0;
+}
+
+static unsigned int TestVariant(const DECODER_VARIANT* dv, unsigned int iterations)
+{
+	LZSS_COMPR* lzss = NULL;
+	unsigned int curIter;
+	unsigned int tests = 0;
+	unsigned int errors = 0;
+	uint8_t* oldBuf = (uint8_t*)malloc(0x10100);
+	uint8_t* newBuf = (uint8_t*)malloc(0x10100);
+
+	if (dv->setupCfg != NULL)
+	{
+		LZSS_CFG cfg;
+		lzssGetDefaultConfig(&cfg);
+		dv->setupCfg(&cfg);
+		lzss = lzssCreate(&cfg);
+	}
+	for (curIter = 0; curIter < iterations; curIter ++)
+	{
+		TEST_STREAM ts;
+		size_t decLen;
+
+		GenerateStream(dv, &ts, 1 + Random32() % 0x8000);
+
+		// the tool's decoder must reproduce the generated data
+		decLen = dv->oldDecode(ts.encLen, ts.enc, ts.decLen, oldBuf);
+		tests ++;
+		if (decLen != ts.decLen || memcmp(oldBuf, ts.dec, decLen))
+		{
+			if (errors < 10)
+				printf("    %s: generated stream %u decodes to %u/%u bytes%s\n", dv->name, curIter,
+					(unsigned)decLen, (unsigned)ts.decLen, (decLen == ts.decLen) ? ", data differs" : "");
+			errors ++;
+		}
+
+		if (lzss != NULL)
+		{
+			// valid stream, the same stream with a smaller output buffer, truncated and corrupted streams, random data
+			// (The tools' decoders are memory-safe with any input only for the ring buffer formats.)
+			size_t ofs;
+			tests += 5;
+			if (CompareDecoders(dv, lzss, ts.encLen, ts.enc, ts.decLen, oldBuf, newBuf))
+				errors ++;
+			if (CompareDecoders(dv, lzss, ts.encLen, ts.enc, Random32() % (ts.decLen + 1), oldBuf, newBuf))
+				errors ++;
+			if (CompareDecoders(dv, lzss, Random32() % (ts.encLen + 1), ts.enc, ts.decLen, oldBuf, newBuf))
+				errors ++;
+			for (ofs = 0; ofs < 4; ofs ++)
+				ts.enc[Random32() % ts.encLen] ^= (uint8_t)(1 << (Random32() % 8));
+			if (CompareDecoders(dv, lzss, ts.encLen, ts.enc, 0x10000, oldBuf, newBuf))
+				errors ++;
+			for (ofs = 0; ofs < ts.encLen; ofs ++)
+				ts.enc[ofs] = (uint8_t)Random32();
+			if (CompareDecoders(dv, lzss, ts.encLen, ts.enc, 0x10000, oldBuf, newBuf))
+				errors ++;
+		}
+		FreeStream(&ts);
+	}
+	printf("%-8s %6u tests, %u errors%s\n", dv->name, tests, errors,
+		(lzss == NULL) ? " (no lzss-lib equivalent, checked against the generator only)" : "");
+
+	if (lzss != NULL)
+		lzssDestroy(lzss);
+	free(oldBuf);
+	free(newBuf);
+	return errors;
+}
+
+static double TimeDecoder(const DECODER_VARIANT* dv, LZSS_COMPR* lzss, const TEST_STREAM* ts, uint8_t* decBuf)
+{
+	clock_t start, elapsed;
+	unsigned int runs;
+
+	runs = 0;
+	start = clock();
+	do
+	{
+		if (lzss != NULL)
+			lzssDecode(lzss, ts->decLen, decBuf, NULL, ts->encLen, ts->enc);
+		else
+			dv->oldDecode(ts->encLen, ts->enc, ts->decLen, decBuf);
+		runs ++;
+		elapsed = clock() - start;
+	} while((double)elapsed / CLOCKS_PER_SEC < MinBenchTime);
+
+	// return MB/s of decoded data
+	return (double)ts->decLen * runs / 1048576.0 / ((double)elapsed / CLOCKS_PER_SEC);
+}
+
+static void BenchVariant(const DECODER_VARIANT* dv)
+{
+	TEST_STREAM ts;
+	uint8_t* decBuf;
+	double speedOld;
+
+	GenerateStream(dv, &ts, 0x400000);
+	decBuf = (uint8_t*)malloc(ts.decLen);
+	speedOld = TimeDecoder(dv, NULL, &ts, decBuf);
+	if (dv->setupCfg != NULL)
+	{
+		LZSS_CFG cfg;
+		LZSS_COMPR* lzss;
+		double speedNew;
+
+		lzssGetDefaultConfig(&cfg);
+		dv->setupCfg(&cfg);
+		lzss = lzssCreate(&cfg);
+		speedNew = TimeDecoder(dv, lzss, &ts, decBuf);
+		lzssDestroy(lzss);
+		printf("%-8s tool %8.2f MB/s, lzss-lib %8.2f MB/s, speedup %.2fx\n", dv->name, speedOld, speedNew, speedNew / speedOld);
+	}
+	else
+	{
+		printf("%-8s tool %8.2f MB/s\n", dv->name, speedOld);
+	}
+	free(decBuf);
+	FreeStream(&ts);
+	return;
+}
@@ -6,6 +6,49 @@
 #include <string.h>
 #include "lzss-lib.h"
 
+#ifdef _WIN32
+#include <windows.h>
+typedef CRITICAL_SECTION LZSS_MUTEX;
+#define MutexInit(m)	InitializeCriticalSection(m)
+#define MutexDeinit(m)	DeleteCriticalSection(m)
+#define MutexLock(m)	EnterCriticalSection(m)
+#define MutexUnlock(m)	LeaveCriticalSection(m)
+typedef HANDLE LZSS_THREAD;
+#define THREAD_FUNC			DWORD WINAPI
+#define ThreadCreate(t, f, arg)	((*(t) = CreateThread(NULL, 0, f, arg, 0, NULL)) != NULL)
+#define ThreadJoin(t)		(WaitForSingleObject(t, INFINITE), CloseHandle(t))
+#else
+#include <pthread.h>
+typedef pthread_mutex_t LZSS_MUTEX;
+#define MutexInit(m)	pthread_mutex_init(m, NULL)
+#define MutexDeinit(m)	pthread_mutex_destroy(m)
+#define MutexLock(m)	pthread_mutex_lock(m)
+#define MutexUnlock(m)	pthread_mutex_unlock(m)
+typedef pthread_t LZSS_THREAD;
+#define THREAD_FUNC			void*
+#define ThreadCreate(t, f, arg)	(pthread_create(t, NULL, f, arg) == 0)
+#define ThreadJoin(t)		pthread_join(t, NULL)
+#endif
+
+#if defined(_MSC_VER)
+#define LZSS_FORCE_INLINE	static __forceinline
+#elif defined(__GNUC__)
+#define LZSS_FORCE_INLINE	static __inline__ __attribute__((always_inline))
+#else
+#define LZSS_FORCE_INLINE	static inline
+#endif
+
+/* binary search tree node - N is at most 0x8000, so all indices (including NIL and the roots) fit into 16 bits */
+typedef struct _lzss_tree_node
+{
+	unsigned short lson;	/* left child */
+	unsigned short rson;	/* right child */
+	unsigned short dad;		/* parent */
+} LZSS_NODE;
+
+typedef uint8_t (*LZSS_DECODE_FUNC)(LZSS_COMPR* lzss, size_t bufSize, uint8_t* buffer, size_t* bytesWritten,
+	size_t inSize, const uint8_t* inData);
+
 struct _lzss_compressor
 {
 	LZSS_CFG cfg;
@@ -14,6 +57,7 @@ struct _lzss_compressor
 	unsigned int F;			/* upper limit for match_length, usually 18 */
 	unsigned int THRESHOLD;	/* encode string into position and length
 							   if match_length is greater than this, usually 2 */
+	unsigned int lenBits;	/* size of the length field of reference words, 16 - log2(N) */
 	#define NIL			N	/* index for root of binary search trees */
 
 	uint8_t* text_buf;		/* ring buffer of size N, with extra F-1 bytes to
@@ -21,39 +65,397 @@ struct _lzss_compressor
 							   These are set by the InsertNode() procedure. */
 	int match_position;
 	unsigned int match_length;
-	int* lson;				/* left & right children & parents -- These constitute binary search trees. */
-	int* rson;
-	int* dad;
+	LZSS_NODE* tree;		/* left & right children & parents -- These constitute binary search trees.
+							   Nodes 0..N-1 are the strings, N+1..N+256 hold the roots in rson. */
+
+	int* hc_head;			/* hash chains: most recent position for each hash value */
+	int* hc_prev;			/* hash chains: previous position with the same hash value */
+
+	/* match search effort, see LEVELS */
+	unsigned int maxSteps;	/* maximum number of tree nodes/chain links to visit per position */
+	unsigned int goodLen;	/* stop searching once a match of this length is found */
+	unsigned int lazyLen;	/* check the next position for a longer match if the match is shorter than this */
+
+	/* encoder state, see lzssEncodeBegin() */
+	unsigned int enc_r;			/* ring buffer position of the string to be encoded next */
+	unsigned int enc_s;			/* ring buffer position of the oldest string, replaced by the next input byte */
+	unsigned int enc_len;		/* number of bytes in the lookahead buffer */
+	unsigned int enc_advance;	/* number of bytes left to advance for the last unit */
+	uint8_t enc_state;			/* see ENCST_* */
+	uint8_t enc_lazy;			/* 1 = the match for the previous position is deferred, see lazy_* */
+	int lazy_pos;				/* deferred match: position */
+	unsigned int lazy_len;		/* deferred match: length */
+	uint8_t lazy_byte;			/* deferred match: first byte (for sending it as literal) */
+	uint8_t enc_store;			/* 1 = sending literals without searching (LZSS_STORE_AUTO) */
+	size_t enc_pos;				/* number of positions passed since the start of the stream */
+	size_t probe_start;			/* enc_pos at the start of the current probe/store span */
+	size_t probe_out;			/* number of bytes sent during the current probe */
+	uint8_t code_mask;			/* control bit for the next unit */
+	uint8_t code_buf[17];		/* control byte (1) + 8 reference words (16) */
+	unsigned int code_buf_ptr;	/* number of bytes in code_buf */
+	unsigned int code_buf_out;	/* number of bytes of code_buf that were already output */
+
+	/* incremental decoder state, see lzssDecodeBegin() */
+	unsigned int dec_r;			/* ring buffer position */
+	unsigned int dec_flags;		/* remaining bits of the current control byte */
+	unsigned int dec_flag_bits;	/* number of remaining control bits */
+	unsigned int dec_copy_pos;	/* ring buffer position of a pending back-reference */
+	unsigned int dec_copy_len;	/* number of bytes left to copy for the pending back-reference */
+	size_t dec_total;			/* number of bytes decoded so far */
+	uint8_t dec_ref_byte;		/* first byte of a half-read reference word */
+	uint8_t dec_ref_half;		/* 1 = dec_ref_byte is valid */
+	uint8_t dec_ended;			/* 1 = end-of-stream marker was read */
+
+	LZSS_DECODE_FUNC Decode;	/* decoding kernel, selected by lzssCreate() */
+	unsigned int ref_tbl[2][0x100];	/* LZSS_DEC_TABLE: (length << 16) | offset parts of the 1st/2nd reference byte */
+
+	/* statistics and output checksum of the current stream, see lzssGetStats() */
+	LZSS_STATS stats;
+	size_t hashLen;				/* number of bytes hashed so far */
+	unsigned int crc;			/* CRC-32 register (inverted) */
+	unsigned int crc_tbl[4][0x100];	/* CRC-32 lookup tables for processing 4 bytes at a time */
+	unsigned long long xxh_acc[4];	/* xxHash64 accumulators */
+	uint8_t xxh_buf[32];		/* xxHash64: bytes of the incomplete stripe */
+	unsigned int xxh_bufLen;
+
+	uint8_t* mem;			/* memory block for text_buf and the match finder arrays */
+	size_t memSize;			/* size of the memory block */
+	size_t setSize;			/* size of text_buf + match finder arrays, the snapshot follows them */
+	uint8_t* snap;			/* snapshot of the seeded name table state (LZSS_NTINIT_FUNC only) */
+	uint8_t snapState;		/* see SNAP_* */
+	uint8_t memType;		/* see CTXMEM_* */
+	LZSS_COMPR* poolNext;	/* next idle context in an LZSS_POOL */
+
+	/* match finder engine, see LZSS_MF_* */
+	void (*InitTree)(LZSS_COMPR* lzss);
+	void (*InsertNode)(LZSS_COMPR* lzss, int r);
+	void (*DeleteNode)(LZSS_COMPR* lzss, int p);
+};
+
+struct _lzss_pool
+{
+	LZSS_CFG cfg;
+	LZSS_MUTEX mutex;
+	LZSS_COMPR* idle;		/* list of idle contexts, linked via poolNext */
+	unsigned int idleCount;
+	unsigned int maxIdle;	/* idle contexts beyond this number are freed */
+};
+
+#define ENCST_FILL	0x00	/* filling the lookahead buffer */
+#define ENCST_RUN	0x01	/* encoding */
+#define ENCST_FLUSH	0x02	/* writing the last (partial) group of units */
+#define ENCST_EOS	0x03	/* writing the end-of-stream marker */
+#define ENCST_DONE	0x04
+
+#define CTXMEM_HEAP		0x00	/* context and memory block were allocated by lzssCreate() */
+#define CTXMEM_ARENA	0x01	/* context and memory block are in a caller-provided arena */
+#define MEM_ALIGN(x)	(((x) + 15) & ~(size_t)15)
+
+#define SNAP_NAMETBL	0x01	/* the snapshot contains the name table */
+#define SNAP_TREE		0x02	/* the snapshot contains text_buf and match finder arrays with all name table strings
+								   that don't overlap the lookahead buffer */
+
+#define PROBE_LEN	0x1000	/* bytes that are encoded normally to check if the data still compresses */
+#define STORE_SPAN	0x10000	/* bytes that are sent as literals before checking again */
+
+#define COLLECT_STATS(cfg)	((cfg)->stats != LZSS_STATS_OFF || (cfg)->hashType != LZSS_HASH_NONE)
+#define HASH_BLOCK	0x4000	/* the decoding kernels hash their output in blocks of this size, while it is still cached */
+
+#define HC_BITS		13
+#define HC_SIZE		(1 << HC_BITS)	/* number of hash chain heads */
+#define HC_DEPTH	32	/* default search depth of the hash chain match finder */
+
+typedef struct _lzss_level
+{
+	unsigned int maxSteps;	/* 0 = unlimited (tree) / HC_DEPTH (hash chains) */
+	unsigned int goodLen;	/* 0 = F */
+	unsigned int lazyLen;	/* 0 = no lazy matching, else min(lazyLen, F) */
+} LZSS_LEVEL;
+static const LZSS_LEVEL LEVELS[10] =
+{
+	{   0,  0,  0},	// 0 - default: search like LZSS.C
+	{   4,  8,  0},	// 1 - fastest
+	{   8, 12,  0},
+	{  16, 16,  0},
+	{  32,  0,  0},
+	{  64,  0,  0},
+	{ 128,  0,  8},
+	{ 256,  0, 16},
+	{1024,  0, 0xFFFF},
+	{   0,  0, 0xFFFF},	// 9 - best
 };
 
+static void InitTree(LZSS_COMPR* lzss);
+static void InsertNode(LZSS_COMPR* lzss, int r);
+static void DeleteNode(LZSS_COMPR* lzss, int p);
+static void InitHash(LZSS_COMPR* lzss);
+static void HashInsertNode(LZSS_COMPR* lzss, int r);
+static void HashDeleteNode(LZSS_COMPR* lzss, int p);
+static LZSS_DECODE_FUNC SelectDecoder(const LZSS_CFG* cfg);
+static void GetReference(const LZSS_COMPR* lzss, uint8_t b0, uint8_t b1, unsigned int* ofs, unsigned int* len);
+static void BuildRefTable(LZSS_COMPR* lzss);
+static void BuildCrcTable(LZSS_COMPR* lzss);
+
+
+static unsigned int OffsetBits(unsigned int N)
+{
+	unsigned int bits;
+
+	for (bits = 0; (1U << bits) < N; bits ++)
+		;
+	return bits;
+}
+
+static size_t LayoutArrays(LZSS_COMPR* lzss, const LZSS_CFG* config, uint8_t* mem)
+{
+	/* Returns the size of the memory block that holds all arrays for the configuration.
+	   When lzss is not NULL, the array pointers are set to the respective parts of mem.
+	   With LZSS_NTINIT_FUNC, a second set of arrays holds the name table snapshot. */
+	size_t N = config->N;
+	size_t ofsText, ofsA, ofsB, size;
+	size_t setSize;
+
+	ofsText = 0;
+	ofsA = MEM_ALIGN(ofsText + N + config->F - 1);
+	if (config->matchFinder == LZSS_MF_HASH)
+	{
+		ofsB = ofsA + HC_SIZE * sizeof(int);	// hc_head
+		size = ofsB + N * sizeof(int);			// hc_prev
+	}
+	else
+	{
+		size = ofsA + (N + 0x101) * sizeof(LZSS_NODE);	// tree, including NIL and the roots
+	}
+	setSize = MEM_ALIGN(size);
+	size = (config->nameTblType == LZSS_NTINIT_FUNC) ? setSize * 2 : setSize;
+	if (lzss == NULL)
+		return size;
+
+	lzss->setSize = setSize;
+	lzss->snap = (config->nameTblType == LZSS_NTINIT_FUNC) ? &mem[setSize] : NULL;
+	lzss->snapState = 0x00;
+
+	lzss->text_buf = &mem[ofsText];
+	if (config->matchFinder == LZSS_MF_HASH)
+	{
+		lzss->hc_head = (int*)&mem[ofsA];
+		lzss->hc_prev = (int*)&mem[ofsB];
+		lzss->tree = NULL;
+	}
+	else
+	{
+		lzss->tree = (LZSS_NODE*)&mem[ofsA];
+		lzss->hc_head = lzss->hc_prev = NULL;
+	}
+	return size;
+}
+
+static void ApplyConfig(LZSS_COMPR* lzss, const LZSS_CFG* config)
+{
+	/* set up everything that depends on the configuration (except for memory) */
+	lzss->cfg = *config;
+	lzss->N = config->N;
+	lzss->THRESHOLD = config->THRESHOLD;
+	lzss->F = config->F;
+	lzss->lenBits = 16 - OffsetBits(lzss->N);
+	lzss->Decode = SelectDecoder(&lzss->cfg);
+	if (lzss->cfg.decoder == LZSS_DEC_TABLE || COLLECT_STATS(&lzss->cfg))
+		BuildRefTable(lzss);
+	if (lzss->cfg.hashType == LZSS_HASH_CRC32)
+		BuildCrcTable(lzss);
+
+	{
+		const LZSS_LEVEL* lvl = &LEVELS[(lzss->cfg.level <= 9) ? lzss->cfg.level : 9];
+		if (lvl->maxSteps > 0)
+			lzss->maxSteps = lvl->maxSteps;
+		else
+			lzss->maxSteps = (lzss->cfg.matchFinder == LZSS_MF_HASH && lzss->cfg.level == 0) ? HC_DEPTH : (unsigned int)-1;
+		lzss->goodLen = (lvl->goodLen > 0 && lvl->goodLen < lzss->F) ? lvl->goodLen : lzss->F;
+		lzss->lazyLen = (lvl->lazyLen < lzss->F) ? lvl->lazyLen : lzss->F;
+	}
+	if (lzss->cfg.matchFinder == LZSS_MF_HASH)
+	{
+		lzss->InitTree = InitHash;
+		lzss->InsertNode = HashInsertNode;
+		lzss->DeleteNode = HashDeleteNode;
+	}
+	else //if (lzss->cfg.matchFinder == LZSS_MF_TREE)
+	{
+		lzss->InitTree = InitTree;
+		lzss->InsertNode = InsertNode;
+		lzss->DeleteNode = DeleteNode;
+	}
+	return;
+}
 
 LZSS_COMPR* lzssCreate(const LZSS_CFG* config)
 {
-	LZSS_COMPR* lzss = (LZSS_COMPR*)calloc(1, sizeof(LZSS_COMPR));
+	LZSS_COMPR* lzss;
+
+	if (lzssCheckConfig(config) != LZSS_ERR_OK)
+		return NULL;
+	lzss = (LZSS_COMPR*)calloc(1, sizeof(LZSS_COMPR));
 	if (lzss == NULL)
 		return NULL;
 
-	lzss->cfg = *config;
-	lzss->N = 4096;
-	lzss->THRESHOLD = 2;
-	lzss->F = 0x10 + lzss->THRESHOLD;
-	lzss->text_buf = (uint8_t*)malloc(lzss->N + lzss->F - 1);
-
-	lzss->lson = (int*)calloc(lzss->N + 1, sizeof(int));
-	lzss->rson = (int*)calloc(lzss->N + 0x101, sizeof(int));
-	lzss->dad = (int*)calloc(lzss->N + 1, sizeof(int));
+	// all arrays share a single memory block
+	lzss->memSize = LayoutArrays(NULL, config, NULL);
+	lzss->mem = (uint8_t*)malloc(lzss->memSize);
+	if (lzss->mem == NULL)
+	{
+		free(lzss);
+		return NULL;
+	}
+	lzss->memType = CTXMEM_HEAP;
+	LayoutArrays(lzss, config, lzss->mem);
+	ApplyConfig(lzss, config);
+	return lzss;
+}
+
+size_t lzssGetContextSize(const LZSS_CFG* config)
+{
+	return MEM_ALIGN(sizeof(LZSS_COMPR)) + LayoutArrays(NULL, config, NULL);
+}
+
+LZSS_COMPR* lzssCreateInArena(const LZSS_CFG* config, void* arena, size_t arenaSize)
+{
+	LZSS_COMPR* lzss = (LZSS_COMPR*)arena;
+
+	if (lzssCheckConfig(config) != LZSS_ERR_OK)
+		return NULL;
+	if (arenaSize < lzssGetContextSize(config))
+		return NULL;
+
+	memset(lzss, 0x00, sizeof(LZSS_COMPR));
+	lzss->mem = (uint8_t*)arena + MEM_ALIGN(sizeof(LZSS_COMPR));
+	lzss->memSize = arenaSize - MEM_ALIGN(sizeof(LZSS_COMPR));
+	lzss->memType = CTXMEM_ARENA;
+	LayoutArrays(lzss, config, lzss->mem);
+	ApplyConfig(lzss, config);
 	return lzss;
 }
 
+static int SameConfig(const LZSS_CFG* a, const LZSS_CFG* b)
+{
+	return (a->flags == b->flags && a->nameTblType == b->nameTblType && a->nameTblValue == b->nameTblValue &&
+		a->nameTblFunc == b->nameTblFunc && a->ntFuncParam == b->ntFuncParam &&
+		a->nameTblStartOfs == b->nameTblStartOfs && a->eosMode == b->eosMode &&
+		a->matchFinder == b->matchFinder && a->decoder == b->decoder &&
+		a->N == b->N && a->F == b->F && a->THRESHOLD == b->THRESHOLD &&
+		a->level == b->level && a->parser == b->parser && a->storeMode == b->storeMode &&
+		a->stats == b->stats && a->hashType == b->hashType);
+}
+
+uint8_t lzssReset(LZSS_COMPR* lzss, const LZSS_CFG* config)
+{
+	size_t memSize;
+
+	if (config == NULL)
+	{
+		lzss->snapState = 0x00;	// keep the configuration, but call nameTblFunc again
+		return LZSS_ERR_OK;
+	}
+	if (SameConfig(config, &lzss->cfg))
+		return LZSS_ERR_OK;	// nothing to do - each stream reinitializes the remaining state
+	if (lzssCheckConfig(config) != LZSS_ERR_OK)
+		return LZSS_ERR_BAD_CFG;
+
+	memSize = LayoutArrays(NULL, config, NULL);
+	if (memSize > lzss->memSize)
+	{
+		uint8_t* newMem;
+		if (lzss->memType == CTXMEM_ARENA)
+			return LZSS_ERR_NO_MEM;	// the arena is too small
+		newMem = (uint8_t*)malloc(memSize);
+		if (newMem == NULL)
+			return LZSS_ERR_NO_MEM;
+		free(lzss->mem);
+		lzss->mem = newMem;
+		lzss->memSize = memSize;
+	}
+	LayoutArrays(lzss, config, lzss->mem);
+	ApplyConfig(lzss, config);
+	return LZSS_ERR_OK;
+}
+
 void lzssDestroy(LZSS_COMPR* lzss)
 {
-	free(lzss->text_buf);
-	free(lzss->lson);
-	free(lzss->rson);
-	free(lzss->dad);
+	if (lzss->memType == CTXMEM_ARENA)
+		return;	// the caller owns the memory
+	free(lzss->mem);
 	free(lzss);
 }
 
+LZSS_POOL* lzssPoolCreate(const LZSS_CFG* config, unsigned int maxIdle)
+{
+	LZSS_POOL* pool;
+
+	if (lzssCheckConfig(config) != LZSS_ERR_OK)
+		return NULL;
+	pool = (LZSS_POOL*)calloc(1, sizeof(LZSS_POOL));
+	if (pool == NULL)
+		return NULL;
+	pool->cfg = *config;
+	pool->maxIdle = maxIdle;
+	MutexInit(&pool->mutex);
+	return pool;
+}
+
+void lzssPoolDestroy(LZSS_POOL* pool)
+{
+	while(pool->idle != NULL)
+	{
+		LZSS_COMPR* lzss = pool->idle;
+		pool->idle = lzss->poolNext;
+		lzssDestroy(lzss);
+	}
+	MutexDeinit(&pool->mutex);
+	free(pool);
+}
+
+LZSS_COMPR* lzssPoolAcquire(LZSS_POOL* pool)
+{
+	LZSS_COMPR* lzss;
+
+	MutexLock(&pool->mutex);
+	lzss = pool->idle;
+	if (lzss != NULL)
+	{
+		pool->idle = lzss->poolNext;
+		pool->idleCount --;
+	}
+	MutexUnlock(&pool->mutex);
+
+	if (lzss == NULL)
+		return lzssCreate(&pool->cfg);
+	lzss->poolNext = NULL;
+	return lzss;
+}
+
+void lzssPoolRelease(LZSS_POOL* pool, LZSS_COMPR* lzss)
+{
+	// The caller may have reconfigured the context, so return it in the pool's configuration.
+	if (lzssReset(lzss, &pool->cfg) != LZSS_ERR_OK)
+	{
+		lzssDestroy(lzss);
+		return;
+	}
+
+	MutexLock(&pool->mutex);
+	if (pool->idleCount < pool->maxIdle)
+	{
+		lzss->poolNext = pool->idle;
+		pool->idle = lzss;
+		pool->idleCount ++;
+		lzss = NULL;
+	}
+	MutexUnlock(&pool->mutex);
+
+	if (lzss != NULL)
+		lzssDestroy(lzss);	// the pool is full
+	return;
+}
+
 void lzssGetDefaultConfig(LZSS_CFG* config)
 {
 	config->flags = LZSS_FLAGS_CTRL_L | LZSS_FLAGS_MTCH_DEFAULT;
@@ -63,14 +465,239 @@ void lzssGetDefaultConfig(LZSS_CFG* config)
 	config->ntFuncParam = NULL;
 	config->nameTblStartOfs = LZSS_NTSTOFS_NF;
 	config->eosMode = LZSS_EOSM_NONE;
+	config->matchFinder = LZSS_MF_TREE;
+	config->decoder = LZSS_DEC_AUTO;
+	config->N = 0x1000;
+	config->THRESHOLD = 2;
+	config->F = 0x10 + config->THRESHOLD;
+	config->level = 0;
+	config->parser = LZSS_PARSE_GREEDY;
+	config->storeMode = LZSS_STORE_OFF;
+	config->stats = LZSS_STATS_OFF;
+	config->hashType = LZSS_HASH_NONE;
 	return;
 }
 
+uint8_t lzssCheckConfig(const LZSS_CFG* config)
+{
+	unsigned int lenBits;
+
+	// Reference words have 16 bits: log2(N) bits of offset and a length field with the remaining bits.
+	// The length field must be 1..8 bits large, so that it fits into one byte for all layouts.
+	if (config->N < 0x100 || config->N > 0x8000 || (config->N & (config->N - 1)))
+		return LZSS_ERR_BAD_CFG;
+	lenBits = 16 - OffsetBits(config->N);
+	if (config->F <= config->THRESHOLD || config->F - config->THRESHOLD > (1U << lenBits))
+		return LZSS_ERR_BAD_CFG;	// match lengths THRESHOLD+1..F must be encodable
+	if (config->F > config->N / 2)
+		return LZSS_ERR_BAD_CFG;	// the binary tree match finder needs the lookahead buffer to be at most N/2
+	if (config->stats > LZSS_STATS_ON || config->hashType > LZSS_HASH_XXH64)
+		return LZSS_ERR_BAD_CFG;
+	return LZSS_ERR_OK;
+}
+
 const LZSS_CFG* lzssGetConfiguration(const LZSS_COMPR* lzss)
 {
 	return &lzss->cfg;
 }
 
+/* --- statistics and checksums --- */
+#define XXH_P1	0x9E3779B185EBCA87ULL
+#define XXH_P2	0xC2B2AE3D27D4EB4FULL
+#define XXH_P3	0x165667B19E3779F9ULL
+#define XXH_P4	0x85EBCA77C2B2AE63ULL
+#define XXH_P5	0x27D4EB2F165667C5ULL
+#define XXH_ROTL(x, r)	(((x) << (r)) | ((x) >> (64 - (r))))
+
+static void BuildCrcTable(LZSS_COMPR* lzss)
+{
+	unsigned int i, k, c;
+
+	for (i = 0; i < 0x100; i++)
+	{
+		c = i;
+		for (k = 0; k < 8; k++)
+			c = (c & 1) ? (0xEDB88320 ^ (c >> 1)) : (c >> 1);
+		lzss->crc_tbl[0][i] = c;
+	}
+	// crc_tbl[k] = CRC of a byte followed by k zero bytes
+	for (i = 0; i < 0x100; i++)
+	{
+		c = lzss->crc_tbl[0][i];
+		for (k = 1; k < 4; k++)
+		{
+			c = lzss->crc_tbl[0][c & 0xFF] ^ (c >> 8);
+			lzss->crc_tbl[k][i] = c;
+		}
+	}
+	return;
+}
+
+static unsigned int Crc32Update(const unsigned int (*tbl)[0x100], unsigned int crc, const uint8_t* data, size_t len)
+{
+	for (; len >= 4; len -= 4, data += 4)
+	{
+		crc ^= data[0] | (data[1] << 8) | (data[2] << 16) | ((unsigned int)data[3] << 24);
+		crc = tbl[3][crc & 0xFF] ^ tbl[2][(crc >> 8) & 0xFF] ^ tbl[1][(crc >> 16) & 0xFF] ^ tbl[0][crc >> 24];
+	}
+	for (; len > 0; len--, data++)
+		crc = tbl[0][(crc ^ *data) & 0xFF] ^ (crc >> 8);
+	return crc;
+}
+
+LZSS_FORCE_INLINE unsigned long long Read64LE(const uint8_t* p)
+{
+	return (unsigned long long)(p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24)) |
+		((unsigned long long)(p[4] | (p[5] << 8) | (p[6] << 16) | ((unsigned int)p[7] << 24)) << 32);
+}
+
+LZSS_FORCE_INLINE unsigned long long Xxh64Round(unsigned long long acc, unsigned long long input)
+{
+	acc += input * XXH_P2;
+	acc = XXH_ROTL(acc, 31);
+	return acc * XXH_P1;
+}
+
+static void Xxh64Update(LZSS_COMPR* lzss, const uint8_t* data, size_t len)
+{
+	unsigned long long a0, a1, a2, a3;
+
+	if (lzss->xxh_bufLen > 0)
+	{
+		// complete the stripe that was started by the previous call
+		size_t part = 32 - lzss->xxh_bufLen;
+		if (part > len)
+			part = len;
+		memcpy(&lzss->xxh_buf[lzss->xxh_bufLen], data, part);
+		lzss->xxh_bufLen += (unsigned int)part;
+		data += part;  len -= part;
+		if (lzss->xxh_bufLen < 32)
+			return;
+		lzss->xxh_bufLen = 0;
+		Xxh64Update(lzss, lzss->xxh_buf, 32);
+	}
+
+	a0 = lzss->xxh_acc[0];  a1 = lzss->xxh_acc[1];
+	a2 = lzss->xxh_acc[2];  a3 = lzss->xxh_acc[3];
+	for (; len >= 32; len -= 32, data += 32)
+	{
+		a0 = Xxh64Round(a0, Read64LE(&data[0x00]));
+		a1 = Xxh64Round(a1, Read64LE(&data[0x08]));
+		a2 = Xxh64Round(a2, Read64LE(&data[0x10]));
+		a3 = Xxh64Round(a3, Read64LE(&data[0x18]));
+	}
+	lzss->xxh_acc[0] = a0;  lzss->xxh_acc[1] = a1;
+	lzss->xxh_acc[2] = a2;  lzss->xxh_acc[3] = a3;
+	memcpy(lzss->xxh_buf, data, len);
+	lzss->xxh_bufLen = (unsigned int)len;
+	return;
+}
+
+static unsigned long long Xxh64Digest(const LZSS_COMPR* lzss)
+{
+	const unsigned long long* acc = lzss->xxh_acc;
+	const uint8_t* p = lzss->xxh_buf;
+	unsigned int left = lzss->xxh_bufLen;
+	unsigned long long h;
+	unsigned int i;
+
+	if (lzss->hashLen >= 32)
+	{
+		h = XXH_ROTL(acc[0], 1) + XXH_ROTL(acc[1], 7) + XXH_ROTL(acc[2], 12) + XXH_ROTL(acc[3], 18);
+		for (i = 0; i < 4; i++)
+		{
+			h ^= Xxh64Round(0, acc[i]);
+			h = h * XXH_P1 + XXH_P4;
+		}
+	}
+	else
+	{
+		h = XXH_P5;	// seed + P5
+	}
+	h += lzss->hashLen;
+
+	for (; left >= 8; left -= 8, p += 8)
+	{
+		h ^= Xxh64Round(0, Read64LE(p));
+		h = XXH_ROTL(h, 27) * XXH_P1 + XXH_P4;
+	}
+	if (left >= 4)
+	{
+		h ^= (unsigned long long)(p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24)) * XXH_P1;
+		h = XXH_ROTL(h, 23) * XXH_P2 + XXH_P3;
+		left -= 4;  p += 4;
+	}
+	for (; left > 0; left--, p++)
+	{
+		h ^= *p * XXH_P5;
+		h = XXH_ROTL(h, 11) * XXH_P1;
+	}
+
+	h ^= h >> 33;
+	h *= XXH_P2;
+	h ^= h >> 29;
+	h *= XXH_P3;
+	h ^= h >> 32;
+	return h;
+}
+
+static void ResetStats(LZSS_COMPR* lzss)
+{
+	memset(&lzss->stats, 0x00, sizeof(LZSS_STATS));
+	lzss->hashLen = 0;
+	lzss->crc = 0xFFFFFFFF;
+	lzss->xxh_acc[0] = XXH_P1 + XXH_P2;	// seed = 0
+	lzss->xxh_acc[1] = XXH_P2;
+	lzss->xxh_acc[2] = 0;
+	lzss->xxh_acc[3] = 0 - XXH_P1;
+	lzss->xxh_bufLen = 0;
+	return;
+}
+
+static void HashUpdate(LZSS_COMPR* lzss, const uint8_t* data, size_t len)
+{
+	if (lzss->cfg.hashType == LZSS_HASH_CRC32)
+		lzss->crc = Crc32Update((const unsigned int (*)[0x100])lzss->crc_tbl, lzss->crc, data, len);
+	else if (lzss->cfg.hashType == LZSS_HASH_XXH64)
+		Xxh64Update(lzss, data, len);
+	lzss->hashLen += len;
+	return;
+}
+
+LZSS_FORCE_INLINE void CountMatch(LZSS_STATS* stats, unsigned int len)
+{
+	stats->matches ++;
+	stats->matchLen[(len < LZSS_STATS_LENS) ? len : (LZSS_STATS_LENS - 1)] ++;
+}
+
+void lzssGetStats(const LZSS_COMPR* lzss, LZSS_STATS* stats)
+{
+	unsigned long long digest;
+	unsigned int curByte;
+
+	*stats = lzss->stats;
+	stats->hashType = lzss->cfg.hashType;
+	memset(stats->hash, 0x00, sizeof(stats->hash));
+	if (lzss->cfg.hashType == LZSS_HASH_CRC32)
+	{
+		stats->hashSize = 4;
+		digest = ~lzss->crc & 0xFFFFFFFF;
+	}
+	else if (lzss->cfg.hashType == LZSS_HASH_XXH64)
+	{
+		stats->hashSize = 8;
+		digest = Xxh64Digest(lzss);
+	}
+	else
+	{
+		stats->hashSize = 0;
+		digest = 0;
+	}
+	for (curByte = stats->hashSize; curByte > 0; curByte --, digest >>= 8)
+		stats->hash[curByte - 1] = (uint8_t)(digest & 0xFF);
+	return;
+}
+
 static void InitTree(LZSS_COMPR* lzss)  /* initialize trees */
 {
 	unsigned int i;
@@ -83,8 +710,8 @@ static void InitTree(LZSS_COMPR* lzss)  /* initialize trees */
 	   for strings that begin with character i.  These are initialized
 	   to NIL.  Note there are 256 trees. */
 
-	for (i = lzss->N + 1; i <= lzss->N + 256; i++) lzss->rson[i] = lzss->NIL;
-	for (i = 0; i < lzss->N; i++) lzss->dad[i] = lzss->NIL;
+	for (i = lzss->N + 1; i <= lzss->N + 256; i++) lzss->tree[i].rson = (unsigned short)lzss->NIL;
+	for (i = 0; i < lzss->N; i++) lzss->tree[i].dad = (unsigned short)lzss->NIL;
 }
 
 static void InsertNode(LZSS_COMPR* lzss, int r)
@@ -93,21 +720,27 @@ static void InsertNode(LZSS_COMPR* lzss, int r)
 	   and length via the global variables match_position and match_length.
 	   If match_length = F, then removes the old node in favor of the new
 	   one, because the old one will be deleted sooner.
-	   Note r plays double role, as tree node and position in buffer. */
+	   Note r plays double role, as tree node and position in buffer.
+	   If the search ends early (after maxSteps nodes or with a match
+	   of goodLen bytes), r is not inserted into the tree. */
 {
 	unsigned int i;
+	unsigned int steps = lzss->maxSteps;
 	int  p, cmp;
 	uint8_t  *key;
 
 	cmp = 1;  key = &lzss->text_buf[r];  p = lzss->N + 1 + key[0];
-	lzss->rson[r] = lzss->lson[r] = lzss->NIL;  lzss->match_length = 0;
+	lzss->tree[r].rson = lzss->tree[r].lson = (unsigned short)lzss->NIL;  lzss->match_length = 0;
 	for ( ; ; ) {
+		if (steps-- == 0 || lzss->match_length >= lzss->goodLen) {
+			lzss->tree[r].dad = (unsigned short)lzss->NIL;  return;  /* search limit reached */
+		}
 		if (cmp >= 0) {
-			if (lzss->rson[p] != lzss->NIL) p = lzss->rson[p];
-			else {  lzss->rson[p] = r;  lzss->dad[r] = p;  return;  }
+			if (lzss->tree[p].rson != lzss->NIL) p = lzss->tree[p].rson;
+			else {  lzss->tree[p].rson = (unsigned short)r;  lzss->tree[r].dad = (unsigned short)p;  return;  }
 		} else {
-			if (lzss->lson[p] != lzss->NIL) p = lzss->lson[p];
-			else {  lzss->lson[p] = r;  lzss->dad[r] = p;  return;  }
+			if (lzss->tree[p].lson != lzss->NIL) p = lzss->tree[p].lson;
+			else {  lzss->tree[p].lson = (unsigned short)r;  lzss->tree[r].dad = (unsigned short)p;  return;  }
 		}
 		for (i = 1; i < lzss->F; i++)
 			if ((cmp = key[i] - (int)lzss->text_buf[p + i]) != 0)  break;
@@ -116,32 +749,94 @@ static void InsertNode(LZSS_COMPR* lzss, int r)
 			if ((lzss->match_length = i) >= lzss->F)  break;
 		}
 	}
-	lzss->dad[r] = lzss->dad[p];  lzss->lson[r] = lzss->lson[p];  lzss->rson[r] = lzss->rson[p];
-	lzss->dad[lzss->lson[p]] = r;  lzss->dad[lzss->rson[p]] = r;
-	if (lzss->rson[lzss->dad[p]] == p) lzss->rson[lzss->dad[p]] = r;
-	else                   lzss->lson[lzss->dad[p]] = r;
-	lzss->dad[p] = lzss->NIL;  /* remove p */
+	lzss->tree[r] = lzss->tree[p];
+	lzss->tree[lzss->tree[p].lson].dad = (unsigned short)r;  lzss->tree[lzss->tree[p].rson].dad = (unsigned short)r;
+	if (lzss->tree[lzss->tree[p].dad].rson == p) lzss->tree[lzss->tree[p].dad].rson = (unsigned short)r;
+	else                   lzss->tree[lzss->tree[p].dad].lson = (unsigned short)r;
+	lzss->tree[p].dad = (unsigned short)lzss->NIL;  /* remove p */
 }
 
 static void DeleteNode(LZSS_COMPR* lzss, int p)  /* deletes node p from tree */
 {
 	int  q;
 
-	if (lzss->dad[p] == lzss->NIL) return;  /* not in tree */
-	if (lzss->rson[p] == lzss->NIL) q = lzss->lson[p];
-	else if (lzss->lson[p] == lzss->NIL) q = lzss->rson[p];
+	if (lzss->tree[p].dad == lzss->NIL) return;  /* not in tree */
+	if (lzss->tree[p].rson == lzss->NIL) q = lzss->tree[p].lson;
+	else if (lzss->tree[p].lson == lzss->NIL) q = lzss->tree[p].rson;
 	else {
-		q = lzss->lson[p];
-		if (lzss->rson[q] != lzss->NIL) {
-			do {  q = lzss->rson[q];  } while (lzss->rson[q] != lzss->NIL);
-			lzss->rson[lzss->dad[q]] = lzss->lson[q];  lzss->dad[lzss->lson[q]] = lzss->dad[q];
-			lzss->lson[q] = lzss->lson[p];  lzss->dad[lzss->lson[p]] = q;
+		q = lzss->tree[p].lson;
+		if (lzss->tree[q].rson != lzss->NIL) {
+			do {  q = lzss->tree[q].rson;  } while (lzss->tree[q].rson != lzss->NIL);
+			lzss->tree[lzss->tree[q].dad].rson = lzss->tree[q].lson;  lzss->tree[lzss->tree[q].lson].dad = lzss->tree[q].dad;
+			lzss->tree[q].lson = lzss->tree[p].lson;  lzss->tree[lzss->tree[p].lson].dad = (unsigned short)q;
+		}
+		lzss->tree[q].rson = lzss->tree[p].rson;  lzss->tree[lzss->tree[p].rson].dad = (unsigned short)q;
+	}
+	lzss->tree[q].dad = lzss->tree[p].dad;
+	if (lzss->tree[lzss->tree[p].dad].rson == p) lzss->tree[lzss->tree[p].dad].rson = (unsigned short)q;  else lzss->tree[lzss->tree[p].dad].lson = (unsigned short)q;
+	lzss->tree[p].dad = (unsigned short)lzss->NIL;
+}
+
+static unsigned int HashKey(const LZSS_COMPR* lzss, const uint8_t* key)
+{
+	/* hash the THRESHOLD+1 bytes that make up the shortest possible match */
+	unsigned int h = 0;
+	unsigned int i;
+
+	for (i = 0; i <= lzss->THRESHOLD; i++)
+		h = (h << 8) ^ (h >> 24) ^ key[i];
+	return (h * 0x9E3779B1U) >> (32 - HC_BITS);
+}
+
+static void InitHash(LZSS_COMPR* lzss)  /* initialize hash chains */
+{
+	unsigned int i;
+
+	for (i = 0; i < HC_SIZE; i++) lzss->hc_head[i] = lzss->NIL;
+}
+
+static void HashInsertNode(LZSS_COMPR* lzss, int r)
+	/* Same contract as InsertNode(), but searches the hash chain of
+	   text_buf[r..r+THRESHOLD] for at most maxSteps links.
+	   Chains are never unlinked.  Instead, a link is only followed while
+	   the distance to r keeps growing and stays within the N-F bytes of
+	   history, which stops at positions that were overwritten since. */
+{
+	const uint8_t* text_buf = lzss->text_buf;
+	const uint8_t* key = &text_buf[r];
+	unsigned int F = lzss->F;
+	unsigned int maskN = lzss->N - 1;
+	unsigned int maxDist = lzss->N - F;
+	unsigned int lastDist = 0;
+	unsigned int depth = lzss->maxSteps;
+	unsigned int goodLen = lzss->goodLen;
+	unsigned int h, i, dist;
+	unsigned int mlen = 0;
+	int  p, mpos = 0;
+
+	h = HashKey(lzss, key);
+	for (p = lzss->hc_head[h]; p != (int)lzss->NIL && depth > 0; p = lzss->hc_prev[p], depth--) {
+		const uint8_t* cand = &text_buf[p];
+		dist = (unsigned int)(r - p) & maskN;
+		if (dist <= lastDist || dist > maxDist)  break;
+		lastDist = dist;
+		if (cand[mlen] != key[mlen])  continue;
+		for (i = 0; i < F; i++)
+			if (key[i] != cand[i])  break;
+		if (i > mlen) {
+			mpos = p;
+			if ((mlen = i) >= goodLen)  break;
 		}
-		lzss->rson[q] = lzss->rson[p];  lzss->dad[lzss->rson[p]] = q;
 	}
-	lzss->dad[q] = lzss->dad[p];
-	if (lzss->rson[lzss->dad[p]] == p) lzss->rson[lzss->dad[p]] = q;  else lzss->lson[lzss->dad[p]] = q;
-	lzss->dad[p] = lzss->NIL;
+	lzss->match_length = mlen;
+	if (mlen > 0)  lzss->match_position = mpos;
+	lzss->hc_prev[r] = lzss->hc_head[h];  lzss->hc_head[h] = r;
+}
+
+static void HashDeleteNode(LZSS_COMPR* lzss, int p)
+{
+	/* nothing to do - stale links are skipped by HashInsertNode() */
+	(void)lzss;  (void)p;
 }
 
 static void InitNametable(LZSS_COMPR* lzss)
@@ -149,206 +844,1454 @@ static void InitNametable(LZSS_COMPR* lzss)
 	if (lzss->cfg.nameTblType == LZSS_NTINIT_VALUE)
 		memset(lzss->text_buf, lzss->cfg.nameTblValue, lzss->N);
 	else if (lzss->cfg.nameTblType == LZSS_NTINIT_FUNC)
-		lzss->cfg.nameTblFunc(lzss, lzss->cfg.ntFuncParam, lzss->N, lzss->text_buf);
+	{
+		if (lzss->snapState & SNAP_NAMETBL)
+		{
+			memcpy(lzss->text_buf, lzss->snap, lzss->N);
+		}
+		else
+		{
+			lzss->cfg.nameTblFunc(lzss, lzss->cfg.ntFuncParam, lzss->N, lzss->text_buf);
+			memcpy(lzss->snap, lzss->text_buf, lzss->N);
+			lzss->snapState |= SNAP_NAMETBL;
+		}
+	}
 	else
 		memset(lzss->text_buf, 0x00, lzss->N);
 }
 
-uint8_t lzssEncode(LZSS_COMPR* lzss, size_t bufSize, uint8_t* buffer, size_t* bytesWritten, size_t inSize, const uint8_t* inData)
+static void SeedNametable(LZSS_COMPR* lzss, unsigned int r)
 {
-	size_t codesize = 0;		/* code size counter */
-
-	unsigned int i, len, r, s, last_match_length, code_buf_ptr;
+	/* Restores text_buf and the match finder with the name table strings that don't reach into
+	   the lookahead buffer at r. They don't depend on the input data, so they are built only once
+	   and then kept in a snapshot. The remaining strings are inserted by StartEncoding(). */
 	unsigned int maskN = lzss->N - 1;
-	uint8_t code_buf[17];	// control byte (1) + 8 reference words (16)
-	uint8_t mask;
-	size_t inPos;
-	size_t outPos;
+	unsigned int i;
 
-	if (inSize == 0)  /* text of size zero */
+	if (lzss->snapState & SNAP_TREE)
 	{
-		if (bytesWritten != NULL) *bytesWritten = 0;
-		return LZSS_ERR_OK;
+		memcpy(lzss->mem, lzss->snap, lzss->setSize);
+		return;
 	}
 
-	lzss->match_position = 0;
-	lzss->match_length = 0;
-	InitTree(lzss);  /* initialize trees */
-	code_buf[0] = 0;  /* code_buf[1..16] saves eight units of code, and
-		code_buf[0] works as eight flags, "1" representing that the unit
-		is an unencoded letter (1 byte), "0" a position-and-length pair
-		(2 bytes).  Thus, eight units require at most 16 bytes of code. */
-	code_buf_ptr = 1;
-	mask = ((lzss->cfg.flags & LZSS_FLAGS_CTRLMASK) == LZSS_FLAGS_CTRL_L) ? 0x01 : 0x80;
-
+	lzss->InitTree(lzss);
 	InitNametable(lzss);
-
-	inPos = 0;
-	outPos = 0;
-	if (lzss->cfg.nameTblStartOfs == LZSS_NTSTOFS_NF)
-		r = lzss->N - lzss->F;
-	else
-		r = lzss->cfg.nameTblStartOfs & maskN;
-	s = (r + lzss->F) & maskN;
-	for (len = 0; len < lzss->F && inPos < inSize; len++)
+	memcpy(&lzss->text_buf[lzss->N], &lzss->text_buf[0], lzss->F - 1);
+	if (lzss->cfg.matchFinder == LZSS_MF_HASH)
 	{
-		uint8_t c = inData[inPos++];
-		lzss->text_buf[(r + len) & maskN] = c;  /* Read F bytes into the last F bytes of
-			the buffer */
+		// oldest to newest string, the hash key covers THRESHOLD+1 bytes
+		for (i = lzss->N - lzss->F; i > lzss->THRESHOLD; i--) lzss->InsertNode(lzss, (r + lzss->N - i) & maskN);
 	}
-	memcpy(&lzss->text_buf[lzss->N], &lzss->text_buf[0], lzss->F - 1);	// for easy string comparison
-	if (lzss->cfg.nameTblType == LZSS_NTINIT_FUNC)
+	else
 	{
-		// build a tree so that the whole nametable is included
-		for (i = 1; i <= lzss->N - lzss->F; i++) InsertNode(lzss, (r + lzss->N - i) & maskN);
+		// newest to oldest string, each string covers F bytes
+		for (i = lzss->F; i <= lzss->N - lzss->F; i++) lzss->InsertNode(lzss, (r + lzss->N - i) & maskN);
 	}
-	else if (lzss->cfg.nameTblType != LZSS_NTINIT_NONE)
-	{
-		for (i = 1; i <= lzss->F; i++) InsertNode(lzss, (r + lzss->N - i) & maskN);  /* Insert the F strings,
-			each of which begins with one or more 'space' characters.  Note
-			the order in which these strings are inserted.  This way,
-			degenerate trees will be less likely to occur. */
+	memcpy(lzss->snap, lzss->mem, lzss->setSize);
+	lzss->snapState |= SNAP_NAMETBL | SNAP_TREE;
+	return;
+}
+
+static void PutReference(const LZSS_COMPR* lzss, uint8_t* dst, unsigned int pos, unsigned int mlen)
+{
+	/* write a reference word (ring buffer position + encoded match length) in stream order */
+	unsigned int lenBits = lzss->lenBits;
+	unsigned int word;
+
+	switch(lzss->cfg.flags & LZSS_FLAGS_MTCH_LMASK)
+	{
+	case LZSS_FLAGS_MTCH_L_HH:
+		word = pos | (mlen << (16 - lenBits));
+		break;
+	case LZSS_FLAGS_MTCH_L_HL:
+	default:
+		word = (pos & 0xFF) | (mlen << 8) | ((pos >> 8) << (8 + lenBits));
+		break;
+	case LZSS_FLAGS_MTCH_L_LH:
+		word = (pos & (0xFF >> lenBits)) | (mlen << (8 - lenBits)) | ((pos >> (8 - lenBits)) << 8);
+		break;
+	case LZSS_FLAGS_MTCH_L_LL:
+		word = mlen | (pos << lenBits);
+		break;
+	}
+	if ((lzss->cfg.flags & LZSS_FLAGS_MTCH_EMASK) == LZSS_FLAGS_MTCH_ELITTLE)
+	{
+		dst[0] = (uint8_t)(word >> 0);
+		dst[1] = (uint8_t)(word >> 8);
+	}
+	else //if ((lzss->cfg.flags & LZSS_FLAGS_MTCH_EMASK) == LZSS_FLAGS_MTCH_EBIG)
+	{
+		dst[0] = (uint8_t)(word >> 8);
+		dst[1] = (uint8_t)(word >> 0);
+	}
+	return;
+}
+
+static uint8_t FlushCodeBuf(LZSS_COMPR* lzss, size_t bufSize, uint8_t* buffer, size_t* outPos)
+{
+	/* write the part of code_buf that wasn't output yet */
+	unsigned int i = lzss->code_buf_out;
+	size_t pos = *outPos;
+
+	for (; i < lzss->code_buf_ptr; i++)
+	{
+		if (pos >= bufSize)
+			break;
+		buffer[pos++] = lzss->code_buf[i];
+	}
+	lzss->stats.bytesOut += i - lzss->code_buf_out;
+	HashUpdate(lzss, &lzss->code_buf[lzss->code_buf_out], i - lzss->code_buf_out);
+	lzss->code_buf_out = i;
+	*outPos = pos;
+	return (i < lzss->code_buf_ptr) ? LZSS_ERR_EOF_OUT : LZSS_ERR_OK;
+}
+
+static void ResetEncoder(LZSS_COMPR* lzss)
+{
+	/* reset the encoder state, except for the ring buffer and match finder */
+	unsigned int maskN = lzss->N - 1;
+
+	lzss->match_position = 0;
+	lzss->match_length = 0;
+	lzss->code_buf[0] = 0;  /* code_buf[1..16] saves eight units of code, and
+		code_buf[0] works as eight flags, "1" representing that the unit
+		is an unencoded letter (1 byte), "0" a position-and-length pair
+		(2 bytes).  Thus, eight units require at most 16 bytes of code. */
+	lzss->code_buf_ptr = 1;
+	lzss->code_buf_out = 0;
+	lzss->code_mask = ((lzss->cfg.flags & LZSS_FLAGS_CTRLMASK) == LZSS_FLAGS_CTRL_L) ? 0x01 : 0x80;
+
+	if (lzss->cfg.nameTblStartOfs == LZSS_NTSTOFS_NF)
+		lzss->enc_r = lzss->N - lzss->F;
+	else
+		lzss->enc_r = lzss->cfg.nameTblStartOfs & maskN;
+	lzss->enc_s = (lzss->enc_r + lzss->F) & maskN;
+	lzss->enc_len = 0;
+	lzss->enc_advance = 0;
+	lzss->enc_lazy = 0;
+	lzss->enc_store = 0;
+	lzss->enc_pos = 0;
+	lzss->probe_start = 0;
+	lzss->probe_out = 0;
+	lzss->enc_state = ENCST_FILL;
+	return;
+}
+
+void lzssEncodeBegin(LZSS_COMPR* lzss)
+{
+	ResetEncoder(lzss);
+	ResetStats(lzss);
+	if (lzss->cfg.nameTblType == LZSS_NTINIT_FUNC)
+	{
+		SeedNametable(lzss, lzss->enc_r);
+	}
+	else
+	{
+		lzss->InitTree(lzss);  /* initialize trees */
+		InitNametable(lzss);
+	}
+	return;
+}
+
+static void RebuildMatchFinder(LZSS_COMPR* lzss, unsigned int r, unsigned int histLen)
+{
+	/* register the histLen strings before r from the oldest to the newest
+	   (like the encoder would have done when passing them), then the string at r */
+	unsigned int maskN = lzss->N - 1;
+	unsigned int i;
+
+	lzss->InitTree(lzss);
+	for (i = histLen; i >= 1; i--) lzss->InsertNode(lzss, (r - i) & maskN);
+	lzss->InsertNode(lzss, r);
+	return;
+}
+
+static int LooksRandom(const LZSS_COMPR* lzss)
+{
+	/* Checks if the ring buffer has an (order 2) entropy of at least 7.5 bits per byte:
+	   the sum of squared byte counts is at most N^2 / 2^7.5 then. */
+	unsigned int hist[0x100];
+	unsigned int i, sum;
+
+	memset(hist, 0x00, sizeof(hist));
+	for (i = 0; i < lzss->N; i++)
+		hist[lzss->text_buf[i]] ++;
+	sum = 0;
+	for (i = 0; i < 0x100; i++)
+		sum += hist[i] * hist[i];
+	return (sum <= lzss->N * lzss->N / 181);
+}
+
+static void CheckCompressibility(LZSS_COMPR* lzss, unsigned int r)
+{
+	/* LZSS_STORE_AUTO: called after sending a group of units, r is the current position */
+	size_t span = lzss->enc_pos - lzss->probe_start;
+
+	if (! lzss->enc_store)
+	{
+		if (span < PROBE_LEN)
+			return;
+		/* Literals take 9 bits per byte.  Stop searching when the probe saved less than 1/64 of that. */
+		if (lzss->probe_out * 8 * 64 >= span * 9 * 63)
+			lzss->enc_store = 1;
+	}
+	else
+	{
+		unsigned int histLen;
+		if (span < STORE_SPAN)
+			return;
+		if (! LooksRandom(lzss))
+		{
+			/* resume searching - the ring buffer still holds the history */
+			histLen = lzss->N - lzss->F;
+			if (lzss->cfg.nameTblType == LZSS_NTINIT_NONE && lzss->enc_pos < histLen)
+				histLen = (unsigned int)lzss->enc_pos;	// no references to the uninitialized name table
+			RebuildMatchFinder(lzss, r, histLen);
+			lzss->enc_store = 0;
+		}
+	}
+	lzss->probe_start = lzss->enc_pos;
+	lzss->probe_out = 0;
+	return;
+}
+
+static size_t StoreGroups(LZSS_COMPR* lzss, unsigned int r, unsigned int s, size_t bufSize, uint8_t* buffer,
+	size_t inSize, const uint8_t* inData)
+{
+	/* Sends groups of 8 literals (control byte 0xFF) until the end of the store span, starting
+	   with a full lookahead buffer at r.  The ring buffer is updated in one go at the end.
+	   Returns the number of bytes passed, which is also the number of bytes read. */
+	unsigned int maskN = lzss->N - 1;
+	unsigned int F = lzss->F;
+	const uint8_t* ahead = &lzss->text_buf[r];	// lookahead buffer, made contiguous by the mirrored bytes
+	size_t groups, g, pos, outPos, spanLeft, keep;
+
+	groups = inSize / 8;
+	if (groups > bufSize / 9)
+		groups = bufSize / 9;
+	spanLeft = lzss->enc_pos - lzss->probe_start;
+	spanLeft = (spanLeft < STORE_SPAN) ? (STORE_SPAN - spanLeft) : 0;
+	if (groups > (spanLeft + 7) / 8)
+		groups = (spanLeft + 7) / 8;
+
+	/* The literals are the lookahead buffer followed by the input. */
+	outPos = 0;
+	for (g = 0, pos = 0; g < groups; g++, pos += 8)
+	{
+		buffer[outPos++] = 0xFF;
+		if (pos + 8 <= F)
+		{
+			memcpy(&buffer[outPos], &ahead[pos], 8);
+		}
+		else if (pos >= F)
+		{
+			memcpy(&buffer[outPos], &inData[pos - F], 8);
+		}
+		else
+		{
+			memcpy(&buffer[outPos], &ahead[pos], F - pos);
+			memcpy(&buffer[outPos + F - pos], inData, 8 - (F - pos));
+		}
+		outPos += 8;
+	}
+	lzss->stats.literals += pos;
+	lzss->stats.bytesOut += outPos;
+	HashUpdate(lzss, buffer, outPos);
+
+	/* put the last N bytes read into the ring buffer */
+	keep = (pos < lzss->N) ? pos : lzss->N;
+	s = (s + (unsigned int)((pos - keep) & maskN)) & maskN;
+	for (g = pos - keep; keep > 0; )
+	{
+		size_t part = lzss->N - s;
+		if (part > keep)
+			part = keep;
+		memcpy(&lzss->text_buf[s], &inData[g], part);
+		g += part;  keep -= part;
+		s = (s + (unsigned int)part) & maskN;
+	}
+	memcpy(&lzss->text_buf[lzss->N], &lzss->text_buf[0], F - 1);
+	lzss->enc_pos += pos;
+	return pos;
+}
+
+static void StartEncoding(LZSS_COMPR* lzss)
+{
+	/* called once the lookahead buffer is filled (or the input ended) */
+	unsigned int maskN = lzss->N - 1;
+	unsigned int r = lzss->enc_r;
+	unsigned int i, ntStrings;
+
+	memcpy(&lzss->text_buf[lzss->N], &lzss->text_buf[0], lzss->F - 1);	// for easy string comparison
+	if (lzss->cfg.nameTblType == LZSS_NTINIT_FUNC)
+	{
+		// The whole nametable is included. SeedNametable() did all strings except for the ones
+		// that overlap the lookahead buffer.
+		if (lzss->cfg.matchFinder == LZSS_MF_HASH)
+			ntStrings = lzss->THRESHOLD;
+		else
+			ntStrings = lzss->F - 1;
+	}
+	else if (lzss->cfg.nameTblType != LZSS_NTINIT_NONE)
+		ntStrings = lzss->F;	/* Insert the F strings,
+			each of which begins with one or more 'space' characters. */
+	else
+		ntStrings = 0;
+	if (lzss->cfg.matchFinder == LZSS_MF_HASH)
+	{
+		// hash chains must be built from the oldest to the newest string
+		for (i = ntStrings; i >= 1; i--) lzss->InsertNode(lzss, (r + lzss->N - i) & maskN);
+	}
+	else
+	{
+		/* Note the order in which these strings are inserted.  This way,
+		   degenerate trees will be less likely to occur. */
+		for (i = 1; i <= ntStrings; i++) lzss->InsertNode(lzss, (r + lzss->N - i) & maskN);
 	}
-	InsertNode(lzss, r);  /* Finally, insert the whole string just read.  The
+	lzss->InsertNode(lzss, r);  /* Finally, insert the whole string just read.  The
 		global variables match_length and match_position are set. */
-	do {
+	return;
+}
+
+static uint8_t EncodeRun(LZSS_COMPR* lzss, size_t bufSize, uint8_t* buffer, size_t* bytesWritten,
+	size_t inSize, const uint8_t* inData, size_t* bytesRead, int final)
+{
+	unsigned int maskN = lzss->N - 1;
+	unsigned int ctrlMSB = ((lzss->cfg.flags & LZSS_FLAGS_CTRLMASK) == LZSS_FLAGS_CTRL_M);
+	unsigned int r, s, len, advance;
+	size_t inPos = 0;
+	size_t outPos = 0;
+	uint8_t ret = LZSS_ERR_OK;
+
+	if (lzss->enc_state == ENCST_FILL)
+	{
+		r = lzss->enc_r;
+		len = lzss->enc_len;
+		while(len < lzss->F && inPos < inSize)
+		{
+			/* Read F bytes into the last F bytes of the buffer */
+			lzss->text_buf[(r + len) & maskN] = inData[inPos++];
+			len ++;
+		}
+		lzss->enc_len = len;
+		if (len < lzss->F && ! final)
+			goto finish;	// need more input
+		if (len == 0)
+		{
+			lzss->enc_state = ENCST_DONE;	/* text of size zero */
+			goto finish;
+		}
+		StartEncoding(lzss);
+		lzss->enc_state = ENCST_RUN;
+	}
+
+	r = lzss->enc_r;  s = lzss->enc_s;
+	len = lzss->enc_len;  advance = lzss->enc_advance;
+	while(lzss->enc_state == ENCST_RUN)
+	{
+		if (lzss->code_mask == 0)
+		{
+			ret = FlushCodeBuf(lzss, bufSize, buffer, &outPos);  /* Send at most 8 units of code together */
+			if (ret != LZSS_ERR_OK)
+				break;
+			if (lzss->cfg.storeMode == LZSS_STORE_AUTO)
+			{
+				lzss->probe_out += lzss->code_buf_ptr;
+				CheckCompressibility(lzss, r);
+			}
+			lzss->code_buf[0] = 0;  lzss->code_buf_ptr = 1;  lzss->code_buf_out = 0;
+			lzss->code_mask = ctrlMSB ? 0x80 : 0x01;
+		}
+		if (lzss->enc_store && lzss->code_buf_ptr == 1 && advance == 0 && ! lzss->enc_lazy && len == lzss->F)
+		{
+			/* incompressible data: send whole groups of literals directly */
+			size_t passed = StoreGroups(lzss, r, s, bufSize - outPos, &buffer[outPos], inSize - inPos, &inData[inPos]);
+			if (passed > 0)
+			{
+				outPos += passed / 8 * 9;
+				inPos += passed;
+				r = (r + (unsigned int)(passed & maskN)) & maskN;
+				s = (s + (unsigned int)(passed & maskN)) & maskN;
+				CheckCompressibility(lzss, r);
+				continue;
+			}
+		}
+		if (advance > 0)
+		{
+			lzss->enc_pos ++;
+			if (lzss->enc_store)
+			{
+				/* no match search - just keep the ring buffer up to date */
+				if (inPos < inSize)
+				{
+					uint8_t c = inData[inPos++];
+					lzss->text_buf[s] = c;
+					if (s < lzss->F - 1) lzss->text_buf[s + lzss->N] = c;
+				}
+				else if (! final)
+				{
+					lzss->enc_pos --;
+					break;	// need more input
+				}
+				else
+				{
+					len --;
+				}
+				s = (s + 1) & maskN;  r = (r + 1) & maskN;
+			}
+			else if (inPos < inSize)
+			{
+				uint8_t c;
+				lzss->DeleteNode(lzss, s);	/* Delete old strings and */
+				c = inData[inPos++];
+				lzss->text_buf[s] = c;	/* read new bytes */
+				if (s < lzss->F - 1) lzss->text_buf[s + lzss->N] = c;  /* If the position is
+					near the end of buffer, extend the buffer to make
+					string comparison easier. */
+				s = (s + 1) & maskN;  r = (r + 1) & maskN;
+					/* Since this is a ring buffer, increment the position
+					   modulo N. */
+				lzss->InsertNode(lzss, r);	/* Register the string in text_buf[r..r+F-1] */
+			}
+			else if (! final)
+			{
+				lzss->enc_pos --;
+				break;	// need more input
+			}
+			else
+			{
+				/* After the end of text, */
+				lzss->DeleteNode(lzss, s);			/* no need to read, but */
+				s = (s + 1) & maskN;  r = (r + 1) & maskN;
+				if (--len) lzss->InsertNode(lzss, r);	/* buffer may not be empty. */
+			}
+			advance --;
+			continue;
+		}
+		if (len == 0)
+		{
+			/* length of string to be processed is zero - prepare sending the remaining code */
+			lzss->enc_state = ENCST_FLUSH;
+			break;
+		}
+
+		if (lzss->enc_store)
+			lzss->match_length = 0;	/* incompressible data - send literals (and a deferred match) */
 		if (lzss->match_length > len) lzss->match_length = len;  /* match_length
 			may be spuriously long near the end of text. */
+		if (lzss->cfg.eosMode == LZSS_EOSM_REF0 && lzss->match_position == 0 &&
+			lzss->match_length == lzss->THRESHOLD + 1)
+			lzss->match_length = 0;	/* would be encoded as the "null-reference" end marker */
+		if (lzss->enc_lazy) {
+			/* The match for the previous position was deferred.  r is one byte ahead of it. */
+			lzss->enc_lazy = 0;
+			if (lzss->match_length > lzss->lazy_len) {
+				/* The match here is longer.  Send the previous byte uncoded and
+				   decide about this match in the next iteration. */
+				lzss->code_buf[0] |= lzss->code_mask;
+				lzss->code_buf[lzss->code_buf_ptr++] = lzss->lazy_byte;
+				lzss->stats.literals ++;
+				advance = 0;
+			} else {
+				/* Send the deferred match.  Its first byte was already passed. */
+				PutReference(lzss, &lzss->code_buf[lzss->code_buf_ptr], lzss->lazy_pos,
+					lzss->lazy_len - (lzss->THRESHOLD + 1));
+				lzss->code_buf_ptr += 2;
+				CountMatch(&lzss->stats, lzss->lazy_len);
+				advance = lzss->lazy_len - 1;
+			}
+			if (ctrlMSB)
+				lzss->code_mask >>= 1;
+			else
+				lzss->code_mask <<= 1;
+			continue;
+		}
+		if (lzss->match_length > lzss->THRESHOLD && lzss->match_length >= 2 &&
+			lzss->match_length < lzss->lazyLen) {
+			/* Lazy matching: look for a longer match at the next position before sending this one. */
+			lzss->enc_lazy = 1;
+			lzss->lazy_pos = lzss->match_position;
+			lzss->lazy_len = lzss->match_length;
+			lzss->lazy_byte = lzss->text_buf[r];
+			advance = 1;
+			continue;
+		}
 		if (lzss->match_length <= lzss->THRESHOLD) {
 			lzss->match_length = 1;  /* Not long enough match.  Send one byte. */
-			code_buf[0] |= mask;  /* 'send one byte' flag */
-			code_buf[code_buf_ptr++] = lzss->text_buf[r];  /* Send uncoded. */
+			lzss->code_buf[0] |= lzss->code_mask;  /* 'send one byte' flag */
+			lzss->code_buf[lzss->code_buf_ptr++] = lzss->text_buf[r];  /* Send uncoded. */
+			lzss->stats.literals ++;
 		} else {
 			/* Send position and length pair. Note match_length > THRESHOLD. */
-			unsigned int mlen = lzss->match_length - (lzss->THRESHOLD + 1);
-			uint8_t i, j;
-			switch(lzss->cfg.flags & LZSS_FLAGS_MTCH_LMASK)
+			PutReference(lzss, &lzss->code_buf[lzss->code_buf_ptr], lzss->match_position,
+				lzss->match_length - (lzss->THRESHOLD + 1));
+			lzss->code_buf_ptr += 2;
+			CountMatch(&lzss->stats, lzss->match_length);
+		}
+		if (ctrlMSB)
+			lzss->code_mask >>= 1;	// shift right one bit (high -> low)
+		else
+			lzss->code_mask <<= 1;	// shift left one bit (low -> high)
+		advance = lzss->match_length;
+	}
+	lzss->enc_r = r;  lzss->enc_s = s;
+	lzss->enc_len = len;  lzss->enc_advance = advance;
+
+	if (lzss->enc_state == ENCST_FLUSH)
+	{
+		if (lzss->code_buf_ptr > 1)
+		{
+			ret = FlushCodeBuf(lzss, bufSize, buffer, &outPos);  /* Send remaining code. */
+			if (ret != LZSS_ERR_OK)
+				goto finish;
+		}
+		if (lzss->cfg.eosMode == LZSS_EOSM_REF0)
+		{
+			// add null-reference
+			if (lzss->code_buf_ptr > 1 && lzss->code_mask != 0)
 			{
-			case LZSS_FLAGS_MTCH_L_HH:
-				i = (uint8_t)lzss->match_position;
-				j = (uint8_t)(((lzss->match_position >> 8) & 0x0f) | (mlen << 4));
-				break;
-			case LZSS_FLAGS_MTCH_L_HL:
-			default:
-				i = (uint8_t)lzss->match_position;
-				j = (uint8_t)(((lzss->match_position >> 4) & 0xf0) | mlen);
-				break;
-			case LZSS_FLAGS_MTCH_L_LH:
-				i = (uint8_t)((lzss->match_position & 0x0f) | (mlen << 4));
-				j = (uint8_t)(lzss->match_position >> 4);
-				break;
-			case LZSS_FLAGS_MTCH_L_LL:
-				i = (uint8_t)(((lzss->match_position << 4) & 0xf0) | mlen);
-				j = (uint8_t)(lzss->match_position >> 4);
-				break;
+				lzss->code_buf_out = 1;	// the last control byte has a free bit - just write the terminating reference word
+			}
+			else
+			{
+				lzss->code_buf[0] = 0;	// "reference flag" control byte
+				lzss->code_buf_out = 0;	// write control byte + reference word
 			}
-			if ((lzss->cfg.flags & LZSS_FLAGS_MTCH_EMASK) == LZSS_FLAGS_MTCH_ELITTLE)
+			lzss->code_buf[1] = lzss->code_buf[2] = 0;	// reference word
+			lzss->code_buf_ptr = 3;
+			lzss->enc_state = ENCST_EOS;
+		}
+		else
+		{
+			lzss->enc_state = ENCST_DONE;
+		}
+	}
+	if (lzss->enc_state == ENCST_EOS)
+	{
+		ret = FlushCodeBuf(lzss, bufSize, buffer, &outPos);
+		if (ret != LZSS_ERR_OK)
+			goto finish;
+		lzss->enc_state = ENCST_DONE;
+	}
+
+finish:
+	lzss->stats.bytesIn += inPos;
+	if (bytesWritten != NULL) *bytesWritten = outPos;
+	if (bytesRead != NULL) *bytesRead = inPos;
+	return ret;
+}
+
+#define OPT_BLOCK	0x8000	/* number of positions the optimal parser looks at in one go */
+#define OPT_COST_LIT	9	/* cost of a literal in bits, including its control bit */
+#define OPT_COST_REF	17	/* cost of a reference in bits, including its control bit */
+
+static uint8_t EncodeOptimal(LZSS_COMPR* lzss, size_t bufSize, uint8_t* buffer, size_t* bytesWritten,
+	size_t inSize, const uint8_t* inData)
+	/* Encodes the whole input (final = 1) with an optimal parse.  A reference costs
+	   the same for every offset and each prefix of a match is a match as well, so the
+	   longest match per position covers all candidates: the shortest parse follows
+	   from trying every length up to it.  The match finder runs over a block of
+	   positions first, then a backward pass finds the cheapest way to encode the
+	   block and the units are sent.  Matches don't cross the end of a block. */
+{
+	unsigned int maskN = lzss->N - 1;
+	unsigned int ctrlMSB = ((lzss->cfg.flags & LZSS_FLAGS_CTRLMASK) == LZSS_FLAGS_CTRL_M);
+	unsigned int minLen = lzss->THRESHOLD + 1;
+	unsigned int r, s, len;
+	unsigned int* cost;		/* per position: cost of encoding the rest of the block */
+	unsigned short* mlen;	/* longest match */
+	unsigned short* mpos;
+	unsigned short* choice;	/* chosen unit: 0 = literal, else match length */
+	uint8_t* lit;
+	size_t inPos = 0;
+	size_t outPos = 0;
+	size_t wrtLen;
+	unsigned int blkLen, i, l;
+	uint8_t ret = LZSS_ERR_OK;
+
+	cost = (unsigned int*)malloc((OPT_BLOCK + 1) * sizeof(unsigned int) + OPT_BLOCK * (3 * sizeof(unsigned short) + 1));
+	if (cost == NULL)
+		return LZSS_ERR_NO_MEM;
+	mlen = (unsigned short*)&cost[OPT_BLOCK + 1];
+	mpos = &mlen[OPT_BLOCK];
+	choice = &mpos[OPT_BLOCK];
+	lit = (uint8_t*)&choice[OPT_BLOCK];
+
+	if (lzss->enc_state == ENCST_FILL)
+	{
+		r = lzss->enc_r;
+		for (len = lzss->enc_len; len < lzss->F && inPos < inSize; len++)
+			lzss->text_buf[(r + len) & maskN] = inData[inPos++];
+		lzss->enc_len = len;
+		if (len == 0)
+		{
+			lzss->enc_state = ENCST_DONE;	/* text of size zero */
+			goto finish;
+		}
+		StartEncoding(lzss);
+		lzss->enc_state = ENCST_RUN;
+	}
+	r = lzss->enc_r;  s = lzss->enc_s;
+	len = lzss->enc_len;
+	while(len > 0)
+	{
+		/* collect the longest match for each position of the block */
+		for (blkLen = 0; len > 0 && blkLen < OPT_BLOCK; blkLen++)
+		{
+			l = (lzss->match_length < len) ? lzss->match_length : len;
+			mlen[blkLen] = (unsigned short)l;
+			mpos[blkLen] = (unsigned short)lzss->match_position;
+			lit[blkLen] = lzss->text_buf[r];
+
+			lzss->DeleteNode(lzss, s);
+			if (inPos < inSize)
 			{
-				code_buf[code_buf_ptr++] = i;
-				code_buf[code_buf_ptr++] = j;
+				uint8_t c = inData[inPos++];
+				lzss->text_buf[s] = c;
+				if (s < lzss->F - 1) lzss->text_buf[s + lzss->N] = c;
 			}
-			else //if ((lzss->cfg.flags & LZSS_FLAGS_MTCH_EMASK) == LZSS_FLAGS_MTCH_EBIG)
+			else
 			{
-				code_buf[code_buf_ptr++] = j;
-				code_buf[code_buf_ptr++] = i;
+				len --;
 			}
+			s = (s + 1) & maskN;  r = (r + 1) & maskN;
+			if (len > 0) lzss->InsertNode(lzss, r);
 		}
-		if ((lzss->cfg.flags & LZSS_FLAGS_CTRLMASK) == LZSS_FLAGS_CTRL_L)
-			mask <<= 1;	// shift left one bit (low -> high)
-		else //if ((lzss->cfg.flags & LZSS_FLAGS_CTRLMASK) == LZSS_FLAGS_CTRL_H)
-			mask >>= 1;	// shift right one bit (high -> low)
-		if (mask == 0) {
-			for (i = 0; i < code_buf_ptr; i++)  /* Send at most 8 units of */
+
+		/* find the cheapest parse, from the end of the block backwards */
+		cost[blkLen] = 0;
+		for (i = blkLen; i-- > 0; )
+		{
+			unsigned int best = OPT_COST_LIT + cost[i + 1];
+			unsigned int bestLen = 0;
+			unsigned int maxLen = mlen[i];
+			if (maxLen > blkLen - i)
+				maxLen = blkLen - i;
+			l = minLen;
+			if (lzss->cfg.eosMode == LZSS_EOSM_REF0 && mpos[i] == 0)
+				l ++;	/* would be encoded as the "null-reference" end marker */
+			for (; l <= maxLen; l++)
 			{
-				if (outPos >= bufSize)
+				unsigned int c = OPT_COST_REF + cost[i + l];
+				if (c <= best)
 				{
-					if (bytesWritten != NULL) *bytesWritten = outPos;
-					return LZSS_ERR_EOF_OUT;
+					best = c;
+					bestLen = l;
 				}
-				buffer[outPos++] = code_buf[i]; /* code together */
 			}
-			codesize += code_buf_ptr;
-			code_buf[0] = 0;  code_buf_ptr = 1;
-			mask = ((lzss->cfg.flags & LZSS_FLAGS_CTRLMASK) == LZSS_FLAGS_CTRL_L) ? 0x01 : 0x80;
-		}
-		last_match_length = lzss->match_length;
-		for (i = 0; i < last_match_length; i++) {
-			uint8_t c;
-			if (inPos >= inSize)
-				break;
-			DeleteNode(lzss, s);	/* Delete old strings and */
-			c = inData[inPos++];
-			lzss->text_buf[s] = c;	/* read new bytes */
-			if (s < lzss->F - 1) lzss->text_buf[s + lzss->N] = c;  /* If the position is
-				near the end of buffer, extend the buffer to make
-				string comparison easier. */
-			s = (s + 1) & maskN;  r = (r + 1) & maskN;
-				/* Since this is a ring buffer, increment the position
-				   modulo N. */
-			InsertNode(lzss, r);	/* Register the string in text_buf[r..r+F-1] */
-		}
-		while (i++ < last_match_length) {	/* After the end of text, */
-			DeleteNode(lzss, s);			/* no need to read, but */
-			s = (s + 1) & maskN;  r = (r + 1) & maskN;
-			if (--len) InsertNode(lzss, r);	/* buffer may not be empty. */
+			cost[i] = best;
+			choice[i] = (unsigned short)bestLen;
 		}
-	} while (len > 0);	/* until length of string to be processed is zero */
-	if (code_buf_ptr > 1) {		/* Send remaining code. */
-		for (i = 0; i < code_buf_ptr; i++)
+
+		/* send the units */
+		for (i = 0; i < blkLen; )
 		{
-			if (outPos >= bufSize)
+			if (lzss->code_mask == 0)
 			{
-				if (bytesWritten != NULL) *bytesWritten = outPos;
-				return LZSS_ERR_EOF_OUT;
+				ret = FlushCodeBuf(lzss, bufSize, buffer, &outPos);
+				if (ret != LZSS_ERR_OK)
+					goto finish;
+				lzss->code_buf[0] = 0;  lzss->code_buf_ptr = 1;  lzss->code_buf_out = 0;
+				lzss->code_mask = ctrlMSB ? 0x80 : 0x01;
 			}
-			buffer[outPos++] = code_buf[i];
+			if (choice[i] == 0)
+			{
+				lzss->code_buf[0] |= lzss->code_mask;
+				lzss->code_buf[lzss->code_buf_ptr++] = lit[i];
+				lzss->stats.literals ++;
+				i ++;
+			}
+			else
+			{
+				PutReference(lzss, &lzss->code_buf[lzss->code_buf_ptr], mpos[i], choice[i] - minLen);
+				lzss->code_buf_ptr += 2;
+				CountMatch(&lzss->stats, choice[i]);
+				i += choice[i];
+			}
+			if (ctrlMSB)
+				lzss->code_mask >>= 1;
+			else
+				lzss->code_mask <<= 1;
 		}
-		codesize += code_buf_ptr;
 	}
-	if (lzss->cfg.eosMode == LZSS_EOSM_REF0)
+
+	/* the remaining units and the end-of-stream marker are sent by EncodeRun() */
+	lzss->enc_state = ENCST_FLUSH;
+	ret = EncodeRun(lzss, bufSize - outPos, &buffer[outPos], &wrtLen, 0, NULL, NULL, 1);
+	outPos += wrtLen;
+
+finish:
+	free(cost);
+	lzss->stats.bytesIn += inPos;
+	if (bytesWritten != NULL) *bytesWritten = outPos;
+	return ret;
+}
+
+uint8_t lzssEncodeChunk(LZSS_COMPR* lzss, size_t bufSize, uint8_t* buffer, size_t* bytesWritten,
+	size_t inSize, const uint8_t* inData, size_t* bytesRead)
+{
+	return EncodeRun(lzss, bufSize, buffer, bytesWritten, inSize, inData, bytesRead, 0);
+}
+
+uint8_t lzssEncodeEnd(LZSS_COMPR* lzss, size_t bufSize, uint8_t* buffer, size_t* bytesWritten)
+{
+	return EncodeRun(lzss, bufSize, buffer, bytesWritten, 0, NULL, NULL, 1);
+}
+
+size_t lzssEncodeBound(const LZSS_CFG* config, size_t inSize)
+{
+	/* Each unit encodes at least one byte. Literals take 1 byte, references 2 bytes for
+	   THRESHOLD+1 or more bytes, so they are only larger than the input with THRESHOLD = 0. */
+	size_t unitBytes = (config->THRESHOLD > 0) ? inSize : inSize * 2;
+	size_t ctrlBytes = (inSize + 7) / 8;
+	size_t eosBytes = (config->eosMode == LZSS_EOSM_REF0) ? 3 : 0;	// control byte + null-reference
+	return unitBytes + ctrlBytes + eosBytes;
+}
+
+uint8_t lzssEncode(LZSS_COMPR* lzss, size_t bufSize, uint8_t* buffer, size_t* bytesWritten, size_t inSize, const uint8_t* inData)
+{
+	size_t outPos;
+	uint8_t ret;
+
+	lzssEncodeBegin(lzss);
+	if (lzss->cfg.parser == LZSS_PARSE_OPTIMAL)
+		ret = EncodeOptimal(lzss, bufSize, buffer, &outPos, inSize, inData);
+	else
+		ret = EncodeRun(lzss, bufSize, buffer, &outPos, inSize, inData, NULL, 1);
+	if (bytesWritten != NULL) *bytesWritten = outPos;
+	return ret;
+}
+
+#define PAR_MIN_SEGMENT	0x10000	/* smallest input segment that gets a thread of its own */
+
+typedef struct _lzss_par_segment
+{
+	LZSS_COMPR* lzss;
+	const uint8_t* inData;	/* whole input - the history before the segment is read from here */
+	size_t start;			/* offset of the segment in inData */
+	size_t len;
+	size_t bufSize;
+	uint8_t* buffer;		/* stream of the segment, starting with a new group of units */
+	size_t encLen;
+	uint8_t ret;
+	uint8_t threaded;		/* 1 = encoded by a thread that has to be joined */
+} LZSS_PAR_SEG;
+
+static size_t PrimeEncoder(LZSS_COMPR* lzss, size_t start, size_t inSize, const uint8_t* inData)
+	/* Prepares the encoder for continuing the stream at inData[start], with start >= N-F.
+	   The N-F bytes of history go to the ring buffer positions that the decoder will
+	   have them at and are registered in the match finder from the oldest to the newest,
+	   just like the encoder would have done when passing them.  Then the lookahead buffer
+	   is filled.  Returns the number of bytes read into the lookahead buffer. */
+{
+	unsigned int maskN = lzss->N - 1;
+	unsigned int histLen = lzss->N - lzss->F;
+	unsigned int r, i, len;
+
+	ResetEncoder(lzss);
+	r = (lzss->enc_r + (unsigned int)(start & maskN)) & maskN;
+	for (i = 1; i <= histLen; i++)
+		lzss->text_buf[(r - i) & maskN] = inData[start - i];
+	for (len = 0; len < lzss->F && start + len < inSize; len++)
+		lzss->text_buf[(r + len) & maskN] = inData[start + len];
+	memcpy(&lzss->text_buf[lzss->N], &lzss->text_buf[0], lzss->F - 1);
+
+	RebuildMatchFinder(lzss, r, histLen);
+	lzss->enc_pos = start;
+	lzss->enc_r = r;
+	lzss->enc_s = (r + lzss->F) & maskN;
+	lzss->enc_len = len;
+	lzss->enc_state = ENCST_RUN;
+	return len;
+}
+
+static THREAD_FUNC EncodeSegment(void* param)
+{
+	LZSS_PAR_SEG* seg = (LZSS_PAR_SEG*)param;
+	size_t end = seg->start + seg->len;
+	size_t pos;
+
+	if (seg->start == 0)
+	{
+		seg->ret = lzssEncode(seg->lzss, seg->bufSize, seg->buffer, &seg->encLen, seg->len, seg->inData);
+		return 0;
+	}
+	pos = seg->start + PrimeEncoder(seg->lzss, seg->start, end, seg->inData);
+	if (seg->lzss->cfg.parser == LZSS_PARSE_OPTIMAL)
+		seg->ret = EncodeOptimal(seg->lzss, seg->bufSize, seg->buffer, &seg->encLen, end - pos, &seg->inData[pos]);
+	else
+		seg->ret = EncodeRun(seg->lzss, seg->bufSize, seg->buffer, &seg->encLen, end - pos, &seg->inData[pos], NULL, 1);
+	return 0;
+}
+
+static uint8_t AppendSegment(LZSS_COMPR* lzss, size_t bufSize, uint8_t* buffer, size_t* outPos,
+	size_t* ctrlPos, unsigned int* outMask, const LZSS_PAR_SEG* seg)
+{
+	/* Copy the units of a segment stream, continuing the current group of units
+	   of the output.  The segment's end-of-stream marker is dropped. */
+	unsigned int ctrlMSB = ((lzss->cfg.flags & LZSS_FLAGS_CTRLMASK) == LZSS_FLAGS_CTRL_M);
+	unsigned int startMask = ctrlMSB ? 0x80 : 0x01;
+	const uint8_t* inData = seg->buffer;
+	size_t inPos = 0;
+	size_t decLen = 0;
+	size_t pos = *outPos;
+	unsigned int mask = *outMask;
+	unsigned int ctrl = 0;
+	unsigned int inMask = 0;
+	uint8_t ret = LZSS_ERR_OK;
+
+	while(decLen < seg->len)
 	{
-		// add null-reference
-		if (code_buf_ptr > 1)
+		if (inMask == 0)
 		{
-			i = 1;		// just write the terminating reference word
+			ctrl = inData[inPos++];
+			inMask = startMask;
 		}
-		else
+		if (mask == 0)
 		{
-			code_buf[0] = 0;	// "reference flag" control byte
-			i = 0;	// write control byte + reference word
+			if (pos >= bufSize)
+			{
+				ret = LZSS_ERR_EOF_OUT;
+				break;
+			}
+			*ctrlPos = pos;
+			buffer[pos++] = 0;
+			mask = startMask;
 		}
-		code_buf[1] = code_buf[2] = 0;	// reference word
-		code_buf_ptr = 3;
-		for (; i < code_buf_ptr; i++)
+		if (ctrl & inMask)
 		{
-			if (outPos >= bufSize)
+			if (pos + 1 > bufSize)
 			{
-				if (bytesWritten != NULL) *bytesWritten = outPos;
-				return LZSS_ERR_EOF_OUT;
+				ret = LZSS_ERR_EOF_OUT;
+				break;
 			}
-			buffer[outPos++] = code_buf[i];
+			buffer[*ctrlPos] |= (uint8_t)mask;
+			buffer[pos++] = inData[inPos++];
+			decLen ++;
+			lzss->stats.literals ++;
 		}
+		else
+		{
+			unsigned int ofs, len;
+			if (pos + 2 > bufSize)
+			{
+				ret = LZSS_ERR_EOF_OUT;
+				break;
+			}
+			GetReference(lzss, inData[inPos], inData[inPos + 1], &ofs, &len);
+			buffer[pos++] = inData[inPos++];
+			buffer[pos++] = inData[inPos++];
+			decLen += len;
+			CountMatch(&lzss->stats, len);
+		}
+		if (ctrlMSB)
+		{
+			mask >>= 1;  inMask >>= 1;
+		}
+		else
+		{
+			mask = (mask << 1) & 0xFF;  inMask = (inMask << 1) & 0xFF;
+		}
+	}
+	*outPos = pos;
+	*outMask = mask;
+	return ret;
+}
+
+uint8_t lzssEncodeParallel(LZSS_COMPR* lzss, size_t bufSize, uint8_t* buffer, size_t* bytesWritten,
+	size_t inSize, const uint8_t* inData, unsigned int threadCount)
+{
+	LZSS_PAR_SEG* segs;
+	LZSS_THREAD* threads;
+	size_t segCount, segLen, outPos, ctrlPos;
+	unsigned int mask;
+	size_t curSeg;
+	uint8_t ret = LZSS_ERR_OK;
+
+	segCount = inSize / PAR_MIN_SEGMENT;
+	if (segCount > threadCount)
+		segCount = threadCount;
+	if (segCount <= 1 || inSize / segCount < lzss->N)
+		return lzssEncode(lzss, bufSize, buffer, bytesWritten, inSize, inData);
+
+	segs = (LZSS_PAR_SEG*)calloc(segCount, sizeof(LZSS_PAR_SEG));
+	threads = (LZSS_THREAD*)calloc(segCount, sizeof(LZSS_THREAD));
+	if (segs == NULL || threads == NULL)
+	{
+		free(segs);  free(threads);
+		return LZSS_ERR_NO_MEM;
+	}
+	segLen = inSize / segCount;
+	for (curSeg = 0; curSeg < segCount; curSeg++)
+	{
+		LZSS_PAR_SEG* seg = &segs[curSeg];
+		seg->inData = inData;
+		seg->start = curSeg * segLen;
+		seg->len = (curSeg + 1 < segCount) ? segLen : (inSize - seg->start);
+		seg->bufSize = lzssEncodeBound(&lzss->cfg, seg->len);
+		seg->buffer = (uint8_t*)malloc(seg->bufSize);
+		// the first segment starts the stream normally and uses the caller's context
+		seg->lzss = (curSeg == 0) ? lzss : lzssCreate(&lzss->cfg);
+		if (seg->buffer == NULL || seg->lzss == NULL)
+			ret = LZSS_ERR_NO_MEM;
+	}
+
+	if (ret == LZSS_ERR_OK)
+	{
+		// segment 0 is encoded by the calling thread, or when a thread can't be started
+		for (curSeg = 1; curSeg < segCount; curSeg++)
+		{
+			segs[curSeg].threaded = ThreadCreate(&threads[curSeg], EncodeSegment, &segs[curSeg]) ? 1 : 0;
+			if (! segs[curSeg].threaded)
+				EncodeSegment(&segs[curSeg]);
+		}
+		EncodeSegment(&segs[0]);
+		for (curSeg = 1; curSeg < segCount; curSeg++)
+		{
+			if (segs[curSeg].threaded)
+				ThreadJoin(threads[curSeg]);
+		}
+	}
+
+	// The segment 0 context counted its own units - count the joined stream instead.
+	ResetStats(lzss);
+	outPos = 0;  ctrlPos = 0;  mask = 0;
+	for (curSeg = 0; curSeg < segCount && ret == LZSS_ERR_OK; curSeg++)
+	{
+		ret = segs[curSeg].ret;
+		if (ret == LZSS_ERR_OK)
+			ret = AppendSegment(lzss, bufSize, buffer, &outPos, &ctrlPos, &mask, &segs[curSeg]);
+	}
+	if (ret == LZSS_ERR_OK && lzss->cfg.eosMode == LZSS_EOSM_REF0)
+	{
+		// add null-reference, using a free bit of the last control byte if there is one
+		if (outPos + ((mask == 0) ? 3 : 2) > bufSize)
+		{
+			ret = LZSS_ERR_EOF_OUT;
+		}
+		else
+		{
+			if (mask == 0)
+				buffer[outPos++] = 0x00;	// "reference flag" control byte
+			buffer[outPos++] = 0x00;
+			buffer[outPos++] = 0x00;
+		}
+	}
+	if (ret == LZSS_ERR_OK)
+	{
+		// Control bytes are completed by the following segment, so the stream is hashed once it is joined.
+		lzss->stats.bytesIn = inSize;
+		lzss->stats.bytesOut = outPos;
+		HashUpdate(lzss, buffer, outPos);
+	}
+
+	for (curSeg = 0; curSeg < segCount; curSeg++)
+	{
+		free(segs[curSeg].buffer);
+		if (curSeg > 0 && segs[curSeg].lzss != NULL)
+			lzssDestroy(segs[curSeg].lzss);
+	}
+	free(segs);  free(threads);
+	if (bytesWritten != NULL) *bytesWritten = outPos;
+	return ret;
+}
+
+LZSS_FORCE_INLINE void SplitReference(unsigned int flags, unsigned int lenBits, uint8_t b0, uint8_t b1,
+	unsigned int* ofs, unsigned int* len)
+{
+	/* split a reference word (in stream order b0, b1) into ring buffer offset and length field */
+	unsigned int lenMask = (1U << lenBits) - 1;
+	unsigned int word;
+
+	if ((flags & LZSS_FLAGS_MTCH_EMASK) == LZSS_FLAGS_MTCH_ELITTLE)
+		word = b0 | (b1 << 8);
+	else //if ((flags & LZSS_FLAGS_MTCH_EMASK) == LZSS_FLAGS_MTCH_EBIG)
+		word = (b0 << 8) | b1;
+	switch(flags & LZSS_FLAGS_MTCH_LMASK)
+	{
+	case LZSS_FLAGS_MTCH_L_HH:
+		*ofs = word & (0xFFFF >> lenBits);
+		*len = word >> (16 - lenBits);
+		break;
+	case LZSS_FLAGS_MTCH_L_HL:
+	default:
+		*ofs = (word & 0xFF) | ((word >> (8 + lenBits)) << 8);
+		*len = (word >> 8) & lenMask;
+		break;
+	case LZSS_FLAGS_MTCH_L_LH:
+		*ofs = (word & (0xFF >> lenBits)) | ((word >> 8) << (8 - lenBits));
+		*len = (word >> (8 - lenBits)) & lenMask;
+		break;
+	case LZSS_FLAGS_MTCH_L_LL:
+		*ofs = word >> lenBits;
+		*len = word & lenMask;
+		break;
+	}
+	return;
+}
+
+static void GetReference(const LZSS_COMPR* lzss, uint8_t b0, uint8_t b1, unsigned int* ofs, unsigned int* len)
+{
+	/* split a reference word (in stream order b0, b1) into ring buffer offset and match length */
+	SplitReference(lzss->cfg.flags, lzss->lenBits, b0, b1, ofs, len);
+	*len += lzss->THRESHOLD + 1;
+	return;
+}
+
+static uint8_t DecodeGeneric(LZSS_COMPR* lzss, size_t bufSize, uint8_t* buffer, size_t* bytesWritten, size_t inSize, const uint8_t* inData)
+{
+	unsigned int maskN = lzss->N - 1;
+	unsigned int r;	// ring buffer position
+	uint8_t flags;
+	unsigned int flag_bits;
+	size_t inPos;
+	size_t outPos;
+
+	InitNametable(lzss);
+
+	if (lzss->cfg.nameTblStartOfs == LZSS_NTSTOFS_NF)
+		r = lzss->N - lzss->F;
+	else
+		r = lzss->cfg.nameTblStartOfs & maskN;
+	flags = 0;
+	flag_bits = 0;
+	inPos = 0;
+	outPos = 0;
+	while(1)
+	{
+		unsigned int lz_flag;
+
+		if (flag_bits == 0)
+		{
+			if (inPos >= inSize)
+				break;	// EOF is valid here
+			flags = inData[inPos++];
+			flag_bits = 8;
+		}
+		if ((lzss->cfg.flags & LZSS_FLAGS_CTRLMASK) == LZSS_FLAGS_CTRL_L)	// check lowest bit / shift right
+		{
+			lz_flag = flags & 1;
+			flags >>= 1;
+			flag_bits--;
+		}
+		else //if ((lzss->cfg.flags & LZSS_FLAGS_CTRLMASK) == LZSS_FLAGS_CTRL_H)	// check highest bit / shift left
+		{
+			lz_flag = flags & 0x80;
+			flags <<= 1;
+			flag_bits--;
+		}
+
+		if (lz_flag) {
+			uint8_t c;
+			if (inPos >= inSize)
+			{
+				if (bytesWritten != NULL) *bytesWritten = outPos;
+				return LZSS_ERR_EOF_IN;
+			}
+			if (outPos >= bufSize)
+			{
+				if (bytesWritten != NULL) *bytesWritten = outPos;
+				return LZSS_ERR_EOF_OUT;
+			}
+			c = inData[inPos++];
+			buffer[outPos++] = c;
+			lzss->text_buf[r++] = c;
+			r &= maskN;
+		} else {
+			unsigned int k, len, ofs;
+
+			if (inPos == inSize)
+				break;	// EOF in this way is valid here
+			if (inPos+1 >= inSize)
+			{
+				if (bytesWritten != NULL) *bytesWritten = outPos;
+				return LZSS_ERR_EOF_IN;
+			}
+			if (lzss->cfg.eosMode == LZSS_EOSM_REF0)
+			{
+				if (inData[inPos+0] == 0 && inData[inPos+1] == 0)
+					break;	// null-reference ends the stream
+			}
+			GetReference(lzss, inData[inPos+0], inData[inPos+1], &ofs, &len);
+			inPos += 2;
+			if (lzss->cfg.nameTblType == LZSS_NTINIT_NONE)
+			{
+				unsigned int ofs_back = (r + lzss->N - ofs) & maskN;
+				if (ofs_back > outPos)	// make sure we don't reference data beyond the start of the file
+				{
+					if (bytesWritten != NULL) *bytesWritten = outPos;
+					return LZSS_ERR_BAD_REF;
+				}
+			}
+
+			for (k = 0; k < len; k++)
+			{
+				unsigned int offset = (ofs + k) & maskN;
+				uint8_t c = lzss->text_buf[offset];
+				if (outPos >= bufSize)
+				{
+					if (bytesWritten != NULL) *bytesWritten = outPos;
+					return LZSS_ERR_EOF_OUT;
+				}
+				buffer[outPos++] = c;
+				lzss->text_buf[r++] = c;
+				r &= maskN;
+			}
+		}
+	}
+
+	if (bytesWritten != NULL) *bytesWritten = outPos;
+	return LZSS_ERR_OK;
+}
+
+/* Decoding kernel "template".  The configuration parameters are compile-time
+   constants in each instance (see DEC_KERNEL below), which lets the compiler
+   remove all configuration checks from the loop. */
+LZSS_FORCE_INLINE void CopyMatch(uint8_t* dst, unsigned int dist, unsigned int len)
+{
+	/* copy len bytes from dist bytes back, with LZ77 semantics for overlapping ranges */
+	const uint8_t* src = dst - dist;
+	if (dist >= len)
+	{
+		memcpy(dst, src, len);
+	}
+	else if (dist == 1)
+	{
+		memset(dst, *src, len);
+	}
+	else
+	{
+		while(len --)
+			*dst++ = *src++;
+	}
+}
+
+LZSS_FORCE_INLINE void RingWrite(uint8_t* text_buf, unsigned int N, unsigned int r, const uint8_t* data, unsigned int len)
+{
+	unsigned int part = N - r;
+	if (len <= part)
+	{
+		memcpy(&text_buf[r], data, len);
+	}
+	else
+	{
+		memcpy(&text_buf[r], data, part);
+		memcpy(text_buf, &data[part], len - part);
+	}
+}
+
+/* Note: The kernels decode against the output buffer whenever the referenced data was
+   already written in this call. The ring buffer is only kept up to date while less than
+   N bytes were decoded - after that, every back-reference is covered by the output.
+   With stats = 1, the kernel counts the units and hashes the output in blocks of HASH_BLOCK bytes. */
+LZSS_FORCE_INLINE uint8_t DecodeKernel(LZSS_COMPR* lzss, size_t bufSize, uint8_t* buffer, size_t* bytesWritten,
+	size_t inSize, const uint8_t* inData, const unsigned int cfgFlags, const int ntNone, const int eosRef0,
+	const int refTable, const int stats)
+{
+	uint8_t* text_buf = lzss->text_buf;
+	unsigned int N = lzss->N;
+	unsigned int maskN = N - 1;
+	unsigned int minLen = lzss->THRESHOLD + 1;
+	unsigned int lenBits = lzss->lenBits;
+	unsigned int r;	// ring buffer position
+	unsigned int flags;
+	unsigned int flag_bits;
+	size_t inPos;
+	size_t outPos;
+	size_t hashPos = 0;	// start of the output that wasn't hashed yet
+	size_t literals = 0;
+	uint8_t ret = LZSS_ERR_OK;
+
+	InitNametable(lzss);
+	if (stats)
+		ResetStats(lzss);
+
+	if (lzss->cfg.nameTblStartOfs == LZSS_NTSTOFS_NF)
+		r = N - lzss->F;
+	else
+		r = lzss->cfg.nameTblStartOfs & maskN;
+	flags = 0;
+	flag_bits = 0;
+	inPos = 0;
+	outPos = 0;
+	while(1)
+	{
+		unsigned int lz_flag;
+
+		if (flag_bits == 0)
+		{
+			if (inPos >= inSize)
+				break;	// EOF is valid here
+			flags = inData[inPos++];
+			flag_bits = 8;
+			if (stats && outPos - hashPos >= HASH_BLOCK)
+			{
+				HashUpdate(lzss, &buffer[hashPos], outPos - hashPos);
+				hashPos = outPos;
+			}
+			if (flags == 0xFF && inSize - inPos >= 8 && bufSize - outPos >= 8)
+			{
+				// fast path: group of 8 literals
+				if (stats)
+					literals += 8;
+				memcpy(&buffer[outPos], &inData[inPos], 8);
+				if (outPos < N)
+					RingWrite(text_buf, N, r, &inData[inPos], 8);
+				inPos += 8;
+				outPos += 8;
+				r = (r + 8) & maskN;
+				flag_bits = 0;
+				continue;
+			}
+		}
+		if ((cfgFlags & LZSS_FLAGS_CTRLMASK) == LZSS_FLAGS_CTRL_L)
+		{
+			lz_flag = flags & 0x01;
+			flags >>= 1;
+		}
+		else
+		{
+			lz_flag = flags & 0x80;
+			flags <<= 1;
+		}
+		flag_bits--;
+
+		if (lz_flag) {
+			uint8_t c;
+			if (inPos >= inSize)
+			{
+				ret = LZSS_ERR_EOF_IN;
+				break;
+			}
+			if (outPos >= bufSize)
+			{
+				ret = LZSS_ERR_EOF_OUT;
+				break;
+			}
+			c = inData[inPos++];
+			if (outPos < N)
+				text_buf[r] = c;
+			buffer[outPos++] = c;
+			r = (r + 1) & maskN;
+			if (stats)
+				literals ++;
+		} else {
+			unsigned int k, len, ofs, dist;
+
+			if (inPos == inSize)
+				break;	// EOF in this way is valid here
+			if (inPos+1 >= inSize)
+			{
+				ret = LZSS_ERR_EOF_IN;
+				break;
+			}
+			if (eosRef0 && inData[inPos+0] == 0 && inData[inPos+1] == 0)
+			{
+				inPos += 2;
+				break;	// null-reference ends the stream
+			}
+			if (refTable)
+			{
+				unsigned int word = lzss->ref_tbl[0][inData[inPos+0]] | lzss->ref_tbl[1][inData[inPos+1]];
+				ofs = word & 0xFFFF;
+				len = word >> 16;
+			}
+			else
+			{
+				SplitReference(cfgFlags, lenBits, inData[inPos+0], inData[inPos+1], &ofs, &len);
+			}
+			len += minLen;
+			inPos += 2;
+			if (ntNone)
+			{
+				unsigned int ofs_back = (r - ofs) & maskN;
+				if (ofs_back > outPos)	// make sure we don't reference data beyond the start of the file
+				{
+					ret = LZSS_ERR_BAD_REF;
+					break;
+				}
+			}
+			if (stats)
+				CountMatch(&lzss->stats, len);
+			if (bufSize - outPos < len)
+			{
+				// copy as much as fits, then fail
+				len = (unsigned int)(bufSize - outPos);
+				ret = LZSS_ERR_EOF_OUT;
+			}
+
+			dist = ((r - ofs - 1) & maskN) + 1;	// 1..N bytes back
+			if (dist <= outPos)
+			{
+				// all source data is in the output buffer
+				CopyMatch(&buffer[outPos], dist, len);
+				if (outPos < N)
+					RingWrite(text_buf, N, r, &buffer[outPos], len);
+			}
+			else
+			{
+				// reference into the name table
+				for (k = 0; k < len; k++)
+				{
+					uint8_t c = text_buf[(ofs + k) & maskN];
+					buffer[outPos + k] = c;
+					text_buf[(r + k) & maskN] = c;
+				}
+			}
+			outPos += len;
+			r = (r + len) & maskN;
+			if (ret != LZSS_ERR_OK)
+				break;
+		}
+	}
+
+	if (stats)
+	{
+		lzss->stats.literals = literals;
+		lzss->stats.bytesIn = inPos;
+		lzss->stats.bytesOut = outPos;
+		HashUpdate(lzss, &buffer[hashPos], outPos - hashPos);
+	}
+	if (bytesWritten != NULL) *bytesWritten = outPos;
+	return ret;
+}
+
+#define DEC_KERNEL(flags, nt, eos) \
+	static uint8_t Decode_##flags##_##nt##eos(LZSS_COMPR* lzss, size_t bufSize, uint8_t* buffer, size_t* bytesWritten, \
+		size_t inSize, const uint8_t* inData) \
+	{	return DecodeKernel(lzss, bufSize, buffer, bytesWritten, inSize, inData, flags, nt, eos, 0, 0);	}
+#define DEC_KERNELS(flags) \
+	DEC_KERNEL(flags, 0, 0)	DEC_KERNEL(flags, 0, 1)	DEC_KERNEL(flags, 1, 0)	DEC_KERNEL(flags, 1, 1)
+#define DEC_KERNEL_LIST(flags) \
+	{Decode_##flags##_00, Decode_##flags##_01, Decode_##flags##_10, Decode_##flags##_11}
+
+DEC_KERNELS(0x00)	DEC_KERNELS(0x01)	DEC_KERNELS(0x10)	DEC_KERNELS(0x11)
+DEC_KERNELS(0x20)	DEC_KERNELS(0x21)	DEC_KERNELS(0x30)	DEC_KERNELS(0x31)
+DEC_KERNELS(0x40)	DEC_KERNELS(0x41)	DEC_KERNELS(0x50)	DEC_KERNELS(0x51)
+DEC_KERNELS(0x60)	DEC_KERNELS(0x61)	DEC_KERNELS(0x70)	DEC_KERNELS(0x71)
+
+// indexed by [DEC_LAYOUT(flags)][nameTblType == NONE][eosMode == REF0]
+static const LZSS_DECODE_FUNC DECODE_KERNELS[0x10][4] =
+{
+	DEC_KERNEL_LIST(0x00),	DEC_KERNEL_LIST(0x01),	DEC_KERNEL_LIST(0x10),	DEC_KERNEL_LIST(0x11),
+	DEC_KERNEL_LIST(0x20),	DEC_KERNEL_LIST(0x21),	DEC_KERNEL_LIST(0x30),	DEC_KERNEL_LIST(0x31),
+	DEC_KERNEL_LIST(0x40),	DEC_KERNEL_LIST(0x41),	DEC_KERNEL_LIST(0x50),	DEC_KERNEL_LIST(0x51),
+	DEC_KERNEL_LIST(0x60),	DEC_KERNEL_LIST(0x61),	DEC_KERNEL_LIST(0x70),	DEC_KERNEL_LIST(0x71),
+};
+
+// table-driven kernels only depend on the control byte bit order - the reference word layout is in ref_tbl
+#define DEC_TKERNEL(ctrl, nt, eos) \
+	static uint8_t DecodeTbl_##ctrl##_##nt##eos(LZSS_COMPR* lzss, size_t bufSize, uint8_t* buffer, size_t* bytesWritten, \
+		size_t inSize, const uint8_t* inData) \
+	{	return DecodeKernel(lzss, bufSize, buffer, bytesWritten, inSize, inData, ctrl, nt, eos, 1, 0);	}
+#define DEC_TKERNELS(ctrl) \
+	DEC_TKERNEL(ctrl, 0, 0)	DEC_TKERNEL(ctrl, 0, 1)	DEC_TKERNEL(ctrl, 1, 0)	DEC_TKERNEL(ctrl, 1, 1)
+#define DEC_TKERNEL_LIST(ctrl) \
+	{DecodeTbl_##ctrl##_00, DecodeTbl_##ctrl##_01, DecodeTbl_##ctrl##_10, DecodeTbl_##ctrl##_11}
+
+DEC_TKERNELS(0x00)	DEC_TKERNELS(0x01)
+
+// indexed by [control byte bit order][nameTblType == NONE][eosMode == REF0]
+static const LZSS_DECODE_FUNC DECODE_TKERNELS[2][4] =
+{
+	DEC_TKERNEL_LIST(0x00),	DEC_TKERNEL_LIST(0x01),
+};
+
+// statistics kernels: table-driven as well, so that they don't multiply the number of layout instances
+#define DEC_SKERNEL(ctrl, nt, eos) \
+	static uint8_t DecodeStat_##ctrl##_##nt##eos(LZSS_COMPR* lzss, size_t bufSize, uint8_t* buffer, size_t* bytesWritten, \
+		size_t inSize, const uint8_t* inData) \
+	{	return DecodeKernel(lzss, bufSize, buffer, bytesWritten, inSize, inData, ctrl, nt, eos, 1, 1);	}
+#define DEC_SKERNELS(ctrl) \
+	DEC_SKERNEL(ctrl, 0, 0)	DEC_SKERNEL(ctrl, 0, 1)	DEC_SKERNEL(ctrl, 1, 0)	DEC_SKERNEL(ctrl, 1, 1)
+#define DEC_SKERNEL_LIST(ctrl) \
+	{DecodeStat_##ctrl##_00, DecodeStat_##ctrl##_01, DecodeStat_##ctrl##_10, DecodeStat_##ctrl##_11}
+
+DEC_SKERNELS(0x00)	DEC_SKERNELS(0x01)
+
+// indexed by [control byte bit order][nameTblType == NONE][eosMode == REF0]
+static const LZSS_DECODE_FUNC DECODE_SKERNELS[2][4] =
+{
+	DEC_SKERNEL_LIST(0x00),	DEC_SKERNEL_LIST(0x01),
+};
+
+static void BuildRefTable(LZSS_COMPR* lzss)
+{
+	/* Each bit of the reference word belongs to either the offset or the length,
+	   so the parts that the two bytes contribute can be combined with OR. */
+	unsigned int b, ofs, len;
+
+	for (b = 0x00; b < 0x100; b++)
+	{
+		SplitReference(lzss->cfg.flags, lzss->lenBits, (uint8_t)b, 0x00, &ofs, &len);
+		lzss->ref_tbl[0][b] = (len << 16) | ofs;
+		SplitReference(lzss->cfg.flags, lzss->lenBits, 0x00, (uint8_t)b, &ofs, &len);
+		lzss->ref_tbl[1][b] = (len << 16) | ofs;
 	}
+	return;
+}
 
-	if (bytesWritten != NULL) *bytesWritten = outPos;
-	return LZSS_ERR_OK;
+static LZSS_DECODE_FUNC SelectDecoder(const LZSS_CFG* cfg)
+{
+	unsigned int layout = ((cfg->flags & (LZSS_FLAGS_MTCH_EMASK | LZSS_FLAGS_MTCH_LMASK)) >> 3) |
+		(cfg->flags & LZSS_FLAGS_CTRLMASK);
+	unsigned int variant = ((cfg->nameTblType == LZSS_NTINIT_NONE) << 1) | (cfg->eosMode == LZSS_EOSM_REF0);
+
+	if (COLLECT_STATS(cfg))
+		return DECODE_SKERNELS[cfg->flags & LZSS_FLAGS_CTRLMASK][variant];
+	if (cfg->decoder == LZSS_DEC_GENERIC)
+		return DecodeGeneric;
+	if (cfg->decoder == LZSS_DEC_TABLE)
+		return DECODE_TKERNELS[cfg->flags & LZSS_FLAGS_CTRLMASK][variant];
+	// The table kernels weren't faster than the specialized ones for any layout (see "lzss-bench dec"),
+	// the shifts and masks of a fixed layout cost about as much as the two table lookups.
+	return DECODE_KERNELS[layout][variant];
 }
 
 uint8_t lzssDecode(LZSS_COMPR* lzss, size_t bufSize, uint8_t* buffer, size_t* bytesWritten, size_t inSize, const uint8_t* inData)
 {
+	return lzss->Decode(lzss, bufSize, buffer, bytesWritten, inSize, inData);
+}
+
+uint8_t lzssDecodedSize(LZSS_COMPR* lzss, size_t inSize, const uint8_t* inData, size_t* decSize)
+{
+	return lzssStreamSize(lzss, inSize, inData, decSize, NULL);
+}
+
+uint8_t lzssStreamSize(LZSS_COMPR* lzss, size_t inSize, const uint8_t* inData, size_t* decSize, size_t* bytesRead)
+{
+	/* walks the units like lzssDecode() with an unlimited buffer, but only reads the length fields */
+	unsigned int cfgFlags = lzss->cfg.flags;
 	unsigned int maskN = lzss->N - 1;
-	unsigned int r;	// ring buffer position
-	uint8_t flags;
+	unsigned int minLen = lzss->THRESHOLD + 1;
+	unsigned int lenBits = lzss->lenBits;
+	unsigned int lenMask = (1U << lenBits) - 1;
+	unsigned int lenShift;
+	unsigned int hiByte;	// stream position of the high byte of the reference word
+	unsigned int ctrlMSB = ((cfgFlags & LZSS_FLAGS_CTRLMASK) == LZSS_FLAGS_CTRL_M);
+	int ntNone = (lzss->cfg.nameTblType == LZSS_NTINIT_NONE);
+	int eosRef0 = (lzss->cfg.eosMode == LZSS_EOSM_REF0);
+	unsigned int rStart;
+	unsigned int flags;
 	unsigned int flag_bits;
 	size_t inPos;
 	size_t outPos;
+	uint8_t ret = LZSS_ERR_OK;
 
-	InitNametable(lzss);
-
+	switch(cfgFlags & LZSS_FLAGS_MTCH_LMASK)
+	{
+	case LZSS_FLAGS_MTCH_L_HH:	lenShift = 16 - lenBits;	break;
+	case LZSS_FLAGS_MTCH_L_HL:
+	default:					lenShift = 8;	break;
+	case LZSS_FLAGS_MTCH_L_LH:	lenShift = 8 - lenBits;	break;
+	case LZSS_FLAGS_MTCH_L_LL:	lenShift = 0;	break;
+	}
+	hiByte = ((cfgFlags & LZSS_FLAGS_MTCH_EMASK) == LZSS_FLAGS_MTCH_ELITTLE) ? 1 : 0;
 	if (lzss->cfg.nameTblStartOfs == LZSS_NTSTOFS_NF)
-		r = lzss->N - lzss->F;
+		rStart = lzss->N - lzss->F;
 	else
-		r = lzss->cfg.nameTblStartOfs & maskN;
+		rStart = lzss->cfg.nameTblStartOfs & maskN;
+
 	flags = 0;
 	flag_bits = 0;
 	inPos = 0;
@@ -363,121 +2306,650 @@ uint8_t lzssDecode(LZSS_COMPR* lzss, size_t bufSize, uint8_t* buffer, size_t* by
 				break;	// EOF is valid here
 			flags = inData[inPos++];
 			flag_bits = 8;
+			if (flags == 0xFF && inSize - inPos >= 8)
+			{
+				// group of 8 literals
+				inPos += 8;
+				outPos += 8;
+				flag_bits = 0;
+				continue;
+			}
 		}
-		if ((lzss->cfg.flags & LZSS_FLAGS_CTRLMASK) == LZSS_FLAGS_CTRL_L)	// check lowest bit / shift right
-		{
-			lz_flag = flags & 1;
-			flags >>= 1;
-			flag_bits--;
-		}
-		else //if ((lzss->cfg.flags & LZSS_FLAGS_CTRLMASK) == LZSS_FLAGS_CTRL_H)	// check highest bit / shift left
+		if (ctrlMSB)
 		{
 			lz_flag = flags & 0x80;
 			flags <<= 1;
-			flag_bits--;
 		}
+		else
+		{
+			lz_flag = flags & 0x01;
+			flags >>= 1;
+		}
+		flag_bits--;
 
 		if (lz_flag) {
-			uint8_t c;
 			if (inPos >= inSize)
 			{
-				if (bytesWritten != NULL) *bytesWritten = outPos;
-				return LZSS_ERR_EOF_IN;
-			}
-			if (outPos >= bufSize)
-			{
-				if (bytesWritten != NULL) *bytesWritten = outPos;
-				return LZSS_ERR_EOF_OUT;
+				ret = LZSS_ERR_EOF_IN;
+				break;
 			}
-			c = inData[inPos++];
-			buffer[outPos++] = c;
-			lzss->text_buf[r++] = c;
-			r &= maskN;
+			inPos ++;
+			outPos ++;
 		} else {
-			uint8_t i, j;
-			unsigned int k, len, ofs;
+			unsigned int word;
 
 			if (inPos == inSize)
 				break;	// EOF in this way is valid here
 			if (inPos+1 >= inSize)
 			{
-				if (bytesWritten != NULL) *bytesWritten = outPos;
-				return LZSS_ERR_EOF_IN;
+				ret = LZSS_ERR_EOF_IN;
+				break;
 			}
-			if ((lzss->cfg.flags & LZSS_FLAGS_MTCH_EMASK) == LZSS_FLAGS_MTCH_ELITTLE)
+			if (eosRef0 && inData[inPos+0] == 0 && inData[inPos+1] == 0)
 			{
-				i = inData[inPos+0];
-				j = inData[inPos+1];
+				inPos += 2;
+				break;	// null-reference ends the stream
 			}
-			else //if ((lzss->cfg.flags & LZSS_FLAGS_MTCH_EMASK) == LZSS_FLAGS_MTCH_EBIG)
+			if (ntNone)
 			{
-				j = inData[inPos+0];
-				i = inData[inPos+1];
+				unsigned int ofs, len, ofs_back;
+				SplitReference(cfgFlags, lenBits, inData[inPos+0], inData[inPos+1], &ofs, &len);
+				ofs_back = ((rStart + (unsigned int)outPos) - ofs) & maskN;
+				if (ofs_back > outPos)	// make sure we don't reference data beyond the start of the file
+				{
+					ret = LZSS_ERR_BAD_REF;
+					break;
+				}
 			}
-			if (lzss->cfg.eosMode == LZSS_EOSM_REF0)
+			word = (inData[inPos + hiByte] << 8) | inData[inPos + (hiByte ^ 1)];
+			inPos += 2;
+			outPos += ((word >> lenShift) & lenMask) + minLen;
+		}
+	}
+
+	if (decSize != NULL) *decSize = outPos;
+	if (bytesRead != NULL) *bytesRead = inPos;
+	return ret;
+}
+
+void lzssDecodeBegin(LZSS_COMPR* lzss)
+{
+	InitNametable(lzss);
+
+	if (lzss->cfg.nameTblStartOfs == LZSS_NTSTOFS_NF)
+		lzss->dec_r = lzss->N - lzss->F;
+	else
+		lzss->dec_r = lzss->cfg.nameTblStartOfs & (lzss->N - 1);
+	lzss->dec_flags = 0;
+	lzss->dec_flag_bits = 0;
+	lzss->dec_copy_pos = 0;
+	lzss->dec_copy_len = 0;
+	lzss->dec_total = 0;
+	lzss->dec_ref_byte = 0;
+	lzss->dec_ref_half = 0;
+	lzss->dec_ended = 0;
+	ResetStats(lzss);
+	return;
+}
+
+uint8_t lzssDecodeChunk(LZSS_COMPR* lzss, size_t bufSize, uint8_t* buffer, size_t* bytesWritten,
+	size_t inSize, const uint8_t* inData, size_t* bytesRead)
+{
+	unsigned int maskN = lzss->N - 1;
+	unsigned int ctrlMSB = ((lzss->cfg.flags & LZSS_FLAGS_CTRLMASK) == LZSS_FLAGS_CTRL_M);
+	unsigned int r = lzss->dec_r;
+	int stats = COLLECT_STATS(&lzss->cfg);
+	size_t inPos = 0;
+	size_t outPos = 0;
+	uint8_t ret = LZSS_ERR_OK;
+
+	while(1)
+	{
+		unsigned int lz_flag;
+
+		if (lzss->dec_copy_len > 0)
+		{
+			// continue a back-reference that didn't fit into the previous output buffer
+			unsigned int ofs = lzss->dec_copy_pos;
+			unsigned int len = lzss->dec_copy_len;
+			while(len > 0 && outPos < bufSize)
 			{
-				if (i == 0 && j == 0)
-					break;	// null-reference ends the stream
+				uint8_t c = lzss->text_buf[ofs];
+				ofs = (ofs + 1) & maskN;
+				buffer[outPos++] = c;
+				lzss->text_buf[r++] = c;
+				r &= maskN;
+				len --;
 			}
-			inPos += 2;
-			switch(lzss->cfg.flags & LZSS_FLAGS_MTCH_LMASK)
+			lzss->dec_copy_pos = ofs;
+			lzss->dec_copy_len = len;
+			if (len > 0)
 			{
-			case LZSS_FLAGS_MTCH_L_HH:
-				ofs = ((j & 0x0f) << 8) | i;
-				len = ((j & 0xf0) >> 4);
+				ret = LZSS_ERR_EOF_OUT;
 				break;
-			case LZSS_FLAGS_MTCH_L_HL:
-			default:
-				ofs = ((j & 0xf0) << 4) | i;
-				len = (j & 0x0f);
-				break;
-			case LZSS_FLAGS_MTCH_L_LH:
-				ofs = (i & 0x0f) | (j << 4);
-				len = ((i & 0xf0) >> 4);
-				break;
-			case LZSS_FLAGS_MTCH_L_LL:
-				ofs = ((i & 0xf0) >> 4) | (j << 4);
-				len = (i & 0x0f);
+			}
+		}
+		if (lzss->dec_ended)
+			break;
+
+		if (lzss->dec_flag_bits == 0)
+		{
+			if (inPos >= inSize)
+				break;	// need more input
+			lzss->dec_flags = inData[inPos++];
+			lzss->dec_flag_bits = 8;
+		}
+		lz_flag = ctrlMSB ? (lzss->dec_flags & 0x80) : (lzss->dec_flags & 0x01);
+
+		if (lz_flag) {
+			uint8_t c;
+			if (inPos >= inSize)
+				break;	// need more input
+			if (outPos >= bufSize)
+			{
+				ret = LZSS_ERR_EOF_OUT;
 				break;
 			}
-			len += lzss->THRESHOLD + 1;
-			if (lzss->cfg.nameTblType == LZSS_NTINIT_NONE)
+			c = inData[inPos++];
+			buffer[outPos++] = c;
+			lzss->text_buf[r++] = c;
+			r &= maskN;
+			if (stats)
+				lzss->stats.literals ++;
+		} else {
+			uint8_t b0, b1;
+			unsigned int len, ofs;
+
+			if (! lzss->dec_ref_half)
 			{
-				unsigned int ofs_back = (r + lzss->N - ofs) & maskN;
-				if (ofs_back > outPos)	// make sure we don't reference data beyond the start of the file
+				if (inPos >= inSize)
+					break;	// need more input
+				lzss->dec_ref_byte = inData[inPos++];
+				lzss->dec_ref_half = 1;
+			}
+			if (inPos >= inSize)
+				break;	// need more input
+			b0 = lzss->dec_ref_byte;
+			b1 = inData[inPos++];
+			lzss->dec_ref_half = 0;
+			if (lzss->cfg.eosMode == LZSS_EOSM_REF0)
+			{
+				if (b0 == 0 && b1 == 0)
 				{
-					if (bytesWritten != NULL) *bytesWritten = outPos;
-					return LZSS_ERR_BAD_REF;
+					lzss->dec_ended = 1;	// null-reference ends the stream
+					lzss->dec_flag_bits = 0;
+					break;
 				}
 			}
-
-			for (k = 0; k < len; k++)
+			GetReference(lzss, b0, b1, &ofs, &len);
+			if (lzss->cfg.nameTblType == LZSS_NTINIT_NONE)
 			{
-				unsigned int offset = (ofs + k) & maskN;
-				uint8_t c = lzss->text_buf[offset];
-				if (outPos >= bufSize)
+				unsigned int ofs_back = (r + lzss->N - ofs) & maskN;
+				if (ofs_back > lzss->dec_total + outPos)	// make sure we don't reference data beyond the start of the file
 				{
-					if (bytesWritten != NULL) *bytesWritten = outPos;
-					return LZSS_ERR_EOF_OUT;
+					ret = LZSS_ERR_BAD_REF;
+					break;
 				}
-				buffer[outPos++] = c;
-				lzss->text_buf[r++] = c;
-				r &= maskN;
 			}
+			lzss->dec_copy_pos = ofs;
+			lzss->dec_copy_len = len;
+			if (stats)
+				CountMatch(&lzss->stats, len);
 		}
+		// the control bit is consumed only after its whole unit was read
+		if (ctrlMSB)
+			lzss->dec_flags <<= 1;
+		else
+			lzss->dec_flags >>= 1;
+		lzss->dec_flag_bits --;
 	}
 
+	lzss->dec_r = r;
+	lzss->dec_total += outPos;
+	if (stats)
+	{
+		lzss->stats.bytesIn += inPos;
+		lzss->stats.bytesOut += outPos;
+		HashUpdate(lzss, buffer, outPos);
+	}
 	if (bytesWritten != NULL) *bytesWritten = outPos;
+	if (bytesRead != NULL) *bytesRead = inPos;
+	return ret;
+}
+
+uint8_t lzssDecodeEnd(LZSS_COMPR* lzss)
+{
+	if (lzss->dec_copy_len > 0)
+		return LZSS_ERR_EOF_OUT;	// there is still decoded data to be fetched
+	if (lzss->dec_ended)
+		return LZSS_ERR_OK;
+	if (lzss->dec_ref_half)
+		return LZSS_ERR_EOF_IN;	// stream ends in the middle of a reference word
+	if (lzss->dec_flag_bits > 0)
+	{
+		unsigned int ctrlMSB = ((lzss->cfg.flags & LZSS_FLAGS_CTRLMASK) == LZSS_FLAGS_CTRL_M);
+		unsigned int lz_flag = ctrlMSB ? (lzss->dec_flags & 0x80) : (lzss->dec_flags & 0x01);
+		if (lz_flag)
+			return LZSS_ERR_EOF_IN;	// a literal byte is missing
+	}
+	return LZSS_ERR_OK;
+}
+
+#define IDX_HDR_SIZE	0x38	/* size of the serialized index header */
+#define IDX_CP_SIZE		0x14	/* size of a serialized checkpoint, without its ring buffer copy */
+#define IDX_VERSION		0x02
+
+typedef struct _lzss_checkpoint
+{
+	size_t inPos;			/* input position of the next unit */
+	size_t outPos;			/* number of bytes decoded before the next unit */
+	unsigned int r;			/* ring buffer position */
+	unsigned int flags;		/* remaining bits of the current control byte */
+	unsigned int flagBits;	/* number of remaining control bits */
+} LZSS_CHKPT;
+
+struct _lzss_index
+{
+	/* configuration the index was built with */
+	uint8_t flags;
+	uint8_t nameTblType;
+	uint8_t eosMode;
+	unsigned int N;
+	unsigned int THRESHOLD;
+
+	size_t interval;		/* number of decoded bytes between checkpoints */
+	size_t inSize;			/* size of the compressed stream */
+	unsigned int inCrc;		/* CRC-32 of the compressed stream, for detecting stale index files */
+	size_t outSize;			/* size of the decoded data */
+	size_t count;			/* number of checkpoints */
+	size_t alloc;			/* number of checkpoints the arrays have space for */
+	LZSS_CHKPT* cps;
+	uint8_t* rings;			/* ring buffer contents, N bytes per checkpoint */
+};
+
+static unsigned int StreamCrc(LZSS_COMPR* lzss, size_t inSize, const uint8_t* inData)
+{
+	if (lzss->cfg.hashType != LZSS_HASH_CRC32)
+		BuildCrcTable(lzss);	// the table is built only for CRC checksums of the output
+	return ~Crc32Update((const unsigned int (*)[0x100])lzss->crc_tbl, 0xFFFFFFFF, inData, inSize);
+}
+
+static int IndexMatchesConfig(const LZSS_INDEX* index, const LZSS_COMPR* lzss)
+{
+	const uint8_t cfgMask = LZSS_FLAGS_CTRLMASK | LZSS_FLAGS_MTCH_EMASK | LZSS_FLAGS_MTCH_LMASK;
+
+	return (index->N == lzss->N && index->THRESHOLD == lzss->THRESHOLD && index->eosMode == lzss->cfg.eosMode &&
+		(index->flags & cfgMask) == (lzss->cfg.flags & cfgMask));
+}
+
+static uint8_t AddCheckpoint(LZSS_INDEX* idx, const LZSS_COMPR* lzss, size_t inPos)
+{
+	LZSS_CHKPT* cp;
+
+	if (idx->count >= idx->alloc)
+	{
+		size_t newAlloc = idx->alloc ? (idx->alloc * 2) : 0x10;
+		LZSS_CHKPT* newCPs = (LZSS_CHKPT*)realloc(idx->cps, newAlloc * sizeof(LZSS_CHKPT));
+		uint8_t* newRings;
+		if (newCPs == NULL)
+			return LZSS_ERR_NO_MEM;
+		idx->cps = newCPs;
+		newRings = (uint8_t*)realloc(idx->rings, newAlloc * idx->N);
+		if (newRings == NULL)
+			return LZSS_ERR_NO_MEM;
+		idx->rings = newRings;
+		idx->alloc = newAlloc;
+	}
+
+	cp = &idx->cps[idx->count];
+	cp->inPos = inPos;
+	cp->outPos = lzss->dec_total;
+	cp->r = lzss->dec_r;
+	cp->flags = lzss->dec_flags & 0xFF;
+	cp->flagBits = lzss->dec_flag_bits;
+	memcpy(&idx->rings[idx->count * idx->N], lzss->text_buf, idx->N);
+	idx->count ++;
+	return LZSS_ERR_OK;
+}
+
+uint8_t lzssIndexBuild(LZSS_COMPR* lzss, size_t interval, size_t bufSize, uint8_t* buffer, size_t* bytesWritten,
+	size_t inSize, const uint8_t* inData, LZSS_INDEX** index)
+{
+	LZSS_INDEX* idx;
+	uint8_t* scratch = NULL;
+	size_t inPos = 0;
+	size_t outPos = 0;
+	size_t nextCP;
+	uint8_t ret;
+
+	*index = NULL;
+	if (bytesWritten != NULL)
+		*bytesWritten = 0;
+	if (interval < lzss->N)
+		interval = lzss->N;	// each checkpoint costs N bytes, so denser ones don't make sense
+	idx = (LZSS_INDEX*)calloc(1, sizeof(LZSS_INDEX));
+	if (idx == NULL)
+		return LZSS_ERR_NO_MEM;
+	idx->flags = lzss->cfg.flags;
+	idx->nameTblType = lzss->cfg.nameTblType;
+	idx->eosMode = lzss->cfg.eosMode;
+	idx->N = lzss->N;
+	idx->THRESHOLD = lzss->THRESHOLD;
+	idx->interval = interval;
+	if (buffer == NULL)
+	{
+		// a slice is at most interval bytes or the rest of one reference
+		scratch = (uint8_t*)malloc(interval + lzss->F);
+		if (scratch == NULL)
+		{
+			free(idx);
+			return LZSS_ERR_NO_MEM;
+		}
+	}
+
+	// Checkpoints can only be taken between two units, so the output is limited to end at the next checkpoint.
+	// When the decoder stops inside a reference, it is given just enough space to finish it,
+	// until it stops in front of a literal.
+	lzssDecodeBegin(lzss);
+	nextCP = interval;
+	while(1)
+	{
+		size_t sliceSize;
+		size_t decLen;
+		size_t readLen;
+		uint8_t* out;
+
+		if (lzss->dec_total < nextCP)
+			sliceSize = nextCP - lzss->dec_total;
+		else
+			sliceSize = lzss->dec_copy_len;
+		if (buffer != NULL)
+		{
+			if (sliceSize > bufSize - outPos)
+				sliceSize = bufSize - outPos;
+			out = &buffer[outPos];
+		}
+		else
+		{
+			out = scratch;
+		}
+		ret = lzssDecodeChunk(lzss, sliceSize, out, &decLen, inSize - inPos, &inData[inPos], &readLen);
+		inPos += readLen;
+		if (buffer != NULL)
+			outPos += decLen;
+		if (ret != LZSS_ERR_EOF_OUT)
+			break;
+		if (buffer != NULL && outPos >= bufSize)
+			break;	// the caller's buffer is full
+		if (lzss->dec_total >= nextCP && lzss->dec_copy_len == 0)
+		{
+			ret = AddCheckpoint(idx, lzss, inPos);
+			if (ret != LZSS_ERR_OK)
+				break;
+			nextCP = lzss->dec_total + interval;
+		}
+	}
+	if (ret == LZSS_ERR_OK)
+		ret = lzssDecodeEnd(lzss);
+	free(scratch);
+
+	if (bytesWritten != NULL)
+		*bytesWritten = outPos;
+	if (ret != LZSS_ERR_OK)
+	{
+		lzssIndexFree(idx);
+		return ret;
+	}
+	idx->inSize = inSize;
+	idx->inCrc = StreamCrc(lzss, inSize, inData);
+	idx->outSize = lzss->dec_total;
+	*index = idx;
+	return LZSS_ERR_OK;
+}
+
+uint8_t lzssDecodeRange(LZSS_COMPR* lzss, const LZSS_INDEX* index, size_t ofs, size_t len, uint8_t* buffer,
+	size_t* bytesWritten, size_t inSize, const uint8_t* inData)
+{
+	const LZSS_CHKPT* cp = NULL;
+	size_t inPos = 0;
+	size_t skipLen;
+	size_t decLen;
+	size_t readLen;
+	uint8_t ret;
+
+	if (bytesWritten != NULL)
+		*bytesWritten = 0;
+	if (! IndexMatchesConfig(index, lzss) || index->inSize != inSize)
+		return LZSS_ERR_BAD_CFG;
+	if (len == 0)
+		return LZSS_ERR_OK;
+
+	// find the last checkpoint at or before ofs
+	if (index->count > 0 && index->cps[0].outPos <= ofs)
+	{
+		size_t lo = 0;
+		size_t hi = index->count;
+		while(hi - lo > 1)
+		{
+			size_t mid = (lo + hi) / 2;
+			if (index->cps[mid].outPos <= ofs)
+				lo = mid;
+			else
+				hi = mid;
+		}
+		cp = &index->cps[lo];
+	}
+
+	lzssDecodeBegin(lzss);
+	if (cp != NULL)
+	{
+		if (cp->inPos > inSize)
+			return LZSS_ERR_EOF_IN;
+		memcpy(lzss->text_buf, &index->rings[(cp - index->cps) * index->N], index->N);
+		lzss->dec_r = cp->r;
+		lzss->dec_flags = cp->flags;
+		lzss->dec_flag_bits = cp->flagBits;
+		lzss->dec_total = cp->outPos;
+		inPos = cp->inPos;
+	}
+
+	// decode the data between the checkpoint and ofs into the output buffer and drop it
+	skipLen = ofs - lzss->dec_total;
+	while(skipLen > 0)
+	{
+		ret = lzssDecodeChunk(lzss, (skipLen < len) ? skipLen : len, buffer, &decLen,
+							inSize - inPos, &inData[inPos], &readLen);
+		inPos += readLen;
+		skipLen -= decLen;
+		if (ret != LZSS_ERR_EOF_OUT)
+		{
+			if (ret == LZSS_ERR_OK && skipLen > 0)
+				return lzssDecodeEnd(lzss);	// the stream ends before ofs
+			if (ret != LZSS_ERR_OK)
+				return ret;
+		}
+	}
+
+	ret = lzssDecodeChunk(lzss, len, buffer, &decLen, inSize - inPos, &inData[inPos], &readLen);
+	if (bytesWritten != NULL)
+		*bytesWritten = decLen;
+	if (ret == LZSS_ERR_EOF_OUT)
+		return LZSS_ERR_OK;	// got the whole range
+	if (ret == LZSS_ERR_OK)
+		ret = lzssDecodeEnd(lzss);
+	return ret;
+}
+
+static void PutLE(uint8_t* dst, unsigned int bytes, size_t val)
+{
+	unsigned int curByte;
+
+	for (curByte = 0; curByte < bytes; curByte ++, val >>= 8)
+		dst[curByte] = (uint8_t)(val & 0xFF);
+}
+
+static size_t GetLE(const uint8_t* src, unsigned int bytes)
+{
+	size_t val = 0;
+
+	while(bytes > 0)
+	{
+		bytes --;
+		val = (val << 8) | src[bytes];	// upper bytes are lost with a 32-bit size_t
+	}
+	return val;
+}
+
+uint8_t lzssIndexCheck(LZSS_COMPR* lzss, const LZSS_INDEX* index, size_t inSize, const uint8_t* inData)
+{
+	if (! IndexMatchesConfig(index, lzss) || index->inSize != inSize)
+		return LZSS_ERR_BAD_CFG;
+	if (index->inCrc != StreamCrc(lzss, inSize, inData))
+		return LZSS_ERR_BAD_CFG;
+	return LZSS_ERR_OK;
+}
+
+size_t lzssIndexGetSize(const LZSS_INDEX* index)
+{
+	return IDX_HDR_SIZE + index->count * (IDX_CP_SIZE + index->N);
+}
+
+size_t lzssIndexGetDecodedSize(const LZSS_INDEX* index)
+{
+	return index->outSize;
+}
+
+uint8_t lzssIndexWrite(const LZSS_INDEX* index, size_t bufSize, uint8_t* buffer)
+{
+	size_t curCP;
+	uint8_t* dst;
+
+	if (bufSize < lzssIndexGetSize(index))
+		return LZSS_ERR_EOF_OUT;
+
+	// header: "LZSI", version, flags, name table type, EOS mode,
+	//	N (32 bit), THRESHOLD (32 bit), interval, input size, output size, checkpoint count (64 bit each),
+	//	CRC-32 of the input (32 bit), 4 reserved bytes
+	memcpy(&buffer[0x00], "LZSI", 4);
+	buffer[0x04] = IDX_VERSION;
+	buffer[0x05] = index->flags;
+	buffer[0x06] = index->nameTblType;
+	buffer[0x07] = index->eosMode;
+	PutLE(&buffer[0x08], 4, index->N);
+	PutLE(&buffer[0x0C], 4, index->THRESHOLD);
+	PutLE(&buffer[0x10], 8, index->interval);
+	PutLE(&buffer[0x18], 8, index->inSize);
+	PutLE(&buffer[0x20], 8, index->outSize);
+	PutLE(&buffer[0x28], 8, index->count);
+	PutLE(&buffer[0x30], 4, index->inCrc);
+	PutLE(&buffer[0x34], 4, 0);
+
+	// checkpoints: input position, output position (64 bit each), r (16 bit), control byte, control bits, ring buffer
+	dst = &buffer[IDX_HDR_SIZE];
+	for (curCP = 0; curCP < index->count; curCP ++)
+	{
+		const LZSS_CHKPT* cp = &index->cps[curCP];
+		PutLE(&dst[0x00], 8, cp->inPos);
+		PutLE(&dst[0x08], 8, cp->outPos);
+		PutLE(&dst[0x10], 2, cp->r);
+		dst[0x12] = (uint8_t)cp->flags;
+		dst[0x13] = (uint8_t)cp->flagBits;
+		memcpy(&dst[IDX_CP_SIZE], &index->rings[curCP * index->N], index->N);
+		dst += IDX_CP_SIZE + index->N;
+	}
+	return LZSS_ERR_OK;
+}
+
+uint8_t lzssIndexRead(size_t inSize, const uint8_t* inData, LZSS_INDEX** index)
+{
+	LZSS_INDEX* idx;
+	const uint8_t* src;
+	size_t curCP;
+
+	*index = NULL;
+	if (inSize < IDX_HDR_SIZE)
+		return LZSS_ERR_EOF_IN;
+	if (memcmp(&inData[0x00], "LZSI", 4) || inData[0x04] != IDX_VERSION)
+		return LZSS_ERR_BAD_CFG;
+
+	idx = (LZSS_INDEX*)calloc(1, sizeof(LZSS_INDEX));
+	if (idx == NULL)
+		return LZSS_ERR_NO_MEM;
+	idx->flags = inData[0x05];
+	idx->nameTblType = inData[0x06];
+	idx->eosMode = inData[0x07];
+	idx->N = (unsigned int)GetLE(&inData[0x08], 4);
+	idx->THRESHOLD = (unsigned int)GetLE(&inData[0x0C], 4);
+	idx->interval = GetLE(&inData[0x10], 8);
+	idx->inSize = GetLE(&inData[0x18], 8);
+	idx->outSize = GetLE(&inData[0x20], 8);
+	idx->count = GetLE(&inData[0x28], 8);
+	idx->inCrc = (unsigned int)GetLE(&inData[0x30], 4);
+	if (idx->N < 0x100 || idx->N > 0x8000 || (idx->N & (idx->N - 1)))
+	{
+		free(idx);
+		return LZSS_ERR_BAD_CFG;
+	}
+	if (idx->count > (inSize - IDX_HDR_SIZE) / (IDX_CP_SIZE + idx->N))
+	{
+		free(idx);
+		return LZSS_ERR_EOF_IN;
+	}
+
+	idx->alloc = idx->count;
+	if (idx->count > 0)
+	{
+		idx->cps = (LZSS_CHKPT*)malloc(idx->count * sizeof(LZSS_CHKPT));
+		idx->rings = (uint8_t*)malloc(idx->count * idx->N);
+		if (idx->cps == NULL || idx->rings == NULL)
+		{
+			lzssIndexFree(idx);
+			return LZSS_ERR_NO_MEM;
+		}
+	}
+	src = &inData[IDX_HDR_SIZE];
+	for (curCP = 0; curCP < idx->count; curCP ++)
+	{
+		LZSS_CHKPT* cp = &idx->cps[curCP];
+		cp->inPos = GetLE(&src[0x00], 8);
+		cp->outPos = GetLE(&src[0x08], 8);
+		cp->r = (unsigned int)GetLE(&src[0x10], 2);
+		cp->flags = src[0x12];
+		cp->flagBits = src[0x13];
+		memcpy(&idx->rings[curCP * idx->N], &src[IDX_CP_SIZE], idx->N);
+		src += IDX_CP_SIZE + idx->N;
+		// lzssDecodeRange() relies on ascending output positions for the binary search
+		if (cp->r >= idx->N || cp->flagBits > 8 || (curCP > 0 && cp->outPos < cp[-1].outPos))
+		{
+			lzssIndexFree(idx);
+			return LZSS_ERR_BAD_CFG;
+		}
+	}
+	*index = idx;
 	return LZSS_ERR_OK;
 }
 
+void lzssIndexFree(LZSS_INDEX* index)
+{
+	free(index->cps);
+	free(index->rings);
+	free(index);
+	return;
+}
+
 void lzssNameTbl_CommonPatterns(LZSS_COMPR* lzss, void* user, size_t nameTblSize, uint8_t* nameTblData)
 {
 	// Important Note: These are non-standard values and ARE used by the compressed data.
+	uint8_t tempBuf[0x1000];
+	uint8_t* tblData;
 	unsigned int bufPos;
 	unsigned int regD0;
 	unsigned int regD1;
 
+	// The pattern is defined for 4 KB name tables. Smaller ones get its beginning,
+	// larger ones are padded with spaces.
+	tblData = (nameTblSize >= 0x1000) ? nameTblData : tempBuf;
+
 	// LZSS table initialization, originally from Arcus Odyssey X68000, M_DRV.X
 	// verified using TSTAR.EXE
 	bufPos = 0x0000;
@@ -485,25 +2957,29 @@ void lzssNameTbl_CommonPatterns(LZSS_COMPR* lzss, void* user, size_t nameTblSize
 	for (regD0 = 0x00; regD0 < 0x100; regD0 ++)
 	{
 		for (regD1 = 0x00; regD1 < 0x0D; regD1 ++, bufPos ++)
-			nameTblData[bufPos] = (uint8_t)regD0;
+			tblData[bufPos] = (uint8_t)regD0;
 	}
 	// AD00..ADFF (00 .. FF)
 	for (regD0 = 0x00; regD0 < 0x100; regD0 ++, bufPos ++)
-		nameTblData[bufPos] = (uint8_t)regD0;
+		tblData[bufPos] = (uint8_t)regD0;
 	// AE00..AEFF (FF .. 00)
 	do
 	{
 		regD0 --;
-		nameTblData[bufPos] = (uint8_t)regD0;
+		tblData[bufPos] = (uint8_t)regD0;
 		bufPos ++;
 	} while(regD0 > 0x00);
 	// AF00..AF7F (0x80 times 00)
 	for (regD0 = 0x00; regD0 < 0x80; regD0 ++, bufPos ++)
-		nameTblData[bufPos] = 0x00;
+		tblData[bufPos] = 0x00;
 	// AF80..AFED (0x6E times 20/space)
 	//for (regD0 = 0x00; regD0 < 0x80 - lzss->F; regD0 ++, bufPos ++)
 	for (regD0 = 0x00; regD0 < 0x80; regD0 ++, bufPos ++)	// let's just be safe and fill everything
-		nameTblData[bufPos] = ' ';
+		tblData[bufPos] = ' ';
 
+	if (nameTblSize < 0x1000)
+		memcpy(nameTblData, tempBuf, nameTblSize);
+	else
+		memset(&nameTblData[0x1000], ' ', nameTblSize - 0x1000);
 	return;
 }
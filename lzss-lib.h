@@ -14,6 +14,9 @@ typedef unsigned char	uint8_t;
 
 typedef struct _lzss_config LZSS_CFG;
 typedef struct _lzss_compressor LZSS_COMPR;
+typedef struct _lzss_pool LZSS_POOL;
+typedef struct _lzss_index LZSS_INDEX;
+typedef struct _lzss_stats LZSS_STATS;
 
 typedef void (*LZSS_NAMETBL_FUNC)(LZSS_COMPR* lzss, void* user, size_t nameTblSize, uint8_t* nameTblData);
 
@@ -26,6 +29,29 @@ struct _lzss_config
 	void* ntFuncParam;		// user parameter for nameTblFunc
 	int nameTblStartOfs;	// offset where the name table buffer starts getting written to
 	uint8_t eosMode;		// see LZSS_EOSM_*
+	uint8_t matchFinder;	// see LZSS_MF_* (encoder only)
+	uint8_t decoder;		// see LZSS_DEC_* (decoder only)
+	unsigned int N;			// ring buffer size, power of 2 in range 0x100..0x8000 (default: 0x1000)
+	unsigned int F;			// maximum match length, up to 2^(16-log2(N)) + THRESHOLD and N/2 (default: 18)
+	unsigned int THRESHOLD;	// shortest encoded match is THRESHOLD+1 bytes (default: 2)
+	uint8_t level;			// compression level, 1 (fastest) .. 9 (best), 0 = unlimited search like LZSS.C (encoder only)
+	uint8_t parser;			// see LZSS_PARSE_* (encoder only)
+	uint8_t storeMode;		// see LZSS_STORE_* (encoder only)
+	uint8_t stats;			// see LZSS_STATS_*
+	uint8_t hashType;		// checksum of the output, see LZSS_HASH_*
+};
+
+#define LZSS_STATS_LENS	0x100	// size of the match length histogram
+struct _lzss_stats
+{
+	size_t bytesIn;			// bytes consumed
+	size_t bytesOut;		// bytes produced
+	size_t literals;		// number of literal units
+	size_t matches;			// number of reference units (excluding the end-of-stream marker)
+	size_t matchLen[LZSS_STATS_LENS];	// number of references per match length, the last entry includes all longer ones
+	uint8_t hashType;		// see LZSS_HASH_*
+	uint8_t hashSize;		// number of valid bytes in hash: 0, 4 (CRC32) or 8 (xxHash64)
+	uint8_t hash[8];		// checksum of the output, most significant byte first
 };
 
 // control word flags
@@ -43,6 +69,12 @@ struct _lzss_config
 //		L_HL	B, ACD -> len = (i & 0x0F)   , ofs = ((i & 0xF0)<<4 | j)
 //		L_LH	C, ABD -> len = (j & 0xF0)>>4, ofs = ((j & 0x0F)    | i<<4)
 //		L_LL	D, ABC -> len = (j & 0x0F)   , ofs = ((j & 0xF0)>>4 | i<<4)
+//	With other ring buffer sizes, the offset has log2(N) bits and the length field
+//	has the remaining 16-log2(N) bits ("nibble" = length field):
+//		L_HH	length in the highest bits
+//		L_HL	length in the bits directly above the low byte
+//		L_LH	length in the bits directly below the high byte
+//		L_LL	length in the lowest bits
 #define LZSS_FLAGS_MTCH_ELITTLE	0x00	// Little Endian
 #define LZSS_FLAGS_MTCH_EBIG	0x40	// Big Endian
 #define LZSS_FLAGS_MTCH_EMASK	0x40	// Endianess mask
@@ -61,19 +93,138 @@ struct _lzss_config
 #define LZSS_NTINIT_NONE	0x02	// don't initialize name table and don't use initial values
 
 // name table start offset, special values
-#define LZSS_NTSTOFS_NF		-1	// start at (N-F), i.e. 0xFEE
+#define LZSS_NTSTOFS_NF		-1	// start at (N-F), i.e. 0xFEE for the default geometry
 
 // end-of-stream mode
 #define LZSS_EOSM_NONE		0x00
 #define LZSS_EOSM_REF0		0x01	// end with a "null-reference" (offset 0, length 0)
 
+// match finder engine (encoder only)
+#define LZSS_MF_TREE		0x00	// binary search trees, as in Okumura's LZSS.C
+#define LZSS_MF_HASH		0x01	// hash chains over the first THRESHOLD+1 bytes, with bounded search depth
+
+// parsing strategy (encoder only)
+#define LZSS_PARSE_GREEDY	0x00	// take the longest match at each position (lazy matching depends on the level) [default]
+#define LZSS_PARSE_OPTIMAL	0x01	// smallest output for the found matches, for lzssEncode()/lzssEncodeParallel() only
+									// (the incremental encoder always parses greedily)
+
+// handling of incompressible data (encoder only, greedy parser)
+#define LZSS_STORE_OFF		0x00	// always search for matches [default]
+#define LZSS_STORE_AUTO		0x01	// send data as literals without searching while it doesn't compress
+									// (checked every 64 KB by the byte distribution and a 4 KB trial encoding)
+
+// decoder implementation for lzssDecode()
+#define LZSS_DEC_AUTO		0x00	// kernel specialized for the configuration [default]
+#define LZSS_DEC_GENERIC	0x01	// generic decoder that checks the configuration for each unit (for reference/benchmarking)
+#define LZSS_DEC_TABLE		0x02	// kernel that splits reference words using two 256-entry lookup tables (for benchmarking)
+
+// statistics collection (see lzssGetStats)
+#define LZSS_STATS_OFF		0x00	// [default]
+#define LZSS_STATS_ON		0x01	// count the units the decoder reads (the encoder always counts them)
+
+// checksum of the output (see lzssGetStats), computed while the data is produced
+#define LZSS_HASH_NONE		0x00	// [default]
+#define LZSS_HASH_CRC32		0x01	// CRC-32 as used by zlib/PKZIP
+#define LZSS_HASH_XXH64		0x02	// xxHash64 with seed 0
+
 
+// lzssCreate() returns NULL when the configuration is invalid (see lzssCheckConfig) or on memory allocation failure.
 LZSS_COMPR* lzssCreate(const LZSS_CFG* config);
 void lzssDestroy(LZSS_COMPR* lzss);
+// context reuse
+//	lzssReset() switches a context to another configuration and reuses its memory when it is large enough.
+//		Returns LZSS_ERR_BAD_CFG or LZSS_ERR_NO_MEM on failure, the context stays usable then.
+//		Each lzssEncode()/lzssDecode() call starts a new stream, so contexts can be reused without resetting them.
+//		With LZSS_NTINIT_FUNC, the context keeps a snapshot of the name table (and of the match finder seeded with it),
+//		so nameTblFunc is called only once. Call lzssReset() with config = NULL when it would return a different table.
+//	lzssCreateInArena() places the context and all its buffers in a caller-provided block of
+//		lzssGetContextSize() bytes (aligned like malloc() memory). lzssDestroy() won't free it.
+size_t lzssGetContextSize(const LZSS_CFG* config);
+LZSS_COMPR* lzssCreateInArena(const LZSS_CFG* config, void* arena, size_t arenaSize);
+uint8_t lzssReset(LZSS_COMPR* lzss, const LZSS_CFG* config);
+// thread-safe context pool
+//	lzssPoolAcquire() returns an idle context in the pool's configuration or creates a new one.
+//	lzssPoolRelease() returns a context to the pool. Up to maxIdle contexts are kept, further ones are destroyed.
+LZSS_POOL* lzssPoolCreate(const LZSS_CFG* config, unsigned int maxIdle);
+void lzssPoolDestroy(LZSS_POOL* pool);
+LZSS_COMPR* lzssPoolAcquire(LZSS_POOL* pool);
+void lzssPoolRelease(LZSS_POOL* pool, LZSS_COMPR* lzss);
 void lzssGetDefaultConfig(LZSS_CFG* config);
+uint8_t lzssCheckConfig(const LZSS_CFG* config);	// returns LZSS_ERR_OK or LZSS_ERR_BAD_CFG
 const LZSS_CFG* lzssGetConfiguration(const LZSS_COMPR* lzss);
 uint8_t lzssEncode(LZSS_COMPR* lzss, size_t bufSize, uint8_t* buffer, size_t* bytesWritten, size_t inSize, const uint8_t* inData);
 uint8_t lzssDecode(LZSS_COMPR* lzss, size_t bufSize, uint8_t* buffer, size_t* bytesWritten, size_t inSize, const uint8_t* inData);
+// size queries
+//	lzssEncodeBound() returns the largest possible size of the compressed data (including EOS marker).
+//	lzssDecodedSize() returns the number of bytes lzssDecode() would write with an unlimited output buffer
+//		via decSize, without decoding the data. The return value is the error code lzssDecode() would return.
+//	lzssStreamSize() is the same, but also returns the number of input bytes the stream uses (including the
+//		end-of-stream marker) via bytesRead, e.g. for finding the end of a stream that is followed by other data.
+size_t lzssEncodeBound(const LZSS_CFG* config, size_t inSize);
+uint8_t lzssDecodedSize(LZSS_COMPR* lzss, size_t inSize, const uint8_t* inData, size_t* decSize);
+uint8_t lzssStreamSize(LZSS_COMPR* lzss, size_t inSize, const uint8_t* inData, size_t* decSize, size_t* bytesRead);
+// parallel encoding
+//	lzssEncodeParallel() produces a regular stream like lzssEncode(), but splits the input into up to threadCount
+//		segments (of at least 64 KB) that are encoded by separate threads. Each segment's match finder is primed
+//		with the N-F bytes before it, so only matches that would extend over the end of a segment are lost.
+//		The segment streams are joined without breaking the groups of 8 units.
+//		It needs temporary memory of about lzssEncodeBound(inSize) plus one context per additional thread.
+uint8_t lzssEncodeParallel(LZSS_COMPR* lzss, size_t bufSize, uint8_t* buffer, size_t* bytesWritten,
+	size_t inSize, const uint8_t* inData, unsigned int threadCount);
+// incremental encoding
+//	lzssEncodeBegin() resets the encoder state.
+//	lzssEncodeChunk() takes input of any size and outputs each group of 8 units (control byte + data)
+//		as soon as it is complete.
+//		Returns LZSS_ERR_OK after consuming the whole input and LZSS_ERR_EOF_OUT when the output buffer is full.
+//		In the latter case, call it again with the input that was not consumed yet (see bytesRead).
+//	lzssEncodeEnd() encodes the remaining buffered data and writes the end-of-stream marker.
+//		Returns LZSS_ERR_EOF_OUT when the output buffer is full, in which case it has to be called again.
+void lzssEncodeBegin(LZSS_COMPR* lzss);
+uint8_t lzssEncodeChunk(LZSS_COMPR* lzss, size_t bufSize, uint8_t* buffer, size_t* bytesWritten,
+	size_t inSize, const uint8_t* inData, size_t* bytesRead);
+uint8_t lzssEncodeEnd(LZSS_COMPR* lzss, size_t bufSize, uint8_t* buffer, size_t* bytesWritten);
+// incremental decoding
+//	lzssDecodeBegin() resets the decoder state.
+//	lzssDecodeChunk() decodes as much of the input slice as fits into the output slice
+//		and can be called with any input/output slice sizes.
+//		Returns LZSS_ERR_OK after consuming the whole input slice (or reaching the end-of-stream marker)
+//		and LZSS_ERR_EOF_OUT when the output slice is full. In the latter case, call it again
+//		with the input that was not consumed yet (see bytesRead).
+//	lzssDecodeEnd() checks that the stream ended at a valid position.
+void lzssDecodeBegin(LZSS_COMPR* lzss);
+uint8_t lzssDecodeChunk(LZSS_COMPR* lzss, size_t bufSize, uint8_t* buffer, size_t* bytesWritten,
+	size_t inSize, const uint8_t* inData, size_t* bytesRead);
+uint8_t lzssDecodeEnd(LZSS_COMPR* lzss);
+// seekable decoding
+//	lzssIndexBuild() decodes the whole stream like lzssDecode() and records a checkpoint (input position,
+//		output position, decoder state and a copy of the N-byte ring buffer) about every interval decoded bytes.
+//		buffer may be NULL when only the index is needed. interval is raised to at least N.
+//		The index is returned via index and has to be freed with lzssIndexFree().
+//	lzssDecodeRange() decodes len bytes starting at decoded offset ofs, beginning at the nearest checkpoint
+//		before ofs, so its cost depends on the range length and interval, but not on ofs.
+//		inSize/inData is the whole compressed stream. Returns LZSS_ERR_BAD_CFG when the index was built
+//		with a different configuration or for a stream of another size. bytesWritten is less than len when the stream ends early.
+//	lzssIndexCheck() verifies that the index belongs to the stream (configuration, size and CRC-32 of the compressed data).
+//		Returns LZSS_ERR_OK or LZSS_ERR_BAD_CFG. Use it once after loading an index file.
+//	lzssIndexGetSize()/lzssIndexWrite() serialize the index (e.g. for a sidecar file), lzssIndexRead() loads it.
+//		lzssIndexRead() returns LZSS_ERR_EOF_IN for truncated and LZSS_ERR_BAD_CFG for invalid data.
+uint8_t lzssIndexBuild(LZSS_COMPR* lzss, size_t interval, size_t bufSize, uint8_t* buffer, size_t* bytesWritten,
+	size_t inSize, const uint8_t* inData, LZSS_INDEX** index);
+uint8_t lzssDecodeRange(LZSS_COMPR* lzss, const LZSS_INDEX* index, size_t ofs, size_t len, uint8_t* buffer,
+	size_t* bytesWritten, size_t inSize, const uint8_t* inData);
+uint8_t lzssIndexCheck(LZSS_COMPR* lzss, const LZSS_INDEX* index, size_t inSize, const uint8_t* inData);
+size_t lzssIndexGetSize(const LZSS_INDEX* index);
+size_t lzssIndexGetDecodedSize(const LZSS_INDEX* index);
+uint8_t lzssIndexWrite(const LZSS_INDEX* index, size_t bufSize, uint8_t* buffer);
+uint8_t lzssIndexRead(size_t inSize, const uint8_t* inData, LZSS_INDEX** index);
+void lzssIndexFree(LZSS_INDEX* index);
+// statistics
+//	lzssGetStats() returns the unit counts, byte counts and checksum of the current stream, i.e. since the last
+//		lzssEncode(), lzssEncodeParallel(), lzssEncodeBegin(), lzssDecode() or lzssDecodeBegin() call.
+//		For lzssDecodeRange(), they include the data between the checkpoint and the range.
+//		With stats or hashType enabled, lzssDecode() uses a table-driven kernel that collects them,
+//		regardless of the decoder setting. The checksum is updated in blocks of 16 KB that were just written.
+void lzssGetStats(const LZSS_COMPR* lzss, LZSS_STATS* stats);
 void lzssNameTbl_CommonPatterns(LZSS_COMPR* lzss, void* user, size_t nameTblSize, uint8_t* nameTblData);
 
 
@@ -82,6 +233,8 @@ void lzssNameTbl_CommonPatterns(LZSS_COMPR* lzss, void* user, size_t nameTblSize
 #define LZSS_ERR_EOF_IN		0x01	// reached early end-of-file while reading input buffer
 #define LZSS_ERR_EOF_OUT	0x02	// eached end of output buffer before finishing writing
 #define LZSS_ERR_BAD_REF	0x03	// invalid backwards reference beyond start of while uninitialized name table is used
+#define LZSS_ERR_BAD_CFG	0x04	// unsupported combination of N, F and THRESHOLD
+#define LZSS_ERR_NO_MEM		0x05	// memory allocation failed or arena too small
 
 
 #endif // LZSSLIB_H
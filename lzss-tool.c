@@ -5,7 +5,38 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <time.h>
 #include "lzss-lib.h"
+#include "file-map.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>		// for _setmode()
+#include <fcntl.h>
+typedef CRITICAL_SECTION LZSS_MUTEX;
+#define MutexInit(m)	InitializeCriticalSection(m)
+#define MutexDeinit(m)	DeleteCriticalSection(m)
+#define MutexLock(m)	EnterCriticalSection(m)
+#define MutexUnlock(m)	LeaveCriticalSection(m)
+typedef HANDLE LZSS_THREAD;
+#define THREAD_FUNC			DWORD WINAPI
+#define ThreadCreate(t, f, arg)	((*(t) = CreateThread(NULL, 0, f, arg, 0, NULL)) != NULL)
+#define ThreadJoin(t)		(WaitForSingleObject(t, INFINITE), CloseHandle(t))
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <pthread.h>
+typedef pthread_mutex_t LZSS_MUTEX;
+#define MutexInit(m)	pthread_mutex_init(m, NULL)
+#define MutexDeinit(m)	pthread_mutex_destroy(m)
+#define MutexLock(m)	pthread_mutex_lock(m)
+#define MutexUnlock(m)	pthread_mutex_unlock(m)
+typedef pthread_t LZSS_THREAD;
+#define THREAD_FUNC			void*
+#define ThreadCreate(t, f, arg)	(pthread_create(t, NULL, f, arg) == 0)
+#define ThreadJoin(t)		pthread_join(t, NULL)
+#endif
 
 #ifdef _MSC_VER
 #define strdup		_strdup
@@ -25,262 +56,1988 @@ typedef struct archive_header_value
 		uint8_t dataVal;
 		struct
 		{
-			uint8_t bytes;		// value size (number of bytes)
-			uint8_t endianess;	// see ENDIAN_* constants
-			uint8_t set_val;	// set to 1 for the item that sets values
-		} size;
-	} d;
-} ARC_HDR_VAL;
-#define ENDIAN_LITTLE	0
-#define ENDIAN_BIG		1
-typedef struct archive_header_specification
+			uint8_t bytes;		// value size (number of bytes)
+			uint8_t endianess;	// see ENDIAN_* constants
+			uint8_t set_val;	// set to 1 for the item that sets values
+		} size;
+	} d;
+} ARC_HDR_VAL;
+#define ENDIAN_LITTLE	0
+#define ENDIAN_BIG		1
+typedef struct archive_header_specification
+{
+	size_t len;
+	size_t count;
+	ARC_HDR_VAL vals[0x10];
+} ARC_HDR_SPEC;
+
+typedef struct file_data
+{
+	size_t len;
+	uint8_t* data;
+} FILE_DATA;
+
+typedef struct batch_job
+{
+	char* inName;
+	char* outName;
+	size_t srcOfs;	// stream offset in BATCH_STATE.srcData (containers only)
+	size_t decSize;	// decoded size from a container's TOC, (size_t)-1 = unknown
+	uint8_t status;	// see BATCH_* constants
+	uint8_t ret;	// LZSS error code
+	size_t inLen;
+	size_t outLen;
+	double time;	// seconds
+} BATCH_JOB;
+#define BATCH_OK		0x00
+#define BATCH_ERR_INPUT	0x01	// can't open/read the input file
+#define BATCH_ERR_OUTPUT	0x02	// can't create the output file
+#define BATCH_ERR_HEADER	0x03	// archive header mismatch
+#define BATCH_ERR_LZSS	0x04	// encoder/decoder error, see BATCH_JOB.ret
+typedef struct batch_state
+{
+	uint8_t mode;
+	const ARC_HDR_SPEC* hdrSpec;
+	LZSS_POOL* pool;
+	size_t srcLen;
+	const uint8_t* srcData;	// container data, NULL = every job reads its own input file
+	size_t jobCount;
+	BATCH_JOB* jobs;
+	size_t nextJob;		// protected by lock
+	LZSS_MUTEX lock;
+} BATCH_STATE;
+
+#define MODE_NONE	0x00
+#define MODE_ENCODE	0x01
+#define MODE_DECODE	0x02
+#define MODE_SNIFF	0x03
+
+#define ENC_BUF_SIZE	0x10000	// size of the buffer for encoded data
+#define DEC_BUF_SIZE	0x10000	// size of the buffer for decoded data
+#define BATCH_THREADS	4	// default number of worker threads for batch mode
+#define IDX_INTERVAL	0x40000	// decoded bytes between index checkpoints (each one stores N bytes)
+
+
+static void PrintHelp(const char* appName);
+static void ParseHeaderSpec(const char* spec, ARC_HDR_SPEC* header);
+static size_t WriteArchiveHeader(FILE_DATA* hdrData, const ARC_HDR_SPEC* hdrSpec, size_t decSize, size_t cmpSize);
+static uint8_t ReadArchiveHeader(const FILE_DATA* hdrData, const ARC_HDR_SPEC* hdrSpec, size_t* decSize, size_t* cmpSize);
+static size_t GetHeaderValue(const FILE_DATA* hdrData, const ARC_HDR_SPEC* hdrSpec, char type);
+static uint8_t EncodeToFile(LZSS_COMPR* lzss, FILE* hFile, size_t inLen, const uint8_t* inData, size_t* outLen);
+static uint8_t DecodeToFile(LZSS_COMPR* lzss, FILE* hFile, size_t inLen, const uint8_t* inData, size_t maxOutLen, size_t* outLen);
+static void SniffConfig(const LZSS_CFG* baseCfg, size_t inLen, const uint8_t* inData);
+static uint8_t DecodeWithIndex(LZSS_COMPR* lzss, FILE* hFile, const char* idxFileName, size_t inLen, const uint8_t* inData,
+								size_t rangeOfs, size_t rangeLen, size_t* outLen);
+static void PrintStatsJson(FILE* hFile, const char* mode, const LZSS_STATS* stats);
+static int HeaderHasField(const ARC_HDR_SPEC* hdrSpec, char type);
+static void SetBinaryMode(FILE* hFile);
+static FILE* OpenOutputFile(const char* fileName);
+static uint8_t StreamEncode(LZSS_COMPR* lzss, FILE* hIn, FILE* hOut, size_t* inLen, size_t* outLen);
+static uint8_t StreamDecode(LZSS_COMPR* lzss, FILE* hIn, FILE* hOut, size_t maxInLen, size_t maxOutLen, size_t* outLen);
+static int RunBatch(const LZSS_CFG* cfg, uint8_t mode, const ARC_HDR_SPEC* hdrSpec, const char* listName,
+					const char* pattern, unsigned int threads, const char* reportName);
+static int RunContainer(const LZSS_CFG* cfg, const ARC_HDR_SPEC* hdrSpec, const char* contSpec, const char* inName,
+						const char* outName, unsigned int threads, const char* reportName);
+
+
+int main(int argc, char *argv[])
+{
+	FILE_DATA inFile;
+	FILE_DATA outFile;
+	FILE_MAP inMap;
+	ARC_HDR_SPEC arcHdrSpec;
+	uint8_t ret;
+	FILE* fp;
+	LZSS_CFG cfg;
+	LZSS_COMPR* lzss;
+	int argbase;
+	uint8_t mode;
+	const char* idxFileName;
+	size_t rangeOfs;
+	size_t rangeLen;
+	int showStats;
+	uint8_t hashType;
+	const char* inName;
+	const char* outName;
+	int outPipe;
+	const char* batchList;
+	const char* batchPattern;
+	const char* reportName;
+	unsigned int batchThreads;
+	const char* contSpec;
+
+	lzssGetDefaultConfig(&cfg);
+	cfg.storeMode = LZSS_STORE_AUTO;
+	argbase = 1;
+	mode = MODE_NONE;
+	arcHdrSpec.len = 0x00;
+	arcHdrSpec.count = 0;
+	idxFileName = NULL;
+	rangeOfs = 0;
+	rangeLen = (size_t)-1;	// no range, decode everything
+	showStats = 0;
+	hashType = LZSS_HASH_CRC32;
+	batchList = NULL;
+	batchPattern = "*";
+	reportName = "-";
+	batchThreads = BATCH_THREADS;
+	contSpec = NULL;
+	while(argbase < argc)
+	{
+		char* endptr;
+		long val;
+		if (!strcmp(argv[argbase], "-h"))	// help
+		{
+			PrintHelp(argv[0]);
+			return 0;
+		}
+		else if (!strcmp(argv[argbase], "-e"))	// encode
+		{
+			mode = MODE_ENCODE;
+		}
+		else if (!strcmp(argv[argbase], "-d"))	// decode
+		{
+			mode = MODE_DECODE;
+		}
+		else if (!strcmp(argv[argbase], "-s"))	// sniff
+		{
+			mode = MODE_SNIFF;
+		}
+		else if (!strcmp(argv[argbase], "--stats"))	// print statistics
+		{
+			showStats = 1;
+		}
+		else if (!strcmp(argv[argbase], "-H"))	// checksum type for statistics
+		{
+			argbase ++;
+			if (argbase >= argc)
+			{
+				fprintf(stderr, "Insufficient arguments.\n");
+				return 1;
+			}
+			val = strtol(argv[argbase], &endptr, 0);
+			if (endptr == argv[argbase] || *endptr != '\0' || val < LZSS_HASH_NONE || val > LZSS_HASH_XXH64)
+			{
+				fprintf(stderr, "Invalid checksum type: %s\n", argv[argbase]);
+				return 1;
+			}
+			hashType = (uint8_t)val;
+		}
+		else if (!strcmp(argv[argbase], "-B"))	// batch mode: manifest file or directory
+		{
+			argbase ++;
+			if (argbase >= argc)
+			{
+				fprintf(stderr, "Insufficient arguments.\n");
+				return 1;
+			}
+			batchList = argv[argbase];
+		}
+		else if (!strcmp(argv[argbase], "-g"))	// batch mode: file name pattern for directories
+		{
+			argbase ++;
+			if (argbase >= argc)
+			{
+				fprintf(stderr, "Insufficient arguments.\n");
+				return 1;
+			}
+			batchPattern = argv[argbase];
+		}
+		else if (!strcmp(argv[argbase], "-j"))	// batch mode: worker threads
+		{
+			argbase ++;
+			if (argbase >= argc)
+			{
+				fprintf(stderr, "Insufficient arguments.\n");
+				return 1;
+			}
+			val = strtol(argv[argbase], &endptr, 0);
+			if (endptr != argv[argbase] && val > 0)
+			{
+				batchThreads = (unsigned int)val;
+			}
+		}
+		else if (!strcmp(argv[argbase], "--report"))	// batch mode: report file
+		{
+			argbase ++;
+			if (argbase >= argc)
+			{
+				fprintf(stderr, "Insufficient arguments.\n");
+				return 1;
+			}
+			reportName = argv[argbase];
+		}
+		else if (!strcmp(argv[argbase], "-m"))	// multi-stream container
+		{
+			argbase ++;
+			if (argbase >= argc)
+			{
+				fprintf(stderr, "Insufficient arguments.\n");
+				return 1;
+			}
+			contSpec = argv[argbase];
+		}
+		else if (!strcmp(argv[argbase], "-X"))	// index sidecar file
+		{
+			argbase ++;
+			if (argbase >= argc)
+			{
+				fprintf(stderr, "Insufficient arguments.\n");
+				return 1;
+			}
+			idxFileName = argv[argbase];
+		}
+		else if (!strcmp(argv[argbase], "-r"))	// decode range
+		{
+			argbase ++;
+			if (argbase >= argc)
+			{
+				fprintf(stderr, "Insufficient arguments.\n");
+				return 1;
+			}
+			// format: offset,length - both unsigned numbers (length (size_t)-1 is reserved for "no range")
+			endptr = argv[argbase];
+			if (isdigit((unsigned char)endptr[0]))
+				rangeOfs = (size_t)strtoul(endptr, &endptr, 0);
+			if (endptr != argv[argbase] && *endptr == ',' && isdigit((unsigned char)endptr[1]))
+				rangeLen = (size_t)strtoul(endptr + 1, &endptr, 0);
+			if (endptr == argv[argbase] || *endptr != '\0' || rangeLen == (size_t)-1)
+			{
+				fprintf(stderr, "Invalid range: %s\n", argv[argbase]);
+				return 1;
+			}
+		}
+		else if (!strcmp(argv[argbase], "-a"))	// archive header
+		{
+			argbase ++;
+			if (argbase >= argc)
+			{
+				fprintf(stderr, "Insufficient arguments.\n");
+				return 1;
+			}
+			ParseHeaderSpec(argv[argbase], &arcHdrSpec);
+		}
+		else if (!strcmp(argv[argbase], "-n"))	// name table initialization value
+		{
+			argbase ++;
+			if (argbase >= argc)
+			{
+				fprintf(stderr, "Insufficient arguments.\n");
+				return 1;
+			}
+			val = strtol(argv[argbase], &endptr, 0);
+			if (argv[argbase][0] == 'n')
+			{
+				cfg.nameTblType = LZSS_NTINIT_NONE;
+			}
+			else if (argv[argbase][0] == 'p')
+			{
+				cfg.nameTblType = LZSS_NTINIT_FUNC;
+				cfg.nameTblFunc = lzssNameTbl_CommonPatterns;
+				cfg.ntFuncParam = NULL;
+			}
+			else if (endptr != argv[argbase])
+			{
+				cfg.nameTblType = LZSS_NTINIT_VALUE;
+				cfg.nameTblValue = (uint8_t)val;
+			}
+			else
+			{
+				fprintf(stderr, "Unknown name table initialization parameter: %s\n", argv[argbase]);
+				return 1;
+			}
+		}
+		else if (!strcmp(argv[argbase], "-C"))	// control word bit order
+		{
+			argbase ++;
+			if (argbase >= argc)
+			{
+				fprintf(stderr, "Insufficient arguments.\n");
+				return 1;
+			}
+			val = strtol(argv[argbase], &endptr, 0);
+			if (endptr != argv[argbase])
+			{
+				cfg.flags &= ~LZSS_FLAGS_CTRLMASK;
+				cfg.flags |= val ? LZSS_FLAGS_CTRL_M : LZSS_FLAGS_CTRL_L;
+			}
+		}
+		else if (!strcmp(argv[argbase], "-R"))	// nametable reference value
+		{
+			argbase ++;
+			if (argbase >= argc)
+			{
+				fprintf(stderr, "Insufficient arguments.\n");
+				return 1;
+			}
+			val = strtol(argv[argbase], &endptr, 0);
+			if (endptr != argv[argbase])
+			{
+				cfg.flags &= ~(LZSS_FLAGS_MTCH_EMASK | LZSS_FLAGS_MTCH_LMASK);
+				cfg.flags |= (uint8_t)(val << 4);
+			}
+		}
+		else if (!strcmp(argv[argbase], "-O"))	// start offset for writing to name table buffer
+		{
+			argbase ++;
+			if (argbase >= argc)
+			{
+				fprintf(stderr, "Insufficient arguments.\n");
+				return 1;
+			}
+			val = strtol(argv[argbase], &endptr, 0);
+			if (endptr != argv[argbase])
+			{
+				cfg.nameTblStartOfs = (int)val;
+			}
+		}
+		else if (!strcmp(argv[argbase], "-E"))	// end-of-stream mode
+		{
+			argbase ++;
+			if (argbase >= argc)
+			{
+				fprintf(stderr, "Insufficient arguments.\n");
+				return 1;
+			}
+			val = strtol(argv[argbase], &endptr, 0);
+			if (endptr != argv[argbase])
+			{
+				cfg.eosMode = (uint8_t)val;
+			}
+		}
+		else if (!strcmp(argv[argbase], "-M"))	// match finder
+		{
+			argbase ++;
+			if (argbase >= argc)
+			{
+				fprintf(stderr, "Insufficient arguments.\n");
+				return 1;
+			}
+			val = strtol(argv[argbase], &endptr, 0);
+			if (endptr != argv[argbase])
+			{
+				cfg.matchFinder = (uint8_t)val;
+			}
+		}
+		else if (!strcmp(argv[argbase], "-N"))	// ring buffer size
+		{
+			argbase ++;
+			if (argbase >= argc)
+			{
+				fprintf(stderr, "Insufficient arguments.\n");
+				return 1;
+			}
+			val = strtol(argv[argbase], &endptr, 0);
+			if (endptr != argv[argbase])
+			{
+				unsigned int lenBits;
+				cfg.N = (unsigned int)val;
+				// use the largest match length that the length field allows (unless specified otherwise)
+				for (lenBits = 16; lenBits > 0 && (1UL << (16 - lenBits)) < cfg.N; lenBits --)
+					;
+				cfg.F = (1U << lenBits) + cfg.THRESHOLD;
+				if (cfg.F > cfg.N / 2)
+					cfg.F = cfg.N / 2;
+			}
+		}
+		else if (!strcmp(argv[argbase], "-F"))	// maximum match length
+		{
+			argbase ++;
+			if (argbase >= argc)
+			{
+				fprintf(stderr, "Insufficient arguments.\n");
+				return 1;
+			}
+			val = strtol(argv[argbase], &endptr, 0);
+			if (endptr != argv[argbase])
+			{
+				cfg.F = (unsigned int)val;
+			}
+		}
+		else if (!strcmp(argv[argbase], "-T"))	// threshold
+		{
+			argbase ++;
+			if (argbase >= argc)
+			{
+				fprintf(stderr, "Insufficient arguments.\n");
+				return 1;
+			}
+			val = strtol(argv[argbase], &endptr, 0);
+			if (endptr != argv[argbase])
+			{
+				cfg.F = cfg.F - cfg.THRESHOLD + (unsigned int)val;
+				cfg.THRESHOLD = (unsigned int)val;
+			}
+		}
+		else if (!strcmp(argv[argbase], "-L"))	// compression level
+		{
+			argbase ++;
+			if (argbase >= argc)
+			{
+				fprintf(stderr, "Insufficient arguments.\n");
+				return 1;
+			}
+			val = strtol(argv[argbase], &endptr, 0);
+			if (endptr != argv[argbase])
+			{
+				cfg.level = (uint8_t)val;
+			}
+		}
+		else if (!strcmp(argv[argbase], "-P"))	// parser
+		{
+			argbase ++;
+			if (argbase >= argc)
+			{
+				fprintf(stderr, "Insufficient arguments.\n");
+				return 1;
+			}
+			val = strtol(argv[argbase], &endptr, 0);
+			if (endptr != argv[argbase])
+			{
+				cfg.parser = (uint8_t)val;
+			}
+		}
+		else if (!strcmp(argv[argbase], "-S"))	// incompressible data handling
+		{
+			argbase ++;
+			if (argbase >= argc)
+			{
+				fprintf(stderr, "Insufficient arguments.\n");
+				return 1;
+			}
+			val = strtol(argv[argbase], &endptr, 0);
+			if (endptr != argv[argbase])
+			{
+				cfg.storeMode = (uint8_t)val;
+			}
+		}
+		else
+		{
+			break;
+		}
+		argbase ++;
+	}
+
+	if (batchList == NULL && argc < argbase + ((mode == MODE_SNIFF) ? 1 : 2))
+	{
+		PrintHelp(argv[0]);
+		return 1;
+	}
+	if (mode == MODE_NONE)
+	{
+		fprintf(stderr, "No mode specified!\n");
+		return 1;
+	}
+	if (showStats)
+	{
+		cfg.stats = LZSS_STATS_ON;
+		cfg.hashType = hashType;
+	}
+	if (lzssCheckConfig(&cfg) != LZSS_ERR_OK)
+	{
+		fprintf(stderr, "Unsupported LZSS geometry: N = 0x%X, F = %u, THRESHOLD = %u\n", cfg.N, cfg.F, cfg.THRESHOLD);
+		return 1;
+	}
+	if (batchList != NULL)
+	{
+		if (mode == MODE_SNIFF || showStats || idxFileName != NULL || rangeLen != (size_t)-1)
+		{
+			fprintf(stderr, "Batch mode supports only encoding and decoding, without -X, -r and --stats.\n");
+			return 1;
+		}
+		return RunBatch(&cfg, mode, &arcHdrSpec, batchList, batchPattern, batchThreads, reportName);
+	}
+	if (contSpec != NULL)
+	{
+		if (mode != MODE_DECODE || showStats || idxFileName != NULL || rangeLen != (size_t)-1)
+		{
+			fprintf(stderr, "Containers can only be decoded, without -X, -r and --stats.\n");
+			return 1;
+		}
+		return RunContainer(&cfg, &arcHdrSpec, contSpec, argv[argbase + 0], argv[argbase + 1], batchThreads, reportName);
+	}
+
+	inName = argv[argbase + 0];
+	outName = (mode == MODE_SNIFF) ? NULL : argv[argbase + 1];
+	outPipe = (outName != NULL && ! strcmp(outName, "-"));
+	if (! strcmp(inName, "-") && mode != MODE_SNIFF && idxFileName == NULL && rangeLen == (size_t)-1 &&
+		(mode == MODE_DECODE || (! HeaderHasField(&arcHdrSpec, 'o') && ! HeaderHasField(&arcHdrSpec, 'c') &&
+		cfg.parser != LZSS_PARSE_OPTIMAL)))
+	{
+		// stream from stdin with fixed-size buffers
+		fp = OpenOutputFile(outName);
+		if (fp == NULL)
+		{
+			fprintf(stderr, "Error opening output file: %s\n", outName);
+			return 3;
+		}
+		SetBinaryMode(stdin);
+		lzss = lzssCreate(&cfg);
+		// only the header is buffered
+		outFile.len = arcHdrSpec.len;
+		outFile.data = (uint8_t*)calloc(outFile.len + 1, 1);
+		if (lzss == NULL || outFile.data == NULL)
+		{
+			fprintf(stderr, "Error allocating memory!\n");
+			if (lzss != NULL)
+				lzssDestroy(lzss);
+			free(outFile.data);
+			if (fp != stdout)
+				fclose(fp);
+			return 1;
+		}
+		if (mode == MODE_ENCODE)
+		{
+			size_t inLen;
+			size_t encDataSize;
+
+			WriteArchiveHeader(&outFile, &arcHdrSpec, 0, 0);	// the header has no size fields
+			fwrite(outFile.data, 1, outFile.len, fp);
+			ret = StreamEncode(lzss, stdin, fp, &inLen, &encDataSize);
+			fprintf(stderr, "In : %u bytes\n", (unsigned)inLen);
+			fprintf(stderr, "Out: %u bytes\n", (unsigned)encDataSize);
+			fprintf(stderr, "Ratio: %.2f %%\n", (double)encDataSize / inLen * 100.0);
+			outFile.len += encDataSize;
+		}
+		else //if (mode == MODE_DECODE)
+		{
+			size_t cmpSize = (size_t)-1;
+			size_t decSize = (size_t)-1;
+
+			outFile.len = fread(outFile.data, 1, outFile.len, stdin);
+			if (ReadArchiveHeader(&outFile, &arcHdrSpec, &decSize, &cmpSize))
+			{
+				fprintf(stderr, "Header parsing error!\n");
+				return 4;
+			}
+			ret = StreamDecode(lzss, stdin, fp, cmpSize, decSize, &outFile.len);
+		}
+		free(outFile.data);
+		inMap.data = NULL;
+		inMap.mapped = 0;
+	}
+	else
+	{
+		// when the output overwrites the input file, the input must not stay mapped while it is truncated
+		if ((outName != NULL && IsSameFile(inName, outName)) ? ReadInputFile(inName, &inMap) : MapInputFile(inName, &inMap))
+		{
+			fprintf(stderr, "Error opening input file: %s\n", inName);
+			return 2;
+		}
+		inFile.len = inMap.len;
+		inFile.data = inMap.data;
+
+		if (mode == MODE_SNIFF)
+		{
+			size_t dataOfs = (arcHdrSpec.len < inFile.len) ? arcHdrSpec.len : inFile.len;
+			SniffConfig(&cfg, inFile.len - dataOfs, &inFile.data[dataOfs]);
+			UnmapFile(&inMap, 0);
+			return 0;
+		}
+
+		lzss = lzssCreate(&cfg);
+		if (mode == MODE_ENCODE)
+		{
+			size_t encDataSize;
+			size_t dataOfs = arcHdrSpec.len;
+
+			fp = OpenOutputFile(outName);
+			if (fp == NULL)
+			{
+				fprintf(stderr, "Error opening output file: %s\n", outName);
+				return 3;
+			}
+			outFile.len = dataOfs;
+			outFile.data = (uint8_t*)calloc(dataOfs + 1, 1);
+			if (outPipe && dataOfs > 0)
+			{
+				// stdout can't seek back to the header, so the compressed size is determined first
+				encDataSize = 0;
+				if (HeaderHasField(&arcHdrSpec, 'c'))
+					EncodeToFile(lzss, NULL, inFile.len, inFile.data, &encDataSize);
+				WriteArchiveHeader(&outFile, &arcHdrSpec, inFile.len, encDataSize);
+			}
+			// else: reserve space for the header, it is written once the compressed size is known
+			fwrite(outFile.data, 1, outFile.len, fp);
+
+			ret = EncodeToFile(lzss, fp, inFile.len, inFile.data, &encDataSize);
+			fprintf(stderr, "In : %u bytes\n", inFile.len);
+			fprintf(stderr, "Out: %u bytes\n", encDataSize);
+			fprintf(stderr, "Ratio: %.2f %%\n", (double)encDataSize / inFile.len * 100.0);
+
+			if (dataOfs > 0 && ! outPipe)
+			{
+				WriteArchiveHeader(&outFile, &arcHdrSpec, inFile.len, encDataSize);
+				fseek(fp, 0, SEEK_SET);
+				fwrite(outFile.data, 1, outFile.len, fp);
+			}
+			free(outFile.data);
+			outFile.len = dataOfs + encDataSize;
+		}
+		else //if (mode == MODE_DECODE)
+		{
+			size_t cmpSize = inFile.len;
+			size_t decSize = (size_t)-1;	// unknown, unless specified by the header
+			size_t dataOfs = arcHdrSpec.len;
+			size_t streamSize;
+			FILE_MAP outMap;
+
+			// ReadArchiveHeader() stops at the end of the data, so a file shorter than the header has to be caught here
+			ret = (inFile.len < dataOfs) ? 1 : ReadArchiveHeader(&inFile, &arcHdrSpec, &decSize, &cmpSize);
+			if (ret)
+			{
+				fprintf(stderr, "Header parsing error!\n");
+				return 4;
+			}
+			if (inFile.len > dataOfs + cmpSize)
+				inFile.len = dataOfs + cmpSize;
+			// The size pre-pass only parses the control bytes, it is needed for sizing the output mapping.
+			lzssDecodedSize(lzss, inFile.len - dataOfs, &inFile.data[dataOfs], &streamSize);
+			if (decSize != (size_t)-1)
+			{
+				if (streamSize != decSize)
+					fprintf(stderr, "Warning: Header says %u bytes, but the data decodes to %u bytes.\n",
+						(unsigned)decSize, (unsigned)streamSize);
+				if (streamSize > decSize)
+					streamSize = decSize;	// don't write more than the header says
+			}
+
+			if (idxFileName == NULL && rangeLen == (size_t)-1 && ! outPipe &&
+				! MapOutputFile(outName, streamSize, &outMap))
+			{
+				// decode directly into the mapped output file
+				ret = lzssDecode(lzss, streamSize, outMap.data, &outFile.len, inFile.len - dataOfs, &inFile.data[dataOfs]);
+				UnmapFile(&outMap, outFile.len);
+				fp = NULL;
+			}
+			else
+			{
+				fp = OpenOutputFile(outName);
+				if (fp == NULL)
+				{
+					fprintf(stderr, "Error opening output file: %s\n", outName);
+					return 3;
+				}
+				if (idxFileName != NULL || rangeLen != (size_t)-1)
+					ret = DecodeWithIndex(lzss, fp, idxFileName, inFile.len - dataOfs, &inFile.data[dataOfs],
+											rangeOfs, rangeLen, &outFile.len);
+				else
+					ret = DecodeToFile(lzss, fp, inFile.len - dataOfs, &inFile.data[dataOfs], decSize, &outFile.len);
+			}
+		}
+	}
+	if (fp != NULL)
+		fclose(fp);
+	UnmapFile(&inMap, 0);
+	if (ret != LZSS_ERR_OK)
+		fprintf(stderr, "LZSS error code %u after writing %u bytes.\n", ret, (unsigned)outFile.len);
+	if (showStats && rangeLen == (size_t)-1)
+	{
+		LZSS_STATS stats;
+		lzssGetStats(lzss, &stats);
+		// keep the JSON out of the data when writing to stdout
+		PrintStatsJson(outPipe ? stderr : stdout, (mode == MODE_ENCODE) ? "encode" : "decode", &stats);
+	}
+	lzssDestroy(lzss);
+
+	return 0;
+}
+
+// hFile may be NULL for only determining the compressed size.
+static uint8_t EncodeToFile(LZSS_COMPR* lzss, FILE* hFile, size_t inLen, const uint8_t* inData, size_t* outLen)
+{
+	uint8_t* encBuf;
+	size_t inPos;
+	size_t outPos;
+	uint8_t ret;
+
+	if (lzssGetConfiguration(lzss)->parser == LZSS_PARSE_OPTIMAL)
+	{
+		// the optimal parser works on the whole input only
+		size_t encSize = lzssEncodeBound(lzssGetConfiguration(lzss), inLen);
+		encBuf = (uint8_t*)malloc(encSize);
+		ret = lzssEncode(lzss, encSize, encBuf, outLen, inLen, inData);
+		if (hFile != NULL)
+			fwrite(encBuf, 1, *outLen, hFile);
+		free(encBuf);
+		return ret;
+	}
+
+	encBuf = (uint8_t*)malloc(ENC_BUF_SIZE);
+	lzssEncodeBegin(lzss);
+	inPos = 0;
+	outPos = 0;
+	do
+	{
+		size_t encLen;
+		size_t readLen;
+		ret = lzssEncodeChunk(lzss, ENC_BUF_SIZE, encBuf, &encLen, inLen - inPos, &inData[inPos], &readLen);
+		inPos += readLen;
+		outPos += encLen;
+		if (hFile != NULL)
+			fwrite(encBuf, 1, encLen, hFile);
+	} while(ret == LZSS_ERR_EOF_OUT);
+	do
+	{
+		size_t encLen;
+		ret = lzssEncodeEnd(lzss, ENC_BUF_SIZE, encBuf, &encLen);
+		outPos += encLen;
+		if (hFile != NULL)
+			fwrite(encBuf, 1, encLen, hFile);
+	} while(ret == LZSS_ERR_EOF_OUT);
+	free(encBuf);
+
+	*outLen = outPos;
+	return ret;
+}
+
+static uint8_t DecodeToFile(LZSS_COMPR* lzss, FILE* hFile, size_t inLen, const uint8_t* inData, size_t maxOutLen, size_t* outLen)
+{
+	uint8_t* decBuf;
+	size_t inPos;
+	size_t outPos;
+	uint8_t ret;
+
+	decBuf = (uint8_t*)malloc(DEC_BUF_SIZE);
+	lzssDecodeBegin(lzss);
+	inPos = 0;
+	outPos = 0;
+	do
+	{
+		size_t decLen;
+		size_t readLen;
+		size_t bufLen = DEC_BUF_SIZE;
+		if (bufLen > maxOutLen - outPos)
+			bufLen = maxOutLen - outPos;	// don't write more than the header says
+		ret = lzssDecodeChunk(lzss, bufLen, decBuf, &decLen, inLen - inPos, &inData[inPos], &readLen);
+		inPos += readLen;
+		outPos += decLen;
+		fwrite(decBuf, 1, decLen, hFile);
+	} while(ret == LZSS_ERR_EOF_OUT && outPos < maxOutLen);
+	if (ret == LZSS_ERR_OK)
+		ret = lzssDecodeEnd(lzss);
+	free(decBuf);
+
+	*outLen = outPos;
+	return ret;
+}
+
+// Encodes data from hIn until its end, using fixed-size buffers.
+static uint8_t StreamEncode(LZSS_COMPR* lzss, FILE* hIn, FILE* hOut, size_t* inLen, size_t* outLen)
+{
+	uint8_t* inBuf;
+	uint8_t* encBuf;
+	size_t inFill;
+	size_t inTotal;
+	size_t outPos;
+	uint8_t ret;
+
+	inBuf = (uint8_t*)malloc(DEC_BUF_SIZE);
+	encBuf = (uint8_t*)malloc(ENC_BUF_SIZE);
+	lzssEncodeBegin(lzss);
+	inTotal = 0;
+	outPos = 0;
+	ret = LZSS_ERR_OK;
+	while((inFill = fread(inBuf, 1, DEC_BUF_SIZE, hIn)) > 0)
+	{
+		size_t inPos = 0;
+		inTotal += inFill;
+		do
+		{
+			size_t encLen;
+			size_t readLen;
+			ret = lzssEncodeChunk(lzss, ENC_BUF_SIZE, encBuf, &encLen, inFill - inPos, &inBuf[inPos], &readLen);
+			inPos += readLen;
+			outPos += encLen;
+			fwrite(encBuf, 1, encLen, hOut);
+		} while(ret == LZSS_ERR_EOF_OUT);
+	}
+	do
+	{
+		size_t encLen;
+		ret = lzssEncodeEnd(lzss, ENC_BUF_SIZE, encBuf, &encLen);
+		outPos += encLen;
+		fwrite(encBuf, 1, encLen, hOut);
+	} while(ret == LZSS_ERR_EOF_OUT);
+	free(inBuf);
+	free(encBuf);
+
+	*inLen = inTotal;
+	*outLen = outPos;
+	return ret;
+}
+
+// Decodes at most maxInLen bytes from hIn, using fixed-size buffers.
+// Reading stops at the end-of-stream marker or when maxOutLen bytes were written.
+static uint8_t StreamDecode(LZSS_COMPR* lzss, FILE* hIn, FILE* hOut, size_t maxInLen, size_t maxOutLen, size_t* outLen)
+{
+	uint8_t* inBuf;
+	uint8_t* decBuf;
+	size_t inFill;
+	size_t inPos;
+	size_t outPos;
+	uint8_t ret;
+
+	inBuf = (uint8_t*)malloc(ENC_BUF_SIZE);
+	decBuf = (uint8_t*)malloc(DEC_BUF_SIZE);
+	lzssDecodeBegin(lzss);
+	inFill = 0;
+	inPos = 0;
+	outPos = 0;
+	ret = LZSS_ERR_OK;
+	do
+	{
+		size_t decLen;
+		size_t readLen;
+		size_t bufLen = DEC_BUF_SIZE;
+		if (inPos == inFill && ret != LZSS_ERR_EOF_OUT)
+		{
+			// all input was consumed - refill the buffer
+			size_t fillLen = (maxInLen < ENC_BUF_SIZE) ? maxInLen : ENC_BUF_SIZE;
+			inFill = fread(inBuf, 1, fillLen, hIn);
+			maxInLen -= inFill;
+			inPos = 0;
+			if (inFill == 0)
+				break;
+		}
+		if (bufLen > maxOutLen - outPos)
+			bufLen = maxOutLen - outPos;	// don't write more than the header says
+		ret = lzssDecodeChunk(lzss, bufLen, decBuf, &decLen, inFill - inPos, &inBuf[inPos], &readLen);
+		inPos += readLen;
+		outPos += decLen;
+		fwrite(decBuf, 1, decLen, hOut);
+		if (ret == LZSS_ERR_OK && inPos < inFill)
+			break;	// reached the end-of-stream marker
+	} while((ret == LZSS_ERR_OK || ret == LZSS_ERR_EOF_OUT) && outPos < maxOutLen);
+	if (ret == LZSS_ERR_OK)
+		ret = lzssDecodeEnd(lzss);
+	free(inBuf);
+	free(decBuf);
+
+	*outLen = outPos;
+	return ret;
+}
+
+// Decodes the whole stream and writes an index to idxFileName (rangeLen == (size_t)-1)
+// or decodes only the specified range, using the index from idxFileName.
+// When the index file doesn't exist, the index is built (and saved when a file name is given).
+static uint8_t DecodeWithIndex(LZSS_COMPR* lzss, FILE* hFile, const char* idxFileName, size_t inLen, const uint8_t* inData,
+								size_t rangeOfs, size_t rangeLen, size_t* outLen)
+{
+	LZSS_INDEX* idx = NULL;
+	uint8_t* decBuf;
+	size_t decLen;
+	FILE* fpIdx;
+	uint8_t ret;
+
+	*outLen = 0;
+	if (rangeLen == (size_t)-1)
+	{
+		ret = lzssDecodedSize(lzss, inLen, inData, &decLen);
+		if (ret != LZSS_ERR_OK)
+			return ret;
+		decBuf = (uint8_t*)malloc(decLen + 1);
+		if (decBuf == NULL)
+			return LZSS_ERR_NO_MEM;
+		ret = lzssIndexBuild(lzss, IDX_INTERVAL, decLen, decBuf, outLen, inLen, inData, &idx);
+		fwrite(decBuf, 1, *outLen, hFile);
+		free(decBuf);
+		if (ret != LZSS_ERR_OK)
+			return ret;
+	}
+	else
+	{
+		fpIdx = (idxFileName != NULL) ? fopen(idxFileName, "rb") : NULL;
+		if (fpIdx != NULL)
+		{
+			size_t idxSize;
+			uint8_t* idxData;
+
+			fseek(fpIdx, 0, SEEK_END);
+			idxSize = ftell(fpIdx);
+			rewind(fpIdx);
+			idxData = (uint8_t*)malloc(idxSize + 1);
+			if (idxData == NULL)
+			{
+				fclose(fpIdx);
+				return LZSS_ERR_NO_MEM;
+			}
+			idxSize = fread(idxData, 1, idxSize, fpIdx);
+			fclose(fpIdx);
+			ret = lzssIndexRead(idxSize, idxData, &idx);
+			free(idxData);
+			if (ret != LZSS_ERR_OK)
+			{
+				fprintf(stderr, "Error reading index file: %s\n", idxFileName);
+				return ret;
+			}
+			if (lzssIndexCheck(lzss, idx, inLen, inData) == LZSS_ERR_OK)
+			{
+				idxFileName = NULL;	// don't write it again
+			}
+			else
+			{
+				fprintf(stderr, "Index file %s doesn't match the input, rebuilding it.\n", idxFileName);
+				lzssIndexFree(idx);
+				idx = NULL;
+			}
+		}
+		if (idx == NULL)
+		{
+			ret = lzssIndexBuild(lzss, IDX_INTERVAL, 0, NULL, NULL, inLen, inData, &idx);
+			if (ret != LZSS_ERR_OK)
+				return ret;
+		}
+
+		// don't allocate more than the stream can return
+		decLen = lzssIndexGetDecodedSize(idx);
+		if (rangeOfs >= decLen)
+			rangeLen = 0;
+		else if (rangeLen > decLen - rangeOfs)
+			rangeLen = decLen - rangeOfs;
+		decBuf = (uint8_t*)malloc(rangeLen + 1);
+		if (decBuf == NULL)
+		{
+			lzssIndexFree(idx);
+			return LZSS_ERR_NO_MEM;
+		}
+		ret = lzssDecodeRange(lzss, idx, rangeOfs, rangeLen, decBuf, outLen, inLen, inData);
+		fwrite(decBuf, 1, *outLen, hFile);
+		free(decBuf);
+		if (ret != LZSS_ERR_OK)
+		{
+			lzssIndexFree(idx);
+			return ret;
+		}
+	}
+
+	if (idxFileName != NULL)
+	{
+		size_t idxSize = lzssIndexGetSize(idx);
+		uint8_t* idxData = (uint8_t*)malloc(idxSize);
+		if (idxData == NULL || lzssIndexWrite(idx, idxSize, idxData) != LZSS_ERR_OK)
+		{
+			fprintf(stderr, "Error creating index data!\n");
+		}
+		else if ((fpIdx = fopen(idxFileName, "wb")) == NULL)
+		{
+			fprintf(stderr, "Error opening index file: %s\n", idxFileName);
+		}
+		else
+		{
+			fwrite(idxData, 1, idxSize, fpIdx);
+			fclose(fpIdx);
+		}
+		free(idxData);
+	}
+	lzssIndexFree(idx);
+	return LZSS_ERR_OK;
+}
+
+static int HeaderHasField(const ARC_HDR_SPEC* hdrSpec, char type)
+{
+	size_t hdrItem;
+
+	for (hdrItem = 0; hdrItem < hdrSpec->count; hdrItem++)
+	{
+		if (hdrSpec->vals[hdrItem].type == type)
+			return 1;
+	}
+	return 0;
+}
+
+static void SetBinaryMode(FILE* hFile)
+{
+#ifdef _WIN32
+	_setmode(_fileno(hFile), _O_BINARY);
+#else
+	(void)hFile;
+#endif
+	return;
+}
+
+// "-" is standard output
+static FILE* OpenOutputFile(const char* fileName)
+{
+	if (! strcmp(fileName, "-"))
+	{
+		SetBinaryMode(stdout);
+		return stdout;
+	}
+	return fopen(fileName, "wb");
+}
+
+// --- batch mode ---
+// All files are processed by a fixed number of worker threads. Each worker keeps one context from the pool
+// for all of its files. Failed files are noted in the report, the remaining ones are processed nevertheless.
+static char* StrDupLen(const char* str, size_t len)
+{
+	char* result = (char*)malloc(len + 1);
+	memcpy(result, str, len);
+	result[len] = '\0';
+	return result;
+}
+
+static char* BatchOutputName(const char* inName, uint8_t mode)
+{
+	size_t len = strlen(inName);
+	char* result;
+
+	if (mode == MODE_DECODE && len > 3 && ! strcmp(&inName[len - 3], ".lz"))
+		return StrDupLen(inName, len - 3);
+	result = (char*)malloc(len + 5);
+	strcpy(result, inName);
+	strcpy(&result[len], (mode == MODE_ENCODE) ? ".lz" : ".dec");
+	return result;
+}
+
+static void AddBatchJob(BATCH_STATE* bs, size_t* jobAlloc, char* inName, char* outName)
+{
+	BATCH_JOB* job;
+
+	if (bs->jobCount >= *jobAlloc)
+	{
+		*jobAlloc = (*jobAlloc == 0) ? 0x100 : (*jobAlloc * 2);
+		bs->jobs = (BATCH_JOB*)realloc(bs->jobs, *jobAlloc * sizeof(BATCH_JOB));
+	}
+	job = &bs->jobs[bs->jobCount];
+	memset(job, 0x00, sizeof(BATCH_JOB));
+	job->inName = inName;
+	job->outName = (outName != NULL) ? outName : BatchOutputName(inName, bs->mode);
+	job->decSize = (size_t)-1;
+	bs->jobCount ++;
+	return;
+}
+
+// supports '*' (any number of characters) and '?' (exactly one character)
+static int WildcardMatch(const char* pattern, const char* name)
+{
+	while(*pattern != '\0')
+	{
+		if (*pattern == '*')
+		{
+			pattern ++;
+			for (; *name != '\0'; name ++)
+			{
+				if (WildcardMatch(pattern, name))
+					return 1;
+			}
+			return (*pattern == '\0');
+		}
+		if (*name == '\0' || (*pattern != '?' && *pattern != *name))
+			return 0;
+		pattern ++;
+		name ++;
+	}
+	return (*name == '\0');
+}
+
+static int IsDirectory(const char* path)
+{
+#ifdef _WIN32
+	DWORD attr = GetFileAttributesA(path);
+	return (attr != INVALID_FILE_ATTRIBUTES && (attr & FILE_ATTRIBUTE_DIRECTORY));
+#else
+	struct stat st;
+	return (stat(path, &st) == 0 && S_ISDIR(st.st_mode));
+#endif
+}
+
+// one job per line: "input<TAB>output" or just "input", empty lines and lines starting with '#' are skipped
+static uint8_t ReadBatchManifest(BATCH_STATE* bs, const char* fileName)
+{
+	FILE_MAP listMap;
+	size_t jobAlloc;
+	size_t pos;
+
+	if (MapInputFile(fileName, &listMap))
+		return 1;
+	jobAlloc = 0;
+	pos = 0;
+	while(pos < listMap.len)
+	{
+		const char* line = (const char*)&listMap.data[pos];
+		size_t lineLen;
+		size_t sepPos;
+
+		for (lineLen = 0; pos + lineLen < listMap.len && line[lineLen] != '\n'; lineLen ++)
+			;
+		pos += lineLen + 1;
+		if (lineLen > 0 && line[lineLen - 1] == '\r')
+			lineLen --;
+		if (lineLen == 0 || line[0] == '#')
+			continue;
+		for (sepPos = 0; sepPos < lineLen && line[sepPos] != '\t'; sepPos ++)
+			;
+		if (sepPos + 1 < lineLen)
+			AddBatchJob(bs, &jobAlloc, StrDupLen(line, sepPos), StrDupLen(&line[sepPos + 1], lineLen - (sepPos + 1)));
+		else
+			AddBatchJob(bs, &jobAlloc, StrDupLen(line, sepPos), NULL);
+	}
+	UnmapFile(&listMap, 0);
+	return 0;
+}
+
+static int BatchJobCompare(const void* a, const void* b)
+{
+	return strcmp(((const BATCH_JOB*)a)->inName, ((const BATCH_JOB*)b)->inName);
+}
+
+// adds all regular files in dirName (not recursive) whose names match the pattern, sorted by name
+static uint8_t ScanBatchDirectory(BATCH_STATE* bs, const char* dirName, const char* pattern)
+{
+	size_t jobAlloc = 0;
+	size_t dirLen = strlen(dirName);
+	char* path;
+#ifdef _WIN32
+	WIN32_FIND_DATAA findData;
+	HANDLE hFind;
+
+	path = (char*)malloc(dirLen + 3);
+	sprintf(path, "%s\\*", dirName);
+	hFind = FindFirstFileA(path, &findData);
+	free(path);
+	if (hFind == INVALID_HANDLE_VALUE)
+		return 1;
+	do
+	{
+		if (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+			continue;
+		if (! WildcardMatch(pattern, findData.cFileName))
+			continue;
+		path = (char*)malloc(dirLen + 1 + strlen(findData.cFileName) + 1);
+		sprintf(path, "%s\\%s", dirName, findData.cFileName);
+		AddBatchJob(bs, &jobAlloc, path, NULL);
+	} while(FindNextFileA(hFind, &findData));
+	FindClose(hFind);
+#else
+	DIR* hDir;
+	struct dirent* entry;
+
+	hDir = opendir(dirName);
+	if (hDir == NULL)
+		return 1;
+	while((entry = readdir(hDir)) != NULL)
+	{
+		if (! WildcardMatch(pattern, entry->d_name))
+			continue;
+		path = (char*)malloc(dirLen + 1 + strlen(entry->d_name) + 1);
+		sprintf(path, "%s/%s", dirName, entry->d_name);
+		if (IsDirectory(path))
+		{
+			free(path);
+			continue;
+		}
+		AddBatchJob(bs, &jobAlloc, path, NULL);
+	}
+	closedir(hDir);
+#endif
+	if (bs->jobCount > 1)
+		qsort(bs->jobs, bs->jobCount, sizeof(BATCH_JOB), BatchJobCompare);
+	return 0;
+}
+
+// same as the single-file encode/decode in main(), but without console output
+static uint8_t ProcessBatchJob(LZSS_COMPR* lzss, const BATCH_STATE* bs, BATCH_JOB* job)
+{
+	FILE_MAP inMap;
+	FILE_DATA inFile;
+	FILE_DATA hdrData;
+	FILE* hFile;
+	size_t dataOfs = bs->hdrSpec->len;
+
+	job->ret = LZSS_ERR_OK;
+	if (bs->srcData != NULL)
+	{
+		// a stream inside the container, job->inLen was set when indexing
+		if (job->srcOfs > bs->srcLen || job->inLen > bs->srcLen - job->srcOfs)
+			return BATCH_ERR_INPUT;
+		inMap.len = job->inLen;
+		inMap.data = (uint8_t*)&bs->srcData[job->srcOfs];
+	}
+	else if (IsSameFile(job->inName, job->outName) ? ReadInputFile(job->inName, &inMap) : MapInputFile(job->inName, &inMap))
+	{
+		return BATCH_ERR_INPUT;
+	}
+	inFile.len = inMap.len;
+	inFile.data = inMap.data;
+	job->inLen = inFile.len;
+
+	if (bs->mode == MODE_ENCODE)
+	{
+		size_t encDataSize = 0;
+
+		hFile = fopen(job->outName, "wb");
+		if (hFile == NULL)
+		{
+			if (bs->srcData == NULL)
+				UnmapFile(&inMap, 0);
+			return BATCH_ERR_OUTPUT;
+		}
+		hdrData.len = dataOfs;
+		hdrData.data = (uint8_t*)calloc(dataOfs + 1, 1);
+		fwrite(hdrData.data, 1, hdrData.len, hFile);
+		job->ret = EncodeToFile(lzss, hFile, inFile.len, inFile.data, &encDataSize);
+		if (dataOfs > 0)
+		{
+			WriteArchiveHeader(&hdrData, bs->hdrSpec, inFile.len, encDataSize);
+			fseek(hFile, 0, SEEK_SET);
+			fwrite(hdrData.data, 1, hdrData.len, hFile);
+		}
+		fclose(hFile);
+		free(hdrData.data);
+		job->outLen = dataOfs + encDataSize;
+	}
+	else //if (bs->mode == MODE_DECODE)
+	{
+		size_t cmpSize = inFile.len;
+		size_t decSize = job->decSize;
+		size_t streamSize;
+		FILE_MAP outMap;
+
+		if (inFile.len < dataOfs || ReadArchiveHeader(&inFile, bs->hdrSpec, &decSize, &cmpSize))
+		{
+			if (bs->srcData == NULL)
+				UnmapFile(&inMap, 0);
+			return BATCH_ERR_HEADER;
+		}
+		if (inFile.len > dataOfs + cmpSize)
+			inFile.len = dataOfs + cmpSize;
+		lzssDecodedSize(lzss, inFile.len - dataOfs, &inFile.data[dataOfs], &streamSize);
+		if (streamSize > decSize)
+			streamSize = decSize;
+		if (! MapOutputFile(job->outName, streamSize, &outMap))
+		{
+			job->ret = lzssDecode(lzss, streamSize, outMap.data, &job->outLen, inFile.len - dataOfs, &inFile.data[dataOfs]);
+			UnmapFile(&outMap, job->outLen);
+		}
+		else
+		{
+			hFile = fopen(job->outName, "wb");
+			if (hFile == NULL)
+			{
+				if (bs->srcData == NULL)
+					UnmapFile(&inMap, 0);
+				return BATCH_ERR_OUTPUT;
+			}
+			job->ret = DecodeToFile(lzss, hFile, inFile.len - dataOfs, &inFile.data[dataOfs], decSize, &job->outLen);
+			fclose(hFile);
+		}
+	}
+	if (bs->srcData == NULL)
+		UnmapFile(&inMap, 0);
+	return (job->ret == LZSS_ERR_OK) ? BATCH_OK : BATCH_ERR_LZSS;
+}
+
+static void RunBatchJob(LZSS_COMPR* lzss, const BATCH_STATE* bs, BATCH_JOB* job)
+{
+	struct timespec start, end;
+
+	timespec_get(&start, TIME_UTC);
+	job->status = ProcessBatchJob(lzss, bs, job);
+	timespec_get(&end, TIME_UTC);
+	job->time = (double)(end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1.0E+9;
+	return;
+}
+
+static THREAD_FUNC BatchWorker(void* param)
+{
+	BATCH_STATE* bs = (BATCH_STATE*)param;
+	LZSS_COMPR* lzss = (bs->pool != NULL) ? lzssPoolAcquire(bs->pool) : NULL;
+
+	while(1)
+	{
+		size_t jobID;
+
+		MutexLock(&bs->lock);
+		jobID = bs->nextJob;
+		if (jobID < bs->jobCount)
+			bs->nextJob ++;
+		MutexUnlock(&bs->lock);
+		if (jobID >= bs->jobCount)
+			break;
+		if (bs->jobs[jobID].status != BATCH_OK)
+			continue;	// failed while indexing the container
+		if (lzss == NULL)
+		{
+			// no context available, the job fails instead of the whole batch
+			bs->jobs[jobID].status = BATCH_ERR_LZSS;
+			bs->jobs[jobID].ret = LZSS_ERR_NO_MEM;
+			continue;
+		}
+		RunBatchJob(lzss, bs, &bs->jobs[jobID]);
+	}
+	if (lzss != NULL)
+		lzssPoolRelease(bs->pool, lzss);
+	return 0;
+}
+
+// Processes all jobs of the batch and writes the report. The job list is freed afterwards.
+// Returns 0 when all files were processed successfully, 5 when some of them failed.
+static int ExecuteBatch(const LZSS_CFG* cfg, BATCH_STATE* bs, unsigned int threads, const char* reportName)
+{
+	static const char* STATUS_NAMES[5] = {"ok", "input", "output", "header", "lzss"};
+	LZSS_THREAD* workers;
+	unsigned int curThread;
+	size_t curJob;
+	size_t failCount;
+	FILE* hReport;
+	struct timespec start, end;
+
+	hReport = OpenOutputFile(reportName);
+	if (hReport == NULL)
+	{
+		fprintf(stderr, "Error opening report file: %s\n", reportName);
+		return 3;
+	}
+	if (threads > bs->jobCount)
+		threads = (bs->jobCount > 0) ? (unsigned int)bs->jobCount : 1;
+
+	timespec_get(&start, TIME_UTC);
+	bs->pool = lzssPoolCreate(cfg, threads);
+	if (bs->pool == NULL)
+		fprintf(stderr, "Error creating the LZSS context pool!\n");	// all jobs fail with LZSS_ERR_NO_MEM
+	MutexInit(&bs->lock);
+	workers = (LZSS_THREAD*)calloc(threads, sizeof(LZSS_THREAD));
+	for (curThread = 0; workers != NULL && curThread < threads; curThread ++)
+	{
+		if (! ThreadCreate(&workers[curThread], BatchWorker, bs))
+			break;
+	}
+	if (curThread == 0)
+		BatchWorker(bs);	// no threads available, do all the work here
+	while(curThread > 0)
+	{
+		curThread --;
+		ThreadJoin(workers[curThread]);
+	}
+	free(workers);
+	MutexDeinit(&bs->lock);
+	if (bs->pool != NULL)
+		lzssPoolDestroy(bs->pool);
+	timespec_get(&end, TIME_UTC);
+
+	// the report lists the files in the order of the manifest, regardless of the order of processing
+	fprintf(hReport, "# status\terror\ttime_ms\tin_bytes\tout_bytes\tinput\toutput\n");
+	failCount = 0;
+	for (curJob = 0; curJob < bs->jobCount; curJob ++)
+	{
+		BATCH_JOB* job = &bs->jobs[curJob];
+		if (job->status != BATCH_OK)
+			failCount ++;
+		fprintf(hReport, "%s\t%u\t%.3f\t%lu\t%lu\t%s\t%s\n", STATUS_NAMES[job->status], job->ret, job->time * 1000.0,
+			(unsigned long)job->inLen, (unsigned long)job->outLen, job->inName, job->outName);
+		free(job->inName);
+		free(job->outName);
+	}
+	free(bs->jobs);
+	bs->jobs = NULL;
+	if (hReport != stdout)
+		fclose(hReport);
+	else
+		fflush(hReport);
+
+	fprintf(stderr, "Batch: %u files, %u failed, %u threads, %.3f s\n", (unsigned)bs->jobCount, (unsigned)failCount, threads,
+		(double)(end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1.0E+9);
+	return (failCount > 0) ? 5 : 0;
+}
+
+static int RunBatch(const LZSS_CFG* cfg, uint8_t mode, const ARC_HDR_SPEC* hdrSpec, const char* listName,
+					const char* pattern, unsigned int threads, const char* reportName)
+{
+	BATCH_STATE bs;
+	uint8_t ret;
+
+	memset(&bs, 0x00, sizeof(BATCH_STATE));
+	bs.mode = mode;
+	bs.hdrSpec = hdrSpec;
+	if (IsDirectory(listName))
+		ret = ScanBatchDirectory(&bs, listName, pattern);
+	else
+		ret = ReadBatchManifest(&bs, listName);
+	if (ret)
+	{
+		fprintf(stderr, "Error reading file list: %s\n", listName);
+		return 2;
+	}
+	return ExecuteBatch(cfg, &bs, threads, reportName);
+}
+
+// --- multi-stream containers ---
+// Containers are indexed in one pass over the headers, then all streams are decoded by the batch workers.
+// Records: the archive header (-a) and its stream, repeated until the end of the file.
+// TOC: a table of stream offsets at the beginning of the file, each stream starts with the archive header.
+// output names: ABC.ext -> ABC_00.ext, ABC_01.ext, ...
+static void AddContainerJob(BATCH_STATE* bs, size_t* jobAlloc, const char* inName, const char* outName,
+							size_t srcOfs, size_t srcLen, size_t decSize)
+{
+	const char* fileExt;
+	char* jobIn;
+	char* jobOut;
+	BATCH_JOB* job;
+
+	jobIn = (char*)malloc(strlen(inName) + 0x14);
+	sprintf(jobIn, "%s@0x%lX", inName, (unsigned long)srcOfs);
+	fileExt = strrchr(outName, '.');
+	if (fileExt == NULL || strchr(fileExt, '/') != NULL || strchr(fileExt, '\\') != NULL)
+		fileExt = outName + strlen(outName);
+	jobOut = (char*)malloc(strlen(outName) + 0x14);
+	sprintf(jobOut, "%.*s_%02X%s", (int)(fileExt - outName), outName, (unsigned int)bs->jobCount, fileExt);
+
+	AddBatchJob(bs, jobAlloc, jobIn, jobOut);
+	job = &bs->jobs[bs->jobCount - 1];
+	job->srcOfs = srcOfs;
+	job->inLen = srcLen;
+	job->decSize = decSize;
+	return;
+}
+
+static uint8_t IndexRecords(BATCH_STATE* bs, const LZSS_CFG* cfg, const char* inName, const char* outName)
+{
+	const ARC_HDR_SPEC* hdrSpec = bs->hdrSpec;
+	LZSS_COMPR* lzss = NULL;
+	size_t jobAlloc = 0;
+	size_t pos;
+
+	if (! HeaderHasField(hdrSpec, 'c') && cfg->eosMode == LZSS_EOSM_NONE)
+	{
+		fprintf(stderr, "Records need a compressed size in the archive header or an end-of-stream marker.\n");
+		return 1;
+	}
+	pos = 0;
+	while(pos < bs->srcLen)
+	{
+		FILE_DATA hdrData;
+		size_t decSize = (size_t)-1;
+		size_t cmpSize = (size_t)-1;
+		size_t recLen;
+
+		hdrData.len = bs->srcLen - pos;
+		hdrData.data = (uint8_t*)&bs->srcData[pos];
+		if (hdrData.len < hdrSpec->len || ReadArchiveHeader(&hdrData, hdrSpec, &decSize, &cmpSize))
+		{
+			fprintf(stderr, "Stopping at offset 0x%lX, no record header there.\n", (unsigned long)pos);
+			break;
+		}
+		if (cmpSize == (size_t)-1)
+		{
+			// walk the units to find the end of the stream, the workers decode it later
+			if (lzss == NULL)
+			{
+				lzss = lzssCreate(cfg);
+				if (lzss == NULL)
+				{
+					fprintf(stderr, "Error creating the LZSS context!\n");
+					return 1;
+				}
+			}
+			lzssStreamSize(lzss, hdrData.len - hdrSpec->len, &hdrData.data[hdrSpec->len], NULL, &cmpSize);
+		}
+		recLen = hdrSpec->len + cmpSize;
+		if (recLen > hdrData.len)
+			recLen = hdrData.len;	// truncated, decoding reports the error
+		AddContainerJob(bs, &jobAlloc, inName, outName, pos, recLen, decSize);
+		if (recLen == 0)
+			break;
+		pos += recLen;
+	}
+	if (lzss != NULL)
+		lzssDestroy(lzss);
+	return 0;
+}
+
+static int SizeCompare(const void* a, const void* b)
+{
+	size_t valA = *(const size_t*)a;
+	size_t valB = *(const size_t*)b;
+	return (valA < valB) ? -1 : (valA > valB) ? 1 : 0;
+}
+
+// tocSpec: "<TOC header>/<TOC entry>" in archive header syntax, e.g. "k2/p4,o4"
+// Without 'k' the TOC ends where the stream with the lowest offset begins.
+static uint8_t IndexToc(BATCH_STATE* bs, const char* tocSpec, const char* inName, const char* outName)
+{
+	ARC_HDR_SPEC tocHdr;
+	ARC_HDR_SPEC tocEntry;
+	FILE_DATA tocData;
+	char* specStr;
+	char* sepPtr;
+	size_t* offsets;
+	size_t entryCnt;
+	size_t curEntry;
+	size_t jobAlloc = 0;
+	size_t hdrDecSize;
+	size_t hdrCmpSize;
+
+	// ParseHeaderSpec() keeps pointers to the string, so it must stay valid until the TOC is read
+	specStr = strdup(tocSpec);
+	sepPtr = strchr(specStr, '/');
+	if (sepPtr == NULL)
+	{
+		fprintf(stderr, "TOC specification needs a '/' between header and entry: %s\n", tocSpec);
+		free(specStr);
+		return 1;
+	}
+	*sepPtr = '\0';
+	ParseHeaderSpec(specStr, &tocHdr);
+	ParseHeaderSpec(sepPtr + 1, &tocEntry);
+	if (! HeaderHasField(&tocEntry, 'p'))
+	{
+		fprintf(stderr, "TOC entries need a stream offset (p).\n");
+		free(specStr);
+		return 1;
+	}
+
+	tocData.len = bs->srcLen;
+	tocData.data = (uint8_t*)bs->srcData;
+	if (tocData.len < tocHdr.len || ReadArchiveHeader(&tocData, &tocHdr, &hdrDecSize, &hdrCmpSize))
+	{
+		fprintf(stderr, "TOC header mismatch!\n");
+		free(specStr);
+		return 1;
+	}
+	entryCnt = GetHeaderValue(&tocData, &tocHdr, 'k');
+	if (entryCnt == (size_t)-1)
+	{
+		// read entries until reaching the lowest stream offset seen so far
+		size_t minOfs = bs->srcLen;
+		entryCnt = 0;
+		while(tocHdr.len + (entryCnt + 1) * tocEntry.len <= minOfs)
+		{
+			size_t streamOfs;
+			tocData.len = tocEntry.len;
+			tocData.data = (uint8_t*)&bs->srcData[tocHdr.len + entryCnt * tocEntry.len];
+			streamOfs = GetHeaderValue(&tocData, &tocEntry, 'p');
+			if (streamOfs < minOfs)
+				minOfs = streamOfs;
+			entryCnt ++;
+		}
+	}
+	if (entryCnt > (bs->srcLen - tocHdr.len) / tocEntry.len)
+	{
+		fprintf(stderr, "TOC with %lu entries doesn't fit into the file!\n", (unsigned long)entryCnt);
+		free(specStr);
+		return 1;
+	}
+
+	// a stream ends where the next one begins
+	offsets = (size_t*)malloc((entryCnt + 1) * sizeof(size_t));
+	if (offsets == NULL)
+	{
+		fprintf(stderr, "Not enough memory for a TOC with %lu entries!\n", (unsigned long)entryCnt);
+		free(specStr);
+		return 1;
+	}
+	for (curEntry = 0; curEntry < entryCnt; curEntry ++)
+	{
+		tocData.len = tocEntry.len;
+		tocData.data = (uint8_t*)&bs->srcData[tocHdr.len + curEntry * tocEntry.len];
+		offsets[curEntry] = GetHeaderValue(&tocData, &tocEntry, 'p');
+	}
+	offsets[entryCnt] = bs->srcLen;
+	qsort(offsets, entryCnt + 1, sizeof(size_t), SizeCompare);
+
+	for (curEntry = 0; curEntry < entryCnt; curEntry ++)
+	{
+		size_t decSize = (size_t)-1;
+		size_t cmpSize = (size_t)-1;
+		size_t streamOfs;
+		size_t streamEnd;
+		size_t idxL, idxR;
+		uint8_t hdrError;
+
+		tocData.len = tocEntry.len;
+		tocData.data = (uint8_t*)&bs->srcData[tocHdr.len + curEntry * tocEntry.len];
+		streamOfs = GetHeaderValue(&tocData, &tocEntry, 'p');
+		hdrError = ReadArchiveHeader(&tocData, &tocEntry, &decSize, &cmpSize);
+		// binary search for the first offset after the stream
+		idxL = 0;
+		idxR = entryCnt;
+		while(idxL < idxR)
+		{
+			size_t idxM = (idxL + idxR) / 2;
+			if (offsets[idxM] <= streamOfs)
+				idxL = idxM + 1;
+			else
+				idxR = idxM;
+		}
+		streamEnd = offsets[idxL];
+		if (streamEnd > bs->srcLen)
+			streamEnd = bs->srcLen;
+		if (streamOfs > bs->srcLen)
+			streamEnd = streamOfs;	// invalid offset, the job fails with an input error
+		else if (cmpSize != (size_t)-1 && streamEnd - streamOfs > bs->hdrSpec->len + cmpSize)
+			streamEnd = streamOfs + bs->hdrSpec->len + cmpSize;
+		AddContainerJob(bs, &jobAlloc, inName, outName, streamOfs, streamEnd - streamOfs, decSize);
+		if (hdrError)
+			bs->jobs[bs->jobCount - 1].status = BATCH_ERR_HEADER;	// s/b mismatch in the entry, the stream isn't decoded
+	}
+	free(offsets);
+	free(specStr);
+	return 0;
+}
+
+// contSpec: "r" for records, "t<TOC header>/<TOC entry>" for a table of contents
+static int RunContainer(const LZSS_CFG* cfg, const ARC_HDR_SPEC* hdrSpec, const char* contSpec, const char* inName,
+						const char* outName, unsigned int threads, const char* reportName)
+{
+	BATCH_STATE bs;
+	FILE_MAP inMap;
+	uint8_t ret;
+	int result;
+
+	if (MapInputFile(inName, &inMap))
+	{
+		fprintf(stderr, "Error opening input file: %s\n", inName);
+		return 2;
+	}
+	memset(&bs, 0x00, sizeof(BATCH_STATE));
+	bs.mode = MODE_DECODE;
+	bs.hdrSpec = hdrSpec;
+	bs.srcLen = inMap.len;
+	bs.srcData = inMap.data;
+	if (contSpec[0] == 'r')
+	{
+		ret = IndexRecords(&bs, cfg, inName, outName);
+	}
+	else if (contSpec[0] == 't')
+	{
+		ret = IndexToc(&bs, &contSpec[1], inName, outName);
+	}
+	else
+	{
+		fprintf(stderr, "Unknown container type: %s\n", contSpec);
+		ret = 1;
+	}
+	if (! ret)
+	{
+		size_t curJob;
+
+		for (curJob = 0; curJob < bs.jobCount; curJob ++)
+		{
+			if (IsSameFile(inName, bs.jobs[curJob].outName))
+			{
+				fprintf(stderr, "Output file %s would overwrite the container!\n", bs.jobs[curJob].outName);
+				ret = 1;
+				break;
+			}
+		}
+	}
+	if (ret)
+	{
+		UnmapFile(&inMap, 0);
+		return 4;
+	}
+	fprintf(stderr, "Container: %u streams\n", (unsigned)bs.jobCount);
+
+	result = ExecuteBatch(cfg, &bs, threads, reportName);
+	UnmapFile(&inMap, 0);
+	return result;
+}
+
+// --- configuration sniffer ---
+// Tries all combinations of header skip, control bit order, reference word format, name table and
+// name table start offset on the beginning of the file and ranks them by how "real" the decoded data looks.
+// The geometry (N/F/THRESHOLD) and end-of-stream mode are taken from the command line.
+#define SNIFF_PROBE1	0x100	// input bytes decoded for each candidate
+#define SNIFF_PROBE2	0x1000	// input bytes decoded for the best candidates
+#define SNIFF_KEEP		16		// number of candidates that get the full test
+#define SNIFF_SHOW		10		// number of candidates to print
+typedef struct sniff_candidate
 {
-	size_t len;
-	size_t count;
-	ARC_HDR_VAL vals[0x10];
-} ARC_HDR_SPEC;
+	unsigned int id;	// for stable sorting
+	size_t skip;
+	LZSS_CFG cfg;
+	double ntFrac;		// fraction of decoded bytes that depend on the name table contents
+	unsigned int alphabet;	// effective alphabet size of the decoded data (1..256)
+	double identity;	// fraction of the input reproduced by re-encoding the decoded data (< 0 = not tested)
+	const char* magic;	// known file signature at the start of the decoded data
+	double score;
+} SNIFF_CAND;
 
-typedef struct file_data
+static const struct
 {
 	size_t len;
-	uint8_t* data;
-} FILE_DATA;
+	const char* sig;
+	const char* name;
+} SNIFF_MAGIC[] =
+{
+	{4, "MThd", "MIDI"},
+	{4, "RIFF", "RIFF"},
+	{4, "Vgm ", "VGM"},
+	{4, "OggS", "Ogg"},
+	{4, "FORM", "IFF"},
+	{4, "PK\x03\x04", "ZIP"},
+	{4, "\x89PNG", "PNG"},
+	{2, "MZ", "EXE"},
+	{2, "BM", "BMP"},
+};
 
-#define MODE_NONE	0x00
-#define MODE_ENCODE	0x01
-#define MODE_DECODE	0x02
+static const char* SniffMagic(size_t len, const uint8_t* data)
+{
+	size_t curSig;
 
+	for (curSig = 0; curSig < sizeof(SNIFF_MAGIC) / sizeof(SNIFF_MAGIC[0]); curSig ++)
+	{
+		if (len >= SNIFF_MAGIC[curSig].len && ! memcmp(data, SNIFF_MAGIC[curSig].sig, SNIFF_MAGIC[curSig].len))
+			return SNIFF_MAGIC[curSig].name;
+	}
+	return NULL;
+}
 
-static void PrintHelp(const char* appName);
-static void ParseHeaderSpec(const char* spec, ARC_HDR_SPEC* header);
-static size_t WriteArchiveHeader(FILE_DATA* hdrData, const ARC_HDR_SPEC* hdrSpec, size_t decSize, size_t cmpSize);
-static uint8_t ReadArchiveHeader(const FILE_DATA* hdrData, const ARC_HDR_SPEC* hdrSpec, size_t* decSize, size_t* cmpSize);
+// returns len^2 / sum(count^2), i.e. 256 for uniformly distributed bytes and 1 for a single repeated byte
+// (a cheap stand-in for the order-0 entropy that needs no floating point logarithms)
+static unsigned int SniffAlphabet(size_t len, const uint8_t* data)
+{
+	size_t counts[0x100];
+	size_t pos;
+	double sum;
 
+	if (len == 0)
+		return 0x100;
+	memset(counts, 0x00, sizeof(counts));
+	for (pos = 0; pos < len; pos ++)
+		counts[data[pos]] ++;
+	sum = 0.0;
+	for (pos = 0; pos < 0x100; pos ++)
+		sum += (double)counts[pos] * counts[pos];
+	return (unsigned int)((double)len * len / sum + 0.5);
+}
 
-int main(int argc, char *argv[])
+// Decodes inLen bytes with the candidate's configuration and measures the result.
+// Returns 0 when the candidate can be ruled out.
+static int SniffTest(LZSS_COMPR* lzss, SNIFF_CAND* cand, size_t inLen, const uint8_t* inData,
+					size_t bufSize, uint8_t* decBuf, uint8_t* altBuf, int reEncode)
 {
-	FILE_DATA inFile;
-	FILE_DATA outFile;
-	ARC_HDR_SPEC arcHdrSpec;
+	LZSS_CFG altCfg;
+	size_t decLen;
+	size_t altLen;
+	size_t pos;
+	size_t diffs;
 	uint8_t ret;
-	FILE* fp;
-	LZSS_CFG cfg;
-	LZSS_COMPR* lzss;
-	int argbase;
-	uint8_t mode;
 
-	lzssGetDefaultConfig(&cfg);
-	argbase = 1;
-	mode = MODE_NONE;
-	arcHdrSpec.len = 0x00;
-	arcHdrSpec.count = 0;
-	while(argbase < argc)
+	if (cand->skip >= inLen)
+		return 0;
+	inData += cand->skip;
+	inLen -= cand->skip;
+
+	if (lzssReset(lzss, &cand->cfg) != LZSS_ERR_OK)
+		return 0;
+	ret = lzssDecode(lzss, bufSize, decBuf, &decLen, inLen, inData);
+	if (ret == LZSS_ERR_BAD_REF)
+		return 0;
+	if (decLen < inLen)
+		return 0;	// "compressed" data that is larger than the decoded data
+
+	// decode again with a different name table - bytes that change come from the name table
+	cand->ntFrac = 0.0;
+	if (cand->cfg.nameTblType != LZSS_NTINIT_NONE)
 	{
-		char* endptr;
-		long val;
-		if (!strcmp(argv[argbase], "-h"))	// help
-		{
-			PrintHelp(argv[0]);
+		altCfg = cand->cfg;
+		altCfg.nameTblValue = (altCfg.nameTblType == LZSS_NTINIT_VALUE) ? (altCfg.nameTblValue ^ 0xFF) : 0xA5;
+		altCfg.nameTblType = LZSS_NTINIT_VALUE;
+		if (lzssReset(lzss, &altCfg) != LZSS_ERR_OK)
 			return 0;
-		}
-		else if (!strcmp(argv[argbase], "-e"))	// encode
-		{
-			mode = MODE_ENCODE;
-		}
-		else if (!strcmp(argv[argbase], "-d"))	// decode
-		{
-			mode = MODE_DECODE;
-		}
-		else if (!strcmp(argv[argbase], "-a"))	// archive header
-		{
-			argbase ++;
-			if (argbase >= argc)
-			{
-				fprintf(stderr, "Insufficient arguments.\n");
-				return 1;
-			}
-			ParseHeaderSpec(argv[argbase], &arcHdrSpec);
-		}
-		else if (!strcmp(argv[argbase], "-n"))	// name table initialization value
-		{
-			argbase ++;
-			if (argbase >= argc)
-			{
-				fprintf(stderr, "Insufficient arguments.\n");
-				return 1;
-			}
-			val = strtol(argv[argbase], &endptr, 0);
-			if (argv[argbase][0] == 'n')
-			{
-				cfg.nameTblType = LZSS_NTINIT_NONE;
-			}
-			else if (argv[argbase][0] == 'p')
-			{
-				cfg.nameTblType = LZSS_NTINIT_FUNC;
-				cfg.nameTblFunc = lzssNameTbl_CommonPatterns;
-				cfg.ntFuncParam = NULL;
-			}
-			else if (endptr != argv[argbase])
-			{
-				cfg.nameTblType = LZSS_NTINIT_VALUE;
-				cfg.nameTblValue = (uint8_t)val;
-			}
-			else
-			{
-				fprintf(stderr, "Unknown name table initialization parameter: %s\n", argv[argbase]);
-				return 1;
-			}
-		}
-		else if (!strcmp(argv[argbase], "-C"))	// control word bit order
-		{
-			argbase ++;
-			if (argbase >= argc)
-			{
-				fprintf(stderr, "Insufficient arguments.\n");
-				return 1;
-			}
-			val = strtol(argv[argbase], &endptr, 0);
-			if (endptr != argv[argbase])
-			{
-				cfg.flags &= ~LZSS_FLAGS_CTRLMASK;
-				cfg.flags |= val ? LZSS_FLAGS_CTRL_M : LZSS_FLAGS_CTRL_L;
-			}
-		}
-		else if (!strcmp(argv[argbase], "-R"))	// nametable reference value
-		{
-			argbase ++;
-			if (argbase >= argc)
-			{
-				fprintf(stderr, "Insufficient arguments.\n");
-				return 1;
-			}
-			val = strtol(argv[argbase], &endptr, 0);
-			if (endptr != argv[argbase])
-			{
-				cfg.flags &= ~(LZSS_FLAGS_MTCH_EMASK | LZSS_FLAGS_MTCH_LMASK);
-				cfg.flags |= (uint8_t)(val << 4);
-			}
-		}
-		else if (!strcmp(argv[argbase], "-O"))	// start offset for writing to name table buffer
+		lzssDecode(lzss, bufSize, altBuf, &altLen, inLen, inData);
+		if (altLen > decLen)
+			altLen = decLen;
+		diffs = decLen - altLen;
+		for (pos = 0; pos < altLen; pos ++)
+			diffs += (decBuf[pos] != altBuf[pos]);
+		cand->ntFrac = (double)diffs / decLen;
+		if (cand->ntFrac > 0.5)
+			return 0;	// real data barely ever consists mostly of name table contents
+	}
+	cand->alphabet = SniffAlphabet(decLen, decBuf);
+	cand->magic = SniffMagic(decLen, decBuf);
+
+	cand->identity = -1.0;
+	if (reEncode)
+	{
+		// Our encoder works like Okumura's LZSS.C, which most of these formats are based on,
+		// so re-encoding the decoded data often gives back the input byte by byte.
+		LZSS_CFG encCfg = cand->cfg;
+		size_t encLen;
+		encCfg.level = 0;
+		encCfg.parser = LZSS_PARSE_GREEDY;
+		encCfg.storeMode = LZSS_STORE_OFF;
+		cand->identity = 0.0;
+		if (lzssReset(lzss, &encCfg) == LZSS_ERR_OK)
 		{
-			argbase ++;
-			if (argbase >= argc)
-			{
-				fprintf(stderr, "Insufficient arguments.\n");
-				return 1;
-			}
-			val = strtol(argv[argbase], &endptr, 0);
-			if (endptr != argv[argbase])
+			// only the part that overlaps the input is compared, so a full buffer (LZSS_ERR_EOF_OUT) is fine
+			lzssEncode(lzss, bufSize, altBuf, &encLen, decLen, decBuf);
+			for (pos = 0; pos < encLen && pos < inLen; pos ++)
 			{
-				cfg.nameTblStartOfs = (int)val;
+				if (altBuf[pos] != inData[pos])
+					break;
 			}
+			cand->identity = (double)pos / inLen;
 		}
-		else if (!strcmp(argv[argbase], "-E"))	// end-of-stream mode
+	}
+
+	cand->score = 30.0 * (1.0 - cand->ntFrac) + 10.0 * (1.0 - cand->alphabet / 256.0);
+	if (cand->magic != NULL)
+		cand->score += 20.0;
+	if (cand->identity > 0.0)
+		cand->score += 50.0 * cand->identity;
+	return 1;
+}
+
+static int SniffCandCompare(const void* a, const void* b)
+{
+	const SNIFF_CAND* ca = (const SNIFF_CAND*)a;
+	const SNIFF_CAND* cb = (const SNIFF_CAND*)b;
+
+	if (ca->score != cb->score)
+		return (ca->score < cb->score) ? +1 : -1;
+	return (ca->id < cb->id) ? -1 : +1;	// keep the order of the candidate list for equal scores
+}
+
+static void SniffConfig(const LZSS_CFG* baseCfg, size_t inLen, const uint8_t* inData)
+{
+	static const size_t SKIPS[] = {0, 2, 4, 8, 0x10};
+	static const int NT_TYPES[] = {0x20, 0x00, 0xFF, -LZSS_NTINIT_FUNC, -LZSS_NTINIT_NONE};
+	const size_t skipCnt = sizeof(SKIPS) / sizeof(SKIPS[0]);
+	const size_t ntCnt = sizeof(NT_TYPES) / sizeof(NT_TYPES[0]);
+	LZSS_COMPR* lzss;
+	SNIFF_CAND* cands;
+	size_t candCnt;
+	size_t validCnt;
+	size_t curCand;
+	size_t bufSize;
+	uint8_t* decBuf;
+	uint8_t* altBuf;
+	size_t probeLen;
+
+	candCnt = skipCnt * 2 * 8 * ntCnt * 2;
+	cands = (SNIFF_CAND*)calloc(candCnt, sizeof(SNIFF_CAND));
+	bufSize = SNIFF_PROBE2 * baseCfg->F + 0x10;	// every 2 input bytes may become F bytes
+	decBuf = (uint8_t*)malloc(bufSize);
+	altBuf = (uint8_t*)malloc(bufSize);
+	lzss = lzssCreate(baseCfg);
+	if (cands == NULL || decBuf == NULL || altBuf == NULL || lzss == NULL)
+	{
+		fprintf(stderr, "Memory allocation failed!\n");
+		if (lzss != NULL)
+			lzssDestroy(lzss);
+		free(cands);	free(decBuf);	free(altBuf);
+		return;
+	}
+
+	for (curCand = 0; curCand < candCnt; curCand ++)
+	{
+		SNIFF_CAND* cand = &cands[curCand];
+		size_t idx = curCand;
+		int ntType;
+
+		cand->id = (unsigned int)curCand;
+		cand->skip = SKIPS[idx % skipCnt];			idx /= skipCnt;
+		ntType = NT_TYPES[idx % ntCnt];				idx /= ntCnt;
+		cand->cfg = *baseCfg;
+		cand->cfg.decoder = LZSS_DEC_AUTO;
+		cand->cfg.nameTblStartOfs = (idx % 2) ? 0 : LZSS_NTSTOFS_NF;	idx /= 2;
+		cand->cfg.flags &= ~(LZSS_FLAGS_CTRLMASK | LZSS_FLAGS_MTCH_EMASK | LZSS_FLAGS_MTCH_LMASK);
+		cand->cfg.flags |= (idx % 2) ? LZSS_FLAGS_CTRL_M : LZSS_FLAGS_CTRL_L;	idx /= 2;
+		cand->cfg.flags |= (uint8_t)((idx % 8) << 4);
+		if (ntType >= 0)
 		{
-			argbase ++;
-			if (argbase >= argc)
-			{
-				fprintf(stderr, "Insufficient arguments.\n");
-				return 1;
-			}
-			val = strtol(argv[argbase], &endptr, 0);
-			if (endptr != argv[argbase])
-			{
-				cfg.eosMode = (uint8_t)val;
-			}
+			cand->cfg.nameTblType = LZSS_NTINIT_VALUE;
+			cand->cfg.nameTblValue = (uint8_t)ntType;
 		}
 		else
 		{
-			break;
+			cand->cfg.nameTblType = (uint8_t)-ntType;
+			cand->cfg.nameTblFunc = lzssNameTbl_CommonPatterns;
+			cand->cfg.ntFuncParam = NULL;
 		}
-		argbase ++;
 	}
 
-	if (argc < argbase + 2)
-	{
-		PrintHelp(argv[0]);
-		return 1;
-	}
-	if (mode == MODE_NONE)
+	// round 1: decode a short piece with every candidate and drop the ones that fail
+	probeLen = (inLen < SNIFF_PROBE1) ? inLen : SNIFF_PROBE1;
+	validCnt = 0;
+	for (curCand = 0; curCand < candCnt; curCand ++)
 	{
-		fprintf(stderr, "No mode specified!\n");
-		return 1;
+		if (SniffTest(lzss, &cands[curCand], probeLen, inData, bufSize, decBuf, altBuf, 0))
+			cands[validCnt ++] = cands[curCand];
 	}
+	qsort(cands, validCnt, sizeof(SNIFF_CAND), SniffCandCompare);
 
-	fp = fopen(argv[argbase + 0], "rb");
-	if (fp == NULL)
+	// round 2: test the best ones on a larger piece, including a re-encoding check
+	if (validCnt > SNIFF_KEEP)
+		validCnt = SNIFF_KEEP;
+	probeLen = (inLen < SNIFF_PROBE2) ? inLen : SNIFF_PROBE2;
+	candCnt = validCnt;
+	validCnt = 0;
+	for (curCand = 0; curCand < candCnt; curCand ++)
 	{
-		fprintf(stderr, "Error opening input file: %s\n", argv[argbase + 0]);
-		return 2;
+		if (SniffTest(lzss, &cands[curCand], probeLen, inData, bufSize, decBuf, altBuf, 1))
+			cands[validCnt ++] = cands[curCand];
 	}
-	fseek(fp, 0, SEEK_END);
-	inFile.len = ftell(fp);
-	rewind(fp);
-	inFile.data = (uint8_t*)malloc(inFile.len);
-	fread(inFile.data, 1, inFile.len, fp);
-	fclose(fp);
-
-	lzss = lzssCreate(&cfg);
-	if (mode == MODE_ENCODE)
-	{
-		size_t encDataSize;
-		size_t dataOfs = arcHdrSpec.len;
-		outFile.len = dataOfs + inFile.len + inFile.len / 8 + 1;
-		outFile.data = (uint8_t*)malloc(outFile.len);
-
-		ret = lzssEncode(lzss, outFile.len - dataOfs, &outFile.data[dataOfs], &encDataSize, inFile.len, inFile.data);
-		fprintf(stderr, "In : %u bytes\n", inFile.len);
-		fprintf(stderr, "Out: %u bytes\n", encDataSize);
-		fprintf(stderr, "Ratio: %.2f %%\n", (double)encDataSize / inFile.len * 100.0);
+	qsort(cands, validCnt, sizeof(SNIFF_CAND), SniffCandCompare);
 
-		WriteArchiveHeader(&outFile, &arcHdrSpec, inFile.len, encDataSize);
-		outFile.len = dataOfs + encDataSize;
-	}
-	else //if (mode == MODE_DECODE)
+	if (validCnt == 0)
+		printf("No working configuration found.\n");
+	else
+		printf("Rank  Score  Options                             Skip  NT-ref  Alphabet  Re-enc  Magic\n");
+	for (curCand = 0; curCand < validCnt && curCand < SNIFF_SHOW; curCand ++)
 	{
-		size_t cmpSize = inFile.len;
-		size_t dataOfs = arcHdrSpec.len;
-		outFile.len = inFile.len * 8;	// assume compression up to 12.5%
-		ret = ReadArchiveHeader(&inFile, &arcHdrSpec, &outFile.len, &cmpSize);
-		if (ret)
-		{
-			fprintf(stderr, "Header parsing error!\n");
-			return 4;
-		}
-		if (inFile.len > dataOfs + cmpSize)
-			inFile.len = dataOfs + cmpSize;
-		outFile.data = (uint8_t*)malloc(outFile.len);
-		ret = lzssDecode(lzss, outFile.len, outFile.data, &outFile.len, inFile.len - dataOfs, &inFile.data[dataOfs]);
-	}
-	if (ret != LZSS_ERR_OK)
-		fprintf(stderr, "LZSS error code %u after writing %u bytes.\n", ret, (unsigned)outFile.len);
+		const SNIFF_CAND* cand = &cands[curCand];
+		char ntStr[0x10];
+		char ofsStr[0x10];
+		char optStr[0x40];
 
-	fp = fopen(argv[argbase + 1], "wb");
-	if (fp == NULL)
-	{
-		fprintf(stderr, "Error opening output file: %s\n", argv[argbase + 1]);
-		return 3;
+		if (cand->cfg.nameTblType == LZSS_NTINIT_NONE)
+			strcpy(ntStr, "n");
+		else if (cand->cfg.nameTblType == LZSS_NTINIT_FUNC)
+			strcpy(ntStr, "p");
+		else
+			sprintf(ntStr, "0x%02X", cand->cfg.nameTblValue);
+		if (cand->cfg.nameTblStartOfs == LZSS_NTSTOFS_NF)
+			sprintf(ofsStr, "0x%X", cand->cfg.N - cand->cfg.F);
+		else
+			sprintf(ofsStr, "%d", cand->cfg.nameTblStartOfs);
+		sprintf(optStr, "-n %s -C %u -R 0x%02X -O %s", ntStr,
+				(cand->cfg.flags & LZSS_FLAGS_CTRLMASK) ? 1 : 0, (cand->cfg.flags >> 4) & 0x07, ofsStr);
+		printf("%4u  %5.1f  %-34s  %4u  %5.1f%%  %8u  %5.1f%%  %s\n", (unsigned int)(curCand + 1), cand->score, optStr,
+				(unsigned int)cand->skip, cand->ntFrac * 100.0, cand->alphabet, cand->identity * 100.0,
+				(cand->magic != NULL) ? cand->magic : "-");
 	}
-	fwrite(outFile.data, 1, outFile.len, fp);
-	fclose(fp);
 
-	return 0;
+	lzssDestroy(lzss);
+	free(cands);	free(decBuf);	free(altBuf);
+	return;
 }
 
 static void PrintHelp(const char* appName)
 {
 	fprintf(stderr, "Usage: %s [mode/options] input.bin output.bin\n", appName);
+	fprintf(stderr, "Use \"-\" as file name for stdin/stdout.\n");
 	fprintf(stderr, "\n");
 	fprintf(stderr, "Mode: (required)\n");
 	fprintf(stderr, "    -h    show this help screen\n");
 	fprintf(stderr, "    -e    encode / compress\n");
 	fprintf(stderr, "    -d    decode / decompress\n");
+	fprintf(stderr, "    -s    sniff - guess the configuration of a compressed file (no output file)\n");
+	fprintf(stderr, "          Uses the geometry set by -N/-T/-F and ranks name table, -C, -R and -O settings.\n");
+	fprintf(stderr, "\n");
+	fprintf(stderr, "Decoding options:\n");
+	fprintf(stderr, "    -X f  index file for random access (written when decoding without -r or when it\n");
+	fprintf(stderr, "          doesn't exist yet, read when it exists)\n");
+	fprintf(stderr, "    -r o,l  decode only l bytes starting at decoded offset o, using the index from -X\n");
+	fprintf(stderr, "          (which is built first when it doesn't exist)\n");
+	fprintf(stderr, "\n");
+	fprintf(stderr, "Statistics:\n");
+	fprintf(stderr, "    --stats  print unit/byte counts and a checksum of the output as JSON to stdout\n");
+	fprintf(stderr, "          (stderr when the output is stdout, not for -r)\n");
+	fprintf(stderr, "    -H n  checksum for --stats (0 = none, 1 = CRC32 [default], 2 = xxHash64)\n");
 	fprintf(stderr, "\n");
 	fprintf(stderr, "File format options:\n");
 	fprintf(stderr, "    -a .. add/read archive header (list of comma-separated values)\n");
 	fprintf(stderr, "              n   - none, don't add any header [default]\n");
 	fprintf(stderr, "              oNE - original size\n");
 	fprintf(stderr, "              cNE - compressed size\n");
+	fprintf(stderr, "              kNE - number of TOC entries (-m t only)\n");
+	fprintf(stderr, "              pNE - stream offset (-m t only)\n");
 	fprintf(stderr, "                     N = size of the value in bytes (2/4)\n");
 	fprintf(stderr, "                     E = endianess (L = little [default], B = big) [optional]\n");
 	fprintf(stderr, "              sABC - string \"ABC\"\n");
@@ -298,8 +2055,66 @@ static void PrintHelp(const char* appName)
 	fprintf(stderr, "          mask 0x03: nibble position (0 = highest .. 3 = lowest)\n");
 	fprintf(stderr, "          mask 0x04: byte endianess (0 = Little Endian, 4 = Big Endian)\n");
 	fprintf(stderr, "    -O n  offset where name table buffer starts getting written to\n");
-	fprintf(stderr, "          (range: 0x000..0xFFF, default: 0xFEE)\n");
+	fprintf(stderr, "          (range: 0..N-1, default: N-F, i.e. 0xFEE)\n");
 	fprintf(stderr, "    -E n  end-of-stream mode (0 = no EOS marker, 1 = end with null-reference)\n");
+	fprintf(stderr, "    -M n  match finder for encoding (0 = binary trees [default], 1 = hash chains)\n");
+	fprintf(stderr, "    -N n  ring buffer size N (power of 2, 0x100..0x8000, default: 0x1000)\n");
+	fprintf(stderr, "          The reference word uses log2(N) bits for the offset and the remaining bits\n");
+	fprintf(stderr, "          for the length. F is set to the largest length possible.\n");
+	fprintf(stderr, "    -T n  threshold, matches must be longer than this (default: 2)\n");
+	fprintf(stderr, "    -F n  maximum match length F (default: 18, at most N/2)\n");
+	fprintf(stderr, "          -N and -T adjust F, so they should be specified before -F.\n");
+	fprintf(stderr, "    -L n  compression level (1 = fastest .. 9 = best, 0 = full search [default])\n");
+	fprintf(stderr, "          Levels limit the match search and enable lazy matching from level 6 on.\n");
+	fprintf(stderr, "    -P n  parser (0 = greedy [default], 1 = optimal - smallest output, needs more time)\n");
+	fprintf(stderr, "    -S n  incompressible data (0 = always search for matches,\n");
+	fprintf(stderr, "          1 = send it as literals without searching [default], greedy parser only)\n");
+	fprintf(stderr, "\n");
+	fprintf(stderr, "Batch mode: (no file names on the command line)\n");
+	fprintf(stderr, "    -B f  encode/decode all files listed in f, one \"input<TAB>output\" per line\n");
+	fprintf(stderr, "          (the output name is optional), or all files in directory f\n");
+	fprintf(stderr, "          Default output names: input.lz when encoding, input without .lz (or\n");
+	fprintf(stderr, "          input.dec) when decoding.\n");
+	fprintf(stderr, "    -g p  file name pattern for directories (* and ?, default: *)\n");
+	fprintf(stderr, "    -j n  worker threads (default: %u)\n", BATCH_THREADS);
+	fprintf(stderr, "    --report f  write the per-file status/timing report to f (default: stdout)\n");
+	fprintf(stderr, "\n");
+	fprintf(stderr, "Multi-stream containers: (decoding only, -j and --report apply as well)\n");
+	fprintf(stderr, "    -m r  records: archive header (-a) + stream, repeated until the end of the file\n");
+	fprintf(stderr, "          (needs c in the header or an end-of-stream marker)\n");
+	fprintf(stderr, "    -m tH/E  table of contents: TOC header H and entries E in -a syntax.\n");
+	fprintf(stderr, "          E needs a stream offset p, k in H is the number of entries (otherwise\n");
+	fprintf(stderr, "          the TOC ends at the lowest stream offset). o/c in E are used as well.\n");
+	fprintf(stderr, "          Example: -m tk2/p4,c4\n");
+	fprintf(stderr, "    Stream n is written to output_nn.ext.\n");
+	return;
+}
+
+static void PrintStatsJson(FILE* hFile, const char* mode, const LZSS_STATS* stats)
+{
+	static const char* HASH_NAMES[3] = {"none", "crc32", "xxh64"};
+	unsigned int curLen;
+	unsigned int curByte;
+	int first;
+
+	fprintf(hFile, "{\"mode\": \"%s\", ", mode);
+	fprintf(hFile, "\"bytes_in\": %lu, \"bytes_out\": %lu, ", (unsigned long)stats->bytesIn, (unsigned long)stats->bytesOut);
+	fprintf(hFile, "\"literals\": %lu, \"matches\": %lu, ", (unsigned long)stats->literals, (unsigned long)stats->matches);
+	// only lengths that occur, the last entry counts all longer matches as well
+	fprintf(hFile, "\"match_lengths\": {");
+	first = 1;
+	for (curLen = 0; curLen < LZSS_STATS_LENS; curLen ++)
+	{
+		if (stats->matchLen[curLen] == 0)
+			continue;
+		fprintf(hFile, "%s\"%u\": %lu", first ? "" : ", ", curLen, (unsigned long)stats->matchLen[curLen]);
+		first = 0;
+	}
+	fprintf(hFile, "}, ");
+	fprintf(hFile, "\"hash_type\": \"%s\", \"hash\": \"", (stats->hashType < 3) ? HASH_NAMES[stats->hashType] : "?");
+	for (curByte = 0; curByte < stats->hashSize; curByte ++)
+		fprintf(hFile, "%02x", stats->hash[curByte]);
+	fprintf(hFile, "\"}\n");
 	return;
 }
 
@@ -355,7 +2170,7 @@ static void ParseHeaderSpec(const char* spec, ARC_HDR_SPEC* header)
 			header->count = 0;
 			break;
 		}
-		else if (mode == 'o' || mode == 'c')
+		else if (mode == 'o' || mode == 'c' || mode == 'k' || mode == 'p')
 		{
 			size_t param_len = strlen(spec_ptr);
 			uint8_t is_good = 1;
@@ -511,13 +2326,15 @@ static size_t WriteArchiveHeader(FILE_DATA* hdrData, const ARC_HDR_SPEC* hdrSpec
 			return 0x00;
 		case 'o':
 		case 'c':
+		case 'k':
+		case 'p':
 		{
-			size_t val = 0;
+			size_t val = 0;	// container fields aren't written
 			if (pos + ahv->d.size.bytes > hdrData->len)
 				break;
 			if (ahv->type == 'o')
 				val = decSize;
-			else //if (ahv->type == 'c')
+			else if (ahv->type == 'c')
 				val = cmpSize;
 			if (ahv->d.size.endianess == ENDIAN_LITTLE)
 				WriteLE(&hdrData->data[pos], ahv->d.size.bytes, val);
@@ -564,6 +2381,8 @@ static uint8_t ReadArchiveHeader(const FILE_DATA* hdrData, const ARC_HDR_SPEC* h
 			return 0;
 		case 'o':
 		case 'c':
+		case 'k':
+		case 'p':
 		{
 			size_t val;
 			if (pos + ahv->d.size.bytes > hdrData->len)
@@ -572,7 +2391,7 @@ static uint8_t ReadArchiveHeader(const FILE_DATA* hdrData, const ARC_HDR_SPEC* h
 				val = ReadLE(&hdrData->data[pos], ahv->d.size.bytes);
 			else //if (ahv->d.size.endianess == ENDIAN_BIG)
 				val = ReadBE(&hdrData->data[pos], ahv->d.size.bytes);
-			if (ahv->d.size.set_val)
+			if (ahv->d.size.set_val)	// only for 'o' and 'c'
 			{
 				if (ahv->type == 'o')
 					*decSize = val;
@@ -612,3 +2431,40 @@ static uint8_t ReadArchiveHeader(const FILE_DATA* hdrData, const ARC_HDR_SPEC* h
 	}
 	return 0;
 }
+
+// returns the value of the first header item of the specified type or (size_t)-1 if there is none
+static size_t GetHeaderValue(const FILE_DATA* hdrData, const ARC_HDR_SPEC* hdrSpec, char type)
+{
+	size_t hdrItem;
+	size_t pos;
+
+	pos = 0x00;
+	for (hdrItem = 0; hdrItem < hdrSpec->count; hdrItem++)
+	{
+		const ARC_HDR_VAL* ahv = &hdrSpec->vals[hdrItem];
+		switch (ahv->type)
+		{
+		case 'o':
+		case 'c':
+		case 'k':
+		case 'p':
+			if (ahv->type == type && pos + ahv->d.size.bytes <= hdrData->len)
+			{
+				if (ahv->d.size.endianess == ENDIAN_LITTLE)
+					return ReadLE(&hdrData->data[pos], ahv->d.size.bytes);
+				else //if (ahv->d.size.endianess == ENDIAN_BIG)
+					return ReadBE(&hdrData->data[pos], ahv->d.size.bytes);
+			}
+			pos += ahv->d.size.bytes;
+			break;
+		case 's':
+			pos += ahv->d.str.len;
+			break;
+		case 'b':
+		case 'i':
+			pos += 0x01;
+			break;
+		}
+	}
+	return (size_t)-1;
+}
@@ -22,9 +22,11 @@ typedef unsigned short	UINT16;
 typedef   signed short	 INT16;
 
 #endif	// HAVE_STDINT
+#include "file-map.h"
 
 
 static void DecompressFile(size_t inSize, const UINT8* inData, const char* fileName);
+static size_t MRN_Decode(size_t inSize, const UINT8* inData, size_t outSize, UINT8* outData, size_t* bytesRead);
 static UINT16 ReadLE16(const UINT8* data);
 
 
@@ -34,9 +36,9 @@ static size_t songCnt = 20;
 int main(int argc, char* argv[])
 {
 	int argbase;
-	FILE* hFile;
 	size_t inLen;
 	UINT8* inData;
+	FILE_MAP inMap;
 #ifdef _WIN32
 	FILETIME ftWrite;
 	HANDLE hWinFile;
@@ -64,20 +66,12 @@ int main(int argc, char* argv[])
 		return 0;
 	}
 	
-	hFile = fopen(argv[argbase + 0], "rb");
-	if (hFile == NULL)
+	// the output may overwrite the input file, so it must not stay mapped then
+	if (IsSameFile(argv[argbase + 0], argv[argbase + 1]) ? ReadInputFile(argv[argbase + 0], &inMap) :
+		MapInputFile(argv[argbase + 0], &inMap))
 		return 1;
-	
-	fseek(hFile, 0, SEEK_END);
-	inLen = ftell(hFile);
-	if (inLen > 0x1000000)
-		inLen = 0x1000000;	// limit to 16 MB
-	
-	inData = (UINT8*)malloc(inLen);
-	fseek(hFile, 0, SEEK_SET);
-	fread(inData, 0x01, inLen, hFile);
-	
-	fclose(hFile);
+	inLen = inMap.len;
+	inData = inMap.data;
 	
 #ifdef _WIN32
 	ftWrite.dwLowDateTime = ftWrite.dwHighDateTime = 0;
@@ -103,7 +97,7 @@ int main(int argc, char* argv[])
 	}
 #endif
 	
-	free(inData);
+	UnmapFile(&inMap, 0);
 	
 	return 0;
 }
@@ -114,21 +108,44 @@ static void DecompressFile(size_t inSize, const UINT8* inData, const char* fileN
 	UINT8* decBuf;
 	size_t inPos;
 	size_t outPos;
+	
+	decBuf = (UINT8*)malloc(0x10000);	// 64 KB for now
+	outPos = MRN_Decode(inSize, inData, 0x10000, decBuf, &inPos);
+	
+	printf("%u bytes -> %u bytes.\n", inPos, outPos);
+	
+	hFile = fopen(fileName, "wb");
+	if (hFile == NULL)
+	{
+		printf("Error writing %s!\n", fileName);
+	}
+	else
+	{
+		fwrite(decBuf, 1, outPos, hFile);
+		fclose(hFile);
+	}
+	free(decBuf);
+	
+	return;
+}
+
+static size_t MRN_Decode(size_t inSize, const UINT8* inData, size_t outSize, UINT8* outData, size_t* bytesRead)
+{
+	size_t inPos;
+	size_t outPos;
 	UINT16 ctrlData;	// reg BP
 	UINT8 ctrlBits;		// reg DL
 	UINT8 carry;
 	UINT16 copyCnt;	// reg CX
 	INT16 copyOfs;	// reg BX
 	
-	decBuf = (UINT8*)malloc(0x10000);	// 64 KB for now
-	
 	inPos = 0x00;
 	outPos = 0x00;
 	
 	ctrlData = ReadLE16(&inData[inPos]);	inPos += 0x02;
 	ctrlBits = 16;
 	copyCnt = 0;
-	while(inPos < inSize && outPos < 0x10000)
+	while(inPos < inSize && outPos < outSize)
 	{
 		//loc_10C44
 		carry = (ctrlData & 0x01);
@@ -141,7 +158,7 @@ static void DecompressFile(size_t inSize, const UINT8* inData, const char* fileN
 		}
 		if (carry)
 		{
-			decBuf[outPos] = inData[inPos];
+			outData[outPos] = inData[inPos];
 			inPos ++;	outPos ++;
 			continue;
 		}
@@ -216,26 +233,13 @@ static void DecompressFile(size_t inSize, const UINT8* inData, const char* fileN
 		}
 		for (; copyCnt > 0; copyCnt --)
 		{
-			decBuf[outPos] = decBuf[outPos + copyOfs];
+			outData[outPos] = outData[outPos + copyOfs];
 			outPos ++;
 		}
 	}
 	
-	printf("%u bytes -> %u bytes.\n", inPos, outPos);
-	
-	hFile = fopen(fileName, "wb");
-	if (hFile == NULL)
-	{
-		printf("Error writing %s!\n", fileName);
-	}
-	else
-	{
-		fwrite(decBuf, 1, outPos, hFile);
-		fclose(hFile);
-	}
-	free(decBuf);
-	
-	return;
+	*bytesRead = inPos;
+	return outPos;
 }
 
 static UINT16 ReadLE16(const UINT8* data)
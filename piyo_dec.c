@@ -2,6 +2,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>	// for memcmp/memcpy
+#include "file-map.h"
 
 typedef unsigned char UINT8;
 typedef unsigned short UINT16;
@@ -20,6 +21,7 @@ int main(int argc, char* argv[])
 	size_t srcLen;
 	size_t decLen;
 	UINT8* data;
+	FILE_MAP inMap;
 	
 	printf("PANDA HOUSE 'PIYO' decoder\n--------------------------\n");
 	if (argc < 3)
@@ -30,23 +32,15 @@ int main(int argc, char* argv[])
 	}
 	
 	argbase = 1;
-	hFile = fopen(argv[argbase + 0], "rb");
-	if (hFile == NULL)
+	// the output may overwrite the input file, so it must not stay mapped then
+	if (IsSameFile(argv[argbase + 0], argv[argbase + 1]) ? ReadInputFile(argv[argbase + 0], &inMap) :
+		MapInputFileCopy(argv[argbase + 0], &inMap))
 	{
 		printf("Error opening file!\n");
 		return 1;
 	}
-	
-	fseek(hFile, 0x00, SEEK_END);
-	srcLen = ftell(hFile);
-	if (srcLen > 0x100000)	// 1 MB
-		srcLen = 0x100000;
-	
-	fseek(hFile, 0x00, SEEK_SET);
-	data = (UINT8*)malloc(srcLen);
-	fread(data, 0x01, srcLen, hFile);
-	
-	fclose(hFile);
+	srcLen = inMap.len;
+	data = inMap.data;
 	
 	if (data[0x00] == 0xE9)	// 8086 jump instruction
 	{
@@ -66,7 +60,7 @@ int main(int argc, char* argv[])
 		hFile = fopen(argv[argbase + 1], "wb");
 		if (hFile == NULL)
 		{
-			free(data);
+			UnmapFile(&inMap, 0);
 			printf("Error opening %s!\n", argv[argbase + 1]);
 			return 2;
 		}
@@ -76,7 +70,7 @@ int main(int argc, char* argv[])
 		printf("Done.\n");
 	}
 	
-	free(data);
+	UnmapFile(&inMap, 0);
 	
 #ifdef _DEBUG
 	getchar();
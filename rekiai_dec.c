@@ -6,6 +6,7 @@
 #include <string.h>
 
 #include "stdtype.h"
+#include "file-map.h"
 
 
 static const char* GetFileExt(const char* filePath);
@@ -16,9 +17,9 @@ static UINT16 ReadBE16(const UINT8* Data);
 int main(int argc, char* argv[])
 {
 	int argbase;
-	FILE* hFile;
 	UINT32 inLen;
 	UINT8* inData;
+	FILE_MAP inMap;
 	
 	printf("Rekiai Song Unpacker\n--------------------\n");
 	if (argc < 3)
@@ -35,24 +36,14 @@ int main(int argc, char* argv[])
 		return 0;
 	}
 	
-	hFile = fopen(argv[argbase + 0], "rb");
-	if (hFile == NULL)
+	if (MapInputFile(argv[argbase + 0], &inMap))
 		return 1;
-	
-	fseek(hFile, 0, SEEK_END);
-	inLen = ftell(hFile);
-	if (inLen > 0x100000)
-		inLen = 0x100000;	// limit to 1 MB
-	
-	inData = (UINT8*)malloc(inLen);
-	fseek(hFile, 0, SEEK_SET);
-	fread(inData, 0x01, inLen, hFile);
-	
-	fclose(hFile);
+	inLen = inMap.len;
+	inData = inMap.data;
 	
 	DecompressArchive(inLen, inData, argv[argbase + 1]);
 	
-	free(inData);
+	UnmapFile(&inMap, 0);
 	
 	return 0;
 }
@@ -6,6 +6,7 @@
 #include <string.h>
 
 #include "stdtype.h"
+#include "file-map.h"
 
 
 // Byte Order constants
@@ -28,9 +29,9 @@ static UINT8 fmtByteOrder = 0;
 int main(int argc, char* argv[])
 {
 	int argbase;
-	FILE* hFile;
 	UINT32 inLen;
 	UINT8* inData;
+	FILE_MAP inMap;
 	UINT8 fileFmt;
 	
 	printf("Wolfteam Decompressor\n---------------------\n");
@@ -78,20 +79,12 @@ int main(int argc, char* argv[])
 		return 0;
 	}
 	
-	hFile = fopen(argv[argbase + 0], "rb");
-	if (hFile == NULL)
+	// the output may overwrite the input file, so it must not stay mapped then
+	if (IsSameFile(argv[argbase + 0], argv[argbase + 1]) ? ReadInputFile(argv[argbase + 0], &inMap) :
+		MapInputFile(argv[argbase + 0], &inMap))
 		return 1;
-	
-	fseek(hFile, 0, SEEK_END);
-	inLen = ftell(hFile);
-	if (inLen > 0x1000000)
-		inLen = 0x1000000;	// limit to 16 MB
-	
-	inData = (UINT8*)malloc(inLen);
-	fseek(hFile, 0, SEEK_SET);
-	fread(inData, 0x01, inLen, hFile);
-	
-	fclose(hFile);
+	inLen = inMap.len;
+	inData = inMap.data;
 	
 	if (fileFmt == 0)
 	{
@@ -129,7 +122,7 @@ int main(int argc, char* argv[])
 		break;
 	}
 	
-	free(inData);
+	UnmapFile(&inMap, 0);
 	
 	return 0;
 }
@@ -126,6 +126,8 @@
 #include <string.h>
 
 #include "stdtype.h"
+#include "lzss-lib.h"
+#include "file-map.h"
 
 
 #ifdef _MSC_VER
@@ -209,9 +211,9 @@ static int PatOut_Base = 0;
 int main(int argc, char* argv[])
 {
 	int argbase;
-	FILE* hFile;
 	UINT32 inLen;
 	UINT8* inData;
+	FILE_MAP inMap;
 	
 	printf("X68000 S.P.S. Archive Unpacker\n------------------------------\n");
 	if (argc < 3)
@@ -310,30 +312,22 @@ int main(int argc, char* argv[])
 		return 0;
 	}
 	
-	hFile = fopen(argv[argbase + 0], "rb");
-	if (hFile == NULL)
+	// the output may overwrite the input file, so it must not stay mapped then
+	if (IsSameFile(argv[argbase + 0], argv[argbase + 1]) ? ReadInputFile(argv[argbase + 0], &inMap) :
+		MapInputFile(argv[argbase + 0], &inMap))
 	{
 		printf("Error opening %s!\n", argv[argbase + 0]);
 		return 1;
 	}
-	
-	fseek(hFile, 0, SEEK_END);
-	inLen = ftell(hFile);
-	if (inLen > 0x100000)
-		inLen = 0x100000;	// limit to 1 MB
-	
-	inData = (UINT8*)malloc(inLen);
-	fseek(hFile, 0, SEEK_SET);
-	fread(inData, 0x01, inLen, hFile);
-	
-	fclose(hFile);
+	inLen = inMap.len;
+	inData = inMap.data;
 	
 	if (ArchiveType == ARC_AUTO)
 		FormatDetection(inLen, inData);	// will adjust ArchiveType according to the detection
 	if (ArchiveType == ARC_AUTO)
 	{
 		printf("Unknown archive type! Please specify the archive type manually\n");
-		free(inData);
+		UnmapFile(&inMap, 0);
 		return 2;
 	}
 	printf("Archive format: %s\n", GetNameListByType(ARCHIVE_FMTS, ArchiveType)->longName);
@@ -360,7 +354,7 @@ int main(int argc, char* argv[])
 		break;
 	}
 	
-	free(inData);
+	UnmapFile(&inMap, 0);
 	
 	return 0;
 }
@@ -774,12 +768,22 @@ static void ExtractSLD_FF_Archive(UINT32 arcSize, const UINT8* arcData, const ch
 	UINT32 decSize;
 	UINT8* decBuffer;
 	UINT32 outSize;
+	LZSS_CFG cfg;
+	LZSS_COMPR* lzss;
+	size_t streamSize;
 	
 	printf("Compression: %s\n", GetNameListByType(COMPR_FMTS, LZSS_SPS_V1)->longName);
-	decSize = arcSize * 8;
+	// LZSS-SPS v1 is standard LZSS, so lzss-lib can tell the exact size of the decompressed data.
+	lzssGetDefaultConfig(&cfg);
+	cfg.flags = LZSS_FLAGS_CTRL_M | LZSS_FLAGS_MTCH_EBIG | LZSS_FLAGS_MTCH_L_HL;
+	cfg.nameTblValue = 0x00;
+	lzss = lzssCreate(&cfg);
+	lzssDecodedSize(lzss, arcSize, arcData, &streamSize);
+	lzssDestroy(lzss);
+	decSize = (UINT32)streamSize;
 	decBuffer = (UINT8*)malloc(decSize);
 	outSize = LZSS_Decode_v1(arcSize, arcData, decSize, decBuffer);
-	if (outSize >= decSize)
+	if (outSize < decSize)
 		printf("Warning - not all data was decompressed!\n");
 	
 	ExtractBLK_FF_Archive(outSize, decBuffer, fileName);
@@ -4,6 +4,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "file-map.h"
 #ifdef _WIN32
 #include <windows.h>
 #endif
@@ -17,6 +18,7 @@ int main(int argc, char* argv[])
 	FILE* hFile;
 	size_t inLen;
 	UINT8* inData;
+	FILE_MAP inMap;
 	UINT8 key;
 #ifdef _WIN32
 	FILETIME ftWrite;
@@ -47,20 +49,12 @@ int main(int argc, char* argv[])
 	
 	key = (UINT8)strtoul(argv[argbase + 0], NULL, 0);
 	
-	hFile = fopen(argv[argbase + 1], "rb");
-	if (hFile == NULL)
+	// the output may overwrite the input file, so it must not stay mapped then
+	if (IsSameFile(argv[argbase + 1], argv[argbase + 2]) ? ReadInputFile(argv[argbase + 1], &inMap) :
+		MapInputFileCopy(argv[argbase + 1], &inMap))
 		return 1;
-	
-	fseek(hFile, 0, SEEK_END);
-	inLen = ftell(hFile);
-	if (inLen > 0x1000000)
-		inLen = 0x1000000;	// limit to 16 MB
-	
-	inData = (UINT8*)malloc(inLen);
-	fseek(hFile, 0, SEEK_SET);
-	fread(inData, 0x01, inLen, hFile);
-	
-	fclose(hFile);
+	inLen = inMap.len;
+	inData = inMap.data;
 	
 #ifdef _WIN32
 	ftWrite.dwLowDateTime = ftWrite.dwHighDateTime = 0;
@@ -107,7 +101,7 @@ int main(int argc, char* argv[])
 	}
 #endif
 	
-	free(inData);
+	UnmapFile(&inMap, 0);
 	
 	return 0;
 }